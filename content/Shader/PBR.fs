@@ -11,7 +11,6 @@ in VS_OUT{
     vec3 T;
     vec3 B;
     vec3 N;
-    vec4 FragPosLightSpace;
 } fs_in;
 
 struct Texture2D
@@ -27,7 +26,7 @@ vec4 SampleTexture(Texture2D tex, vec2 uv)
 }
 
 uniform sampler2D depthTexture;
-uniform sampler2D shadowMap;
+uniform sampler2DArray shadowMap;
 // uniform samplerCube shadowCubeMap;
 
 uniform Texture2D albedo_map;
@@ -45,8 +44,27 @@ uniform float roughnessStrength;
 uniform float metalStrength;
 uniform float shadowStrength;
 
-uniform vec3 lightPos;
-uniform bool pointLight;
+// per-pass camera data, binding 0
+layout (std140) uniform PassData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+// per-frame light data, binding 1
+layout (std140) uniform LightData
+{
+    vec3 lightPos;
+    float lightIntensity;
+    vec3 lightDir;
+    bool pointLight;
+    vec3 lightColor;
+    bool skybox_enabled;
+    mat4 cascade_matrices[4];   // world to shadow clip space, MAX_SHADOW_CASCADES
+    vec4 cascade_splits;        // view depth where each cascade ends
+    int cascade_count;
+};
 
 float near = 0.1; 
 float far  = 100.0;
@@ -136,34 +154,41 @@ vec3 GetPBRLightingResult(PBRLightingInfo PBR, float NdotL, float shadow)
     return (((PBR.Kd) * PBR.diffuse + PBR.specular) * NdotL + PBR.ambient) * (1 - shadow) + PBR.ambient * shadow;
 }
 
-float ShadowCalculation(vec4 fragPosLightSpace, vec3 normal, vec3 lightDir)
+// cascade covering the fragment's view depth, -1 beyond the last one
+int ShadowCascade(vec3 fragPos)
 {
-    // 执行透视除法
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    for(int i = 0; i < cascade_count; ++i)
+    {
+        if(depth < cascade_splits[i])
+            return i;
+    }
+    return -1;
+}
+
+float ShadowCalculation(vec3 fragPos, vec3 normal, vec3 lightDir)
+{
+    int cascade = ShadowCascade(fragPos);
+    if(cascade < 0)
+        return 0.0;
+    vec4 fragPosLightSpace = cascade_matrices[cascade] * vec4(fragPos, 1.0);
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
-    // 变换到[0,1]的范围
     projCoords = projCoords * 0.5 + 0.5;
-    // 取得最近点的深度(使用[0,1]范围下的fragPosLight当坐标)
-    float closestDepth = texture(shadowMap, projCoords.xy).r; 
-    // 取得当前片段在光源视角下的深度
     float currentDepth = projCoords.z;
-    // 检查当前片段是否在阴影中
     float bias = max(0.0001 * (1.0 - dot(normal, lightDir)), 0.00001);
-    // float bias = 0.00001;
-    // float shadow = currentDepth - bias > closestDepth  ? 1.0 : 0.0;
     float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
     for(int x = -1; x <= 1; ++x)
     {
         for(int y = -1; y <= 1; ++y)
         {
-            float pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r; 
+            float pcfDepth = texture(shadowMap, vec3(projCoords.xy + vec2(x, y) * texelSize, cascade)).r; 
             shadow += currentDepth - bias > pcfDepth ? 1.0 : 0.0;        
         }    
     }
     shadow /= 9.0;
     if(projCoords.z > 1.0)
         shadow = 0.0;
-
     return shadow * shadowStrength;
 }
 
@@ -205,7 +230,7 @@ void main()
     PBRLightingInfo PBR = CalculatePBRLighting(normalWS, lightDir, viewDir, worldTangent, worldBitangent, 
                                                             specColor, color * albedo.xyz, fs_in.LightColor, metallic.x, roughness.x, 
                                                             ambient, ao.x);
-    float shadow = ShadowCalculation(fs_in.FragPosLightSpace, normalWS, lightDir);
+    float shadow = ShadowCalculation(fs_in.FragPos, normalWS, lightDir);
     vec3 midres = GetPBRLightingResult(PBR, NdotL, shadow);
     FragColor = vec4(midres.rgb, 1.0);
 }
\ No newline at end of file
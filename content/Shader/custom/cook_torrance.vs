@@ -1,9 +1,9 @@
 #version 330 core
+// packed by VertexFormat
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 1) in vec2 aNormal;      // octahedral, in [0, 1]
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBitangent;
+layout (location = 3) in vec4 aTangent;     // xyz in [0, 1], w is 1 or 0 for a bitangent sign of +1 or -1
 
 out VS_OUT {
     vec3 FragPos;
@@ -13,46 +13,72 @@ out VS_OUT {
     vec3 TangentLightPos;
     vec3 TangentViewPos;
     vec3 TangentLightDir;
-    vec4 FragPosLightSpace;
     mat3 TBN;
 } vs_out;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per-instance model matrix, one column per location 7..10
+layout (location = 7) in mat4 aInstanceModel;
 
-uniform vec3 viewPos;
-uniform mat4 light_view;
-uniform mat4 light_projection;
+// must match depth.vs bit for bit, the color pass tests GL_LEQUAL against the Z-prepass
+invariant gl_Position;
 
-uniform bool pointLight;
-uniform vec3 lightPos;
-uniform vec3 lightDir;
-uniform vec3 lightColor;
+// per-pass camera data, binding 0
+layout (std140) uniform PassData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+// per-frame light data, binding 1
+layout (std140) uniform LightData
+{
+    vec3 lightPos;
+    float lightIntensity;
+    vec3 lightDir;
+    bool pointLight;
+    vec3 lightColor;
+    bool skybox_enabled;
+    mat4 cascade_matrices[4];   // world to shadow clip space, MAX_SHADOW_CASCADES
+    vec4 cascade_splits;        // view depth where each cascade ends
+    int cascade_count;
+};
 
 uniform vec3 tangent;
 uniform vec3 bitangent;
 
-mat3 getTBN(vec3 tangent, vec3 bitangent, vec3 normal){
-    mat3 normalMatrix = transpose(inverse(mat3(model)));
+// the inverse of VertexFormat::EncodeOctahedral
+vec3 DecodeOctahedral(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+    {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
+mat3 getTBN(vec3 tangent, float handedness, vec3 normal){
+    mat3 normalMatrix = transpose(inverse(mat3(aInstanceModel)));
     vec3 T = normalize(normalMatrix * tangent);
     vec3 N = normalize(normalMatrix * normal);
     T = normalize(T - dot(T, N) * N);
-    vec3 B = cross(N, T);
+    vec3 B = cross(N, T) * handedness;
     mat3 TBN = transpose(mat3(T, B, N)); 
     return TBN;
 }
 
 void main(){
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
-    vs_out.Normal = aNormal;
+    vec3 normal = DecodeOctahedral(aNormal);
+    vs_out.FragPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+    vs_out.Normal = normal;
     vs_out.TexCoords = aTexCoords;
-    mat3 TBN = getTBN(aTangent, aBitangent, aNormal);
+    mat3 TBN = getTBN(aTangent.xyz * 2.0 - 1.0, aTangent.w * 2.0 - 1.0, normal);
     vs_out.TBN = TBN;
     vs_out.TangentFragPos  = TBN * vs_out.FragPos;
     vs_out.TangentLightPos = TBN * lightPos;
     vs_out.TangentViewPos  = TBN * viewPos;
     vs_out.TangentLightDir = TBN * lightDir;
-    vs_out.FragPosLightSpace = light_projection * light_view * vec4(vs_out.FragPos, 1.0);
     gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
 }
\ No newline at end of file
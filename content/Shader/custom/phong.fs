@@ -9,7 +9,6 @@ in VS_OUT {
     vec3 TangentLightPos;
     vec3 TangentViewPos;
     vec3 TangentLightDir;
-    vec4 FragPosLightSpace;
 } fs_in;
 
 struct Texture2D
@@ -26,7 +25,7 @@ vec4 SampleTexture(Texture2D tex, vec2 uv)
 
 uniform sampler2D depthTexture;
 uniform sampler2D z_buffer;
-uniform sampler2D shadowMap;
+uniform sampler2DArray shadowMap;
 uniform samplerCube shadowCubeMap;
 
 uniform vec2 screen_size;
@@ -40,11 +39,27 @@ uniform float normalStrength;
 uniform float aoStrength;
 uniform float shadowStrength;
 
-uniform bool pointLight;
-uniform vec3 lightPos;
-uniform vec3 lightDir;
-uniform vec3 viewPos;
-uniform vec3 lightColor;
+// per-pass camera data, binding 0
+layout (std140) uniform PassData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+// per-frame light data, binding 1
+layout (std140) uniform LightData
+{
+    vec3 lightPos;
+    float lightIntensity;
+    vec3 lightDir;
+    bool pointLight;
+    vec3 lightColor;
+    bool skybox_enabled;
+    mat4 cascade_matrices[4];   // world to shadow clip space, MAX_SHADOW_CASCADES
+    vec4 cascade_splits;        // view depth where each cascade ends
+    int cascade_count;
+};
 
 uniform float heightScale;
 
@@ -87,20 +102,35 @@ vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
     return currentTexCoords;
 }
 
-float ShadowCalculation(vec4 fragPosLightSpace, vec3 normal, vec3 lightDir)
+// cascade covering the fragment's view depth, -1 beyond the last one
+int ShadowCascade(vec3 fragPos)
+{
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    for(int i = 0; i < cascade_count; ++i)
+    {
+        if(depth < cascade_splits[i])
+            return i;
+    }
+    return -1;
+}
+
+float ShadowCalculation(vec3 fragPos, vec3 normal, vec3 lightDir)
 {
+    int cascade = ShadowCascade(fragPos);
+    if(cascade < 0)
+        return 0.0;
+    vec4 fragPosLightSpace = cascade_matrices[cascade] * vec4(fragPos, 1.0);
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
     projCoords = projCoords * 0.5 + 0.5;
-    float closestDepth = texture(shadowMap, projCoords.xy).r; 
     float currentDepth = projCoords.z;
     float bias = max(0.0001 * (1.0 - dot(normal, lightDir)), 0.00001);
     float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
     for(int x = -1; x <= 1; ++x)
     {
         for(int y = -1; y <= 1; ++y)
         {
-            float pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r; 
+            float pcfDepth = texture(shadowMap, vec3(projCoords.xy + vec2(x, y) * texelSize, cascade)).r; 
             shadow += currentDepth - bias > pcfDepth ? 1.0 : 0.0;        
         }    
     }
@@ -184,7 +214,7 @@ void main()
     }
     else{
         tangentFrag2LightDir = fs_in.TangentLightDir;
-        shadow = ShadowCalculation(fs_in.FragPosLightSpace, tangentNormal, tangentFrag2LightDir);
+        shadow = ShadowCalculation(fs_in.FragPos, tangentNormal, tangentFrag2LightDir);
     }
 
     float diff = max(dot(tangentFrag2LightDir, tangentNormal), 0.0);
@@ -196,10 +226,10 @@ void main()
     vec3 specular = vec3(0.2) * spec * lightColor; // assuming bright white light color
 
     // float shadow = pointLight ? PointShadowCalculation(fs_in.FragPos) :
-    //     ShadowCalculation(fs_in.FragPosLightSpace, tangentNormal, tangentFrag2LightDir);
+    //     ShadowCalculation(fs_in.FragPos, tangentNormal, tangentFrag2LightDir);
         
     // shadow = pointLight ? 0 :
-    //     ShadowCalculation(fs_in.FragPosLightSpace, tangentNormal, tangentFrag2LightDir);
+    //     ShadowCalculation(fs_in.FragPos, tangentNormal, tangentFrag2LightDir);
 
     vec3 lighting = vec3(ambient + (1.0 - shadow) * (diffuse + specular)) * albedo;
     FragColor = vec4(lighting, 1.0);
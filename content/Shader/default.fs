@@ -5,8 +5,6 @@ in vec3 Normal;
 in vec3 FragPos;  
 in vec2 TexCoord;
   
-uniform vec3 lightPos; 
-uniform vec3 lightColor;
 uniform vec3 objectColor;
 
 void main()
@@ -1,9 +1,9 @@
 #version 330 core
+// packed by VertexFormat
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 1) in vec2 aNormal;      // octahedral, in [0, 1]
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBitangent;
+layout (location = 3) in vec4 aTangent;     // xyz in [0, 1], w is 1 or 0 for a bitangent sign of +1 or -1
 
 out VS_OUT{
     vec3 FragPos;
@@ -15,38 +15,66 @@ out VS_OUT{
     vec3 T;
     vec3 B;
     vec3 N;
-    vec4 FragPosLightSpace;
 } vs_out;
 
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform mat4 light_view;
-uniform mat4 light_projection;
+// per-instance model matrix, one column per location 7..10
+layout (location = 7) in mat4 aInstanceModel;
 
-uniform bool pointLight;
-uniform vec3 viewPos;
-uniform vec3 lightDir;
-uniform vec3 lightColor;
-uniform vec3 lightPos;
+// must match depth.vs bit for bit, the color pass tests GL_LEQUAL against the Z-prepass
+invariant gl_Position;
+
+// per-pass camera data, binding 0
+layout (std140) uniform PassData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+// per-frame light data, binding 1
+layout (std140) uniform LightData
+{
+    vec3 lightPos;
+    float lightIntensity;
+    vec3 lightDir;
+    bool pointLight;
+    vec3 lightColor;
+    bool skybox_enabled;
+    mat4 cascade_matrices[4];   // world to shadow clip space, MAX_SHADOW_CASCADES
+    vec4 cascade_splits;        // view depth where each cascade ends
+    int cascade_count;
+};
+
+// the inverse of VertexFormat::EncodeOctahedral
+vec3 DecodeOctahedral(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+    {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
 
 void main()
 {
-    mat3 normalMatrix = transpose(inverse(mat3(model)));
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
-    vs_out.Normal = normalMatrix * aNormal;  
+    vec3 normal = DecodeOctahedral(aNormal);
+    vec3 tangent = aTangent.xyz * 2.0 - 1.0;
+    mat3 normalMatrix = transpose(inverse(mat3(aInstanceModel)));
+    vs_out.FragPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+    vs_out.Normal = normalMatrix * normal;
     vs_out.TexCoords = aTexCoords;
-    vec3 T = normalize(normalMatrix * aTangent).xyz;
-    vec3 N = normalize(normalMatrix * aNormal).xyz;
+    vec3 T = normalize(normalMatrix * tangent).xyz;
+    vec3 N = normalize(normalMatrix * normal).xyz;
     T = normalize(T - dot(T, N) * N);
-    vec3 B = cross(T, N);
+    vec3 B = cross(T, N) * (aTangent.w * 2.0 - 1.0);
     vs_out.T = T;
     vs_out.B = B;
     vs_out.N = N;
     vs_out.LightDir = lightDir;
     vs_out.LightColor = lightColor;
     vs_out.ViewPos = viewPos;
-    vs_out.FragPosLightSpace = light_projection * light_view * vec4(vs_out.FragPos, 1.0);
     gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
 }
\ No newline at end of file
@@ -1,11 +1,22 @@
 #version 330 core
 layout (location = 0) in vec3 position;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per-instance model matrix, one column per location 7..10
+layout (location = 7) in mat4 aInstanceModel;
+
+// per-pass camera data, binding 0
+layout (std140) uniform PassData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+// same expression as the color shaders so the Z-prepass depth matches them exactly
+invariant gl_Position;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(position, 1.0f);
+    vec3 worldPos = vec3(aInstanceModel * vec4(position, 1.0));
+    gl_Position = projection * view * vec4(worldPos, 1.0);
 }
\ No newline at end of file
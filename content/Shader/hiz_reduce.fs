@@ -0,0 +1,25 @@
+#version 330 core
+out float FragDepth;
+
+uniform sampler2D depthMap;
+uniform vec2 targetSize;
+
+// farthest depth of the source pixels under this texel, rounded outwards
+void main()
+{
+    ivec2 source = textureSize(depthMap, 0);
+    ivec2 target = ivec2(targetSize);
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 from = texel * source / target;
+    ivec2 to = min(((texel + 1) * source + target - 1) / target, source);
+
+    float depth = 0.0;
+    for (int y = from.y; y < to.y; y++)
+    {
+        for (int x = from.x; x < to.x; x++)
+        {
+            depth = max(depth, texelFetch(depthMap, ivec2(x, y), 0).r);
+        }
+    }
+    FragDepth = depth;
+}
@@ -14,37 +14,35 @@ unsigned int ATR_MaterialColor::cur_id      = 50000;
 unsigned int ATR_PostProcessNode::cur_id    = 60000;
 unsigned int ATR_MeshRenderer::cur_id       = 60000;
 
-ATR_Transform::ATR_Transform()
-{
-    transform = new Transform();
-}
+ATR_Transform::ATR_Transform(EntityTransform _transform) : transform(_transform) {}
 
 
 void ATR_Transform::UI_Implement()
 {
     // position
     static float tmp_position[3];
-    tmp_position[0] = transform->Position().r;
-    tmp_position[1] = transform->Position().g;
-    tmp_position[2] = transform->Position().b;
-    ImGui::DragFloat3("Position", tmp_position, 0.1f);
-    transform->SetPosition(tmp_position[0], tmp_position[1], tmp_position[2]);
+    tmp_position[0] = transform.Position().r;
+    tmp_position[1] = transform.Position().g;
+    tmp_position[2] = transform.Position().b;
+    // only an edit dirties the transform
+    if (ImGui::DragFloat3("Position", tmp_position, 0.1f))
+        transform.SetPosition(tmp_position[0], tmp_position[1], tmp_position[2]);
 
     // rotation
     static float tmp_rotation[3];
-    tmp_rotation[0] = transform->Rotation().r;
-    tmp_rotation[1] = transform->Rotation().g;
-    tmp_rotation[2] = transform->Rotation().b;
-    ImGui::DragFloat3("Rotation", tmp_rotation, 0.1f);
-    transform->SetRotation(tmp_rotation[0], tmp_rotation[1], tmp_rotation[2]);
+    tmp_rotation[0] = transform.Rotation().r;
+    tmp_rotation[1] = transform.Rotation().g;
+    tmp_rotation[2] = transform.Rotation().b;
+    if (ImGui::DragFloat3("Rotation", tmp_rotation, 0.1f))
+        transform.SetRotation(tmp_rotation[0], tmp_rotation[1], tmp_rotation[2]);
 
     // scale
     static float tmp_scale[3];
-    tmp_scale[0] = transform->Scale().r;
-    tmp_scale[1] = transform->Scale().g;
-    tmp_scale[2] = transform->Scale().b;
-	ImGui::DragFloat3("Scale", tmp_scale, 0.1f);
-    transform->SetScale(tmp_scale[0], tmp_scale[1], tmp_scale[2]);
+    tmp_scale[0] = transform.Scale().r;
+    tmp_scale[1] = transform.Scale().g;
+    tmp_scale[2] = transform.Scale().b;
+	if (ImGui::DragFloat3("Scale", tmp_scale, 0.1f))
+        transform.SetScale(tmp_scale[0], tmp_scale[1], tmp_scale[2]);
 }
 
 ATR_MaterialTexture::ATR_MaterialTexture(std::string _name, Material *_material, MaterialTexture2D *_texture) : material(_material),
@@ -239,26 +237,33 @@ void ATR_Material::UI_Implement()
     }
 }
 
-ATR_MeshRenderer::ATR_MeshRenderer(MeshRenderer *_meshRenderer) : meshRenderer(_meshRenderer)
+ATR_MeshRenderer::ATR_MeshRenderer(Handle _renderer) : renderer(_renderer)
 {
-    atr_material = new ATR_Material(_meshRenderer->material);
+    atr_material = new ATR_Material(SceneStore::GetInstance()->GetRenderer(renderer)->material);
     id = cur_id++;
 }
 
 void ATR_MeshRenderer::UI_Implement()
 {
+    MeshRenderer* meshRenderer = SceneStore::GetInstance()->GetRenderer(renderer);
+    if (meshRenderer == nullptr)
+    {
+        return;
+    }
     std::string title = "Mesh Renderer";
     std::string meshInfo = "vertices: null";
     if (meshRenderer->mesh != nullptr)
     {
-        title = "Mesh Renderer##" + std::to_string(meshRenderer->mesh->VAO);
-        meshInfo = "vertices: " + std::to_string(meshRenderer->mesh->vertices.size());
+        title = "Mesh Renderer##" + std::to_string(meshRenderer->mesh->id);
+        meshInfo = "vertices: " + std::to_string(meshRenderer->mesh->vertices.size()) +
+                   ", lod " + std::to_string(meshRenderer->lod) + " / " + std::to_string(meshRenderer->mesh->lods.size());
     }
     if (ImGui::CollapsingHeader(title.c_str(), true))
     {
         ImGui::Text(meshInfo.c_str());
         ImGui::SeparatorText("Setting");
-        ImGui::Checkbox(("cast shadow##"+std::to_string(meshRenderer->mesh->VAO)).c_str(), &meshRenderer->cast_shadow);
+        ImGui::Checkbox(("cast shadow##"+std::to_string(renderer)).c_str(), &meshRenderer->cast_shadow);
+        ImGui::Checkbox(("occluder##"+std::to_string(renderer)).c_str(), &meshRenderer->occluder);
         ImGui::SeparatorText("Material");
         
 		const char* material_types[3] = { "Phong", "Blinn Phong", "Cook-Torrance" };
@@ -277,22 +282,22 @@ void ATR_MeshRenderer::UI_Implement()
     }
 }
 
-ATR_Light::ATR_Light(float* _intensity,  float* _color) : intensity(_intensity), color(_color){}
+ATR_Light::ATR_Light(Entity _entity) : entity(_entity) {}
 
 void ATR_Light::UI_Implement()
 {
+    LightComponent* light = SceneStore::GetInstance()->GetLight(entity);
     ImGui::SeparatorText("Light Settings");
     
 	const char* light_types[2] = { "Directional", "Point" };
     std::string item = "light type";
-    ImGui::Combo(item.c_str(), &cur_light, light_types, IM_ARRAYSIZE(light_types));
-	if (prev_light != cur_light)
+    int cur_light = (int)light->type;
+    if (ImGui::Combo(item.c_str(), &cur_light, light_types, IM_ARRAYSIZE(light_types)))
     {
-        light_type = (LightType)(cur_light);
+        light->type = (LightType)(cur_light);
     }
-    prev_light = cur_light;
-    ImGui::DragFloat("Intensity", intensity, 0.1f);
-    ImGui::ColorEdit3("Light Color", color);
+    ImGui::DragFloat("Intensity", &light->intensity, drag_speed);
+    ImGui::ColorEdit3("Light Color", &light->color[0]);
 }
 
 ATR_PostProcessManager::ATR_PostProcessManager(PostProcessManager* manager) : ppm(manager) 
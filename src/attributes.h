@@ -3,7 +3,7 @@
 #include <string>
 #include <vector>
 #include <list>
-#include "transform.h"
+#include "scene_store.h"
 
 class MeshRenderer;
 class SceneModel;
@@ -26,10 +26,10 @@ public:
 class ATR_Transform : public Attribute
 {
 public:
-    Transform* transform;
+    EntityTransform transform;
 
 public:
-    ATR_Transform();
+    ATR_Transform(EntityTransform _transform);
     void UI_Implement() override;
  
     ~ATR_Transform()    override = default;
@@ -132,11 +132,11 @@ private:
 class ATR_MeshRenderer : public Attribute
 {
 public:
-    ATR_MeshRenderer(MeshRenderer *_meshRenderer);
+    ATR_MeshRenderer(Handle _renderer);
     void UI_Implement() override;
     ~ATR_MeshRenderer() override = default;
 
-    MeshRenderer *meshRenderer;
+    Handle renderer;        // in the SceneStore
     unsigned int id;
 
 private:
@@ -146,24 +146,15 @@ private:
     static unsigned int cur_id;
 };
 
-enum class LightType
-{
-	DIRECTIONAL = 0, POINT
-};
-
 class ATR_Light : Attribute
 {
 public:
-	ATR_Light(float* _intensity, float* _color);
+	ATR_Light(Entity _entity);
     void UI_Implement()     override;
     ~ATR_Light()    override = default;
 
     float drag_speed = 0.1;
-    float* color;
-    float* intensity;
-    LightType light_type = LightType::DIRECTIONAL;
-    int cur_light = 0;
-    int prev_light = 0;
+    Entity entity;          // its LightComponent in the SceneStore
 };
 
 class PostProcess;
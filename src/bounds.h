@@ -0,0 +1,142 @@
+#pragma once
+#include <cfloat>
+#include <glm/glm.hpp>
+
+/*****************************************************
+* Axis aligned bounding box, stored as min/max corner.
+* A default constructed box is empty (min > max).
+*****************************************************/
+struct AABB
+{
+    glm::vec3 min = glm::vec3( FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    AABB() {}
+    AABB(glm::vec3 _min, glm::vec3 _max) : min(_min), max(_max) {}
+
+    bool IsValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    glm::vec3 Center() const { return (min + max) * 0.5f; }
+    glm::vec3 Extents() const { return (max - min) * 0.5f; }
+
+    void Expand(const glm::vec3& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void Expand(const AABB& box)
+    {
+        if (!box.IsValid()) return;
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+
+    // fraction of the screen covered by the projected box, 1 if it crosses the eye plane
+    float ScreenCoverage(const glm::mat4& view_projection) const
+    {
+        if (!IsValid()) return 0.0f;
+        glm::vec2 ndc_min(FLT_MAX), ndc_max(-FLT_MAX);
+        for (int c = 0; c < 8; c++)
+        {
+            glm::vec3 corner((c & 1) ? max.x : min.x, (c & 2) ? max.y : min.y, (c & 4) ? max.z : min.z);
+            glm::vec4 clip = view_projection * glm::vec4(corner, 1.0f);
+            if (clip.w <= 0.0f) return 1.0f;
+            glm::vec2 ndc = glm::vec2(clip) / clip.w;
+            ndc_min = glm::min(ndc_min, ndc);
+            ndc_max = glm::max(ndc_max, ndc);
+        }
+        glm::vec2 size = glm::clamp(ndc_max, -1.0f, 1.0f) - glm::clamp(ndc_min, -1.0f, 1.0f);
+        return size.x * size.y * 0.25f;
+    }
+
+    // transform the box and return the box enclosing the result (Arvo's method)
+    AABB Transformed(const glm::mat4& m) const
+    {
+        if (!IsValid()) return AABB();
+        glm::vec3 center = glm::vec3(m * glm::vec4(Center(), 1.0f));
+        glm::vec3 extents = Extents();
+        glm::vec3 world_extents;
+        for (int i = 0; i < 3; i++)
+        {
+            world_extents[i] =  glm::abs(m[0][i]) * extents.x +
+                                glm::abs(m[1][i]) * extents.y +
+                                glm::abs(m[2][i]) * extents.z;
+        }
+        return AABB(center - world_extents, center + world_extents);
+    }
+};
+
+struct BoundingSphere
+{
+    glm::vec3 center = glm::vec3(0);
+    float radius = 0;
+
+    BoundingSphere() {}
+    BoundingSphere(glm::vec3 _center, float _radius) : center(_center), radius(_radius) {}
+
+    BoundingSphere Transformed(const glm::mat4& m) const
+    {
+        float max_scale = glm::max(glm::length(glm::vec3(m[0])), glm::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+        return BoundingSphere(glm::vec3(m * glm::vec4(center, 1.0f)), radius * max_scale);
+    }
+};
+
+/*****************************************************
+* Six clip planes extracted from a view-projection
+* matrix (Gribb/Hartmann). Plane normals point inward.
+*****************************************************/
+class Frustum
+{
+public:
+    glm::vec4 planes[6];
+
+    Frustum() {}
+    Frustum(const glm::mat4& view_projection) { SetFromMatrix(view_projection); }
+
+    void SetFromMatrix(const glm::mat4& m)
+    {
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+        planes[0] = row3 + row0;    // left
+        planes[1] = row3 - row0;    // right
+        planes[2] = row3 + row1;    // bottom
+        planes[3] = row3 - row1;    // top
+        planes[4] = row3 + row2;    // near
+        planes[5] = row3 - row2;    // far
+        for (int i = 0; i < 6; i++)
+        {
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+        }
+    }
+
+    // test the corner furthest along each plane normal, the box is outside if it is behind any plane
+    bool Intersects(const AABB& box) const
+    {
+        if (!box.IsValid()) return false;
+        for (int i = 0; i < 6; i++)
+        {
+            glm::vec3 p(planes[i].x >= 0 ? box.max.x : box.min.x,
+                        planes[i].y >= 0 ? box.max.y : box.min.y,
+                        planes[i].z >= 0 ? box.max.z : box.min.z);
+            if (glm::dot(glm::vec3(planes[i]), p) + planes[i].w < 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Intersects(const BoundingSphere& sphere) const
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            if (glm::dot(glm::vec3(planes[i]), sphere.center) + planes[i].w < -sphere.radius)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
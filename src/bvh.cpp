@@ -0,0 +1,430 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#include "bvh.h"
+#include "renderer_console.h"
+
+namespace
+{
+    // visiting an inner node against testing one primitive
+    const float TRAVERSAL_COST = 1.0f;
+    // below this the tree splits at the median, keeps every path short enough for the traversal stacks
+    const unsigned int MAX_SAH_DEPTH = 64;
+
+    struct Bin
+    {
+        AABB            bounds;
+        unsigned int    count = 0;
+    };
+
+    // a primitive as the build moves it around, so the passes over a node read memory in order
+    struct Reference
+    {
+        AABB            box;
+        glm::vec3       center;
+        unsigned int    index;
+    };
+
+    float Area(const AABB& box)
+    {
+        if (!box.IsValid())
+        {
+            return 0.0f;
+        }
+        glm::vec3 d = box.max - box.min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    int BinOf(float center, float low, float scale)
+    {
+        return std::min(Bvh::BINS - 1, std::max(0, (int)((center - low) * scale)));
+    }
+
+    // Moller-Trumbore, both faces
+    bool IntersectTriangle(const Ray& ray, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float& t)
+    {
+        glm::vec3 e1 = b - a;
+        glm::vec3 e2 = c - a;
+        glm::vec3 p = glm::cross(ray.direction, e2);
+        float det = glm::dot(e1, p);
+        if (det == 0.0f)
+        {
+            return false;
+        }
+        float inv_det = 1.0f / det;
+        glm::vec3 s = ray.origin - a;
+        float u = glm::dot(s, p) * inv_det;
+        if (u < 0.0f || u > 1.0f)
+        {
+            return false;
+        }
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(ray.direction, q) * inv_det;
+        if (v < 0.0f || u + v > 1.0f)
+        {
+            return false;
+        }
+        t = glm::dot(e2, q) * inv_det;
+        return t >= 0.0f;
+    }
+}
+
+const int Bvh::BINS;
+
+void Bvh::Build(const AABB* boxes, unsigned int count, unsigned int max_leaf_size, std::vector<BvhNode>& nodes, std::vector<unsigned int>& order)
+{
+    nodes.clear();
+    order.resize(count);
+    if (count == 0)
+    {
+        return;
+    }
+    std::vector<Reference> refs(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        refs[i] = { boxes[i], boxes[i].IsValid() ? boxes[i].Center() : glm::vec3(0.0f), i };
+    }
+
+    struct Task
+    {
+        unsigned int node, begin, end, depth;
+    };
+    std::vector<Task> tasks;
+    nodes.reserve(2 * (count / std::max(1u, max_leaf_size)) + 1);
+    nodes.push_back(BvhNode());
+    tasks.push_back({ 0, 0, count, 0 });
+    while (!tasks.empty())
+    {
+        Task task = tasks.back();
+        tasks.pop_back();
+        unsigned int n = task.end - task.begin;
+
+        AABB bounds, centroid_bounds;
+        for (unsigned int i = task.begin; i < task.end; i++)
+        {
+            bounds.Expand(refs[i].box);
+            centroid_bounds.Expand(refs[i].center);
+        }
+        nodes[task.node].min = bounds.min;
+        nodes[task.node].max = bounds.max;
+
+        // a range that fits a leaf is one, anything bigger takes the cheapest split by SAH
+        int best_axis = -1;
+        int best_split = 0;
+        float best_cost = FLT_MAX;
+        float parent_area = Area(bounds);
+        if (n > max_leaf_size && parent_area > 0.0f && task.depth < MAX_SAH_DEPTH)
+        {
+            // all three axes in one pass over the primitives
+            glm::vec3 low = centroid_bounds.min;
+            glm::vec3 extent = centroid_bounds.max - low;
+            glm::vec3 scale = glm::vec3(BINS) / glm::max(extent, glm::vec3(FLT_MIN));
+            Bin axis_bins[3][BINS];
+            for (unsigned int i = task.begin; i < task.end; i++)
+            {
+                const Reference& ref = refs[i];
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    Bin& bin = axis_bins[axis][BinOf(ref.center[axis], low[axis], scale[axis])];
+                    bin.bounds.Expand(ref.box);
+                    bin.count++;
+                }
+            }
+            for (int axis = 0; axis < 3; axis++)
+            {
+                if (extent[axis] <= 0.0f)
+                {
+                    continue;
+                }
+                const Bin* bins = axis_bins[axis];
+                // everything right of each boundary, then sweep the left side across
+                float right_area[BINS];
+                unsigned int right_count[BINS];
+                AABB right;
+                unsigned int right_total = 0;
+                for (int b = BINS - 1; b > 0; b--)
+                {
+                    right.Expand(bins[b].bounds);
+                    right_total += bins[b].count;
+                    right_area[b] = Area(right);
+                    right_count[b] = right_total;
+                }
+                AABB left;
+                unsigned int left_total = 0;
+                for (int b = 0; b < BINS - 1; b++)
+                {
+                    left.Expand(bins[b].bounds);
+                    left_total += bins[b].count;
+                    if (left_total == 0 || right_count[b + 1] == 0)
+                    {
+                        continue;
+                    }
+                    float cost = TRAVERSAL_COST + (Area(left) * left_total + right_area[b + 1] * right_count[b + 1]) / parent_area;
+                    if (cost < best_cost)
+                    {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_split = b + 1;
+                    }
+                }
+            }
+        }
+
+        unsigned int mid;
+        if (best_axis >= 0)
+        {
+            float low = centroid_bounds.min[best_axis];
+            float scale = BINS / glm::max(centroid_bounds.max[best_axis] - low, FLT_MIN);
+            mid = (unsigned int)(std::partition(refs.begin() + task.begin, refs.begin() + task.end, [&](const Reference& ref)
+            {
+                return BinOf(ref.center[best_axis], low, scale) < best_split;
+            }) - refs.begin());
+        }
+        else if (n > max_leaf_size)
+        {
+            // nothing SAH likes, but too many for a leaf: halve along the widest centroid axis
+            glm::vec3 extent = centroid_bounds.max - centroid_bounds.min;
+            int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+            mid = task.begin + n / 2;
+            std::nth_element(refs.begin() + task.begin, refs.begin() + mid, refs.begin() + task.end, [&](const Reference& a, const Reference& b)
+            {
+                return a.center[axis] < b.center[axis];
+            });
+        }
+        else
+        {
+            nodes[task.node].first = task.begin;
+            nodes[task.node].count = n;
+            continue;
+        }
+
+        unsigned int left = (unsigned int)nodes.size();
+        nodes[task.node].first = left;
+        nodes[task.node].count = 0;
+        nodes.push_back(BvhNode());
+        nodes.push_back(BvhNode());
+        tasks.push_back({ left + 1, mid, task.end, task.depth + 1 });
+        tasks.push_back({ left, task.begin, mid, task.depth + 1 });
+    }
+    for (unsigned int i = 0; i < count; i++)
+    {
+        order[i] = refs[i].index;
+    }
+}
+
+void Bvh::Refit(std::vector<BvhNode>& nodes, const std::vector<unsigned int>& order, const AABB* boxes)
+{
+    for (size_t i = nodes.size(); i-- > 0;)
+    {
+        BvhNode& node = nodes[i];
+        AABB box;
+        if (node.IsLeaf())
+        {
+            for (unsigned int slot = node.first; slot < node.first + node.count; slot++)
+            {
+                box.Expand(boxes[order[slot]]);
+            }
+        }
+        else
+        {
+            box.Expand(nodes[node.first].Bounds());
+            box.Expand(nodes[node.first + 1].Bounds());
+        }
+        node.min = box.min;
+        node.max = box.max;
+    }
+}
+
+float Bvh::Cost(const std::vector<BvhNode>& nodes)
+{
+    if (nodes.empty())
+    {
+        return 0.0f;
+    }
+    float root_area = Area(nodes[0].Bounds());
+    if (root_area <= 0.0f)
+    {
+        return 0.0f;
+    }
+    float cost = 0.0f;
+    for (const BvhNode& node : nodes)
+    {
+        cost += Area(node.Bounds()) * (node.IsLeaf() ? (float)node.count : TRAVERSAL_COST);
+    }
+    return cost / root_area;
+}
+
+void MeshBvh::Build(const glm::vec3* positions, size_t stride, const unsigned int* indices, size_t index_count)
+{
+    const unsigned char* base = (const unsigned char*)positions;
+    unsigned int triangle_count = (unsigned int)(index_count / 3);
+    std::vector<AABB> boxes(triangle_count);
+    for (unsigned int i = 0; i < triangle_count; i++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            boxes[i].Expand(*(const glm::vec3*)(base + indices[i * 3 + k] * stride));
+        }
+    }
+    Bvh::Build(boxes.data(), triangle_count, MAX_LEAF_TRIANGLES, nodes, triangles);
+}
+
+bool MeshBvh::Raycast(const Ray& ray, const glm::vec3* positions, size_t stride, const unsigned int* indices, float& t) const
+{
+    if (nodes.empty())
+    {
+        return false;
+    }
+    const unsigned char* base = (const unsigned char*)positions;
+    bool hit = false;
+    unsigned int stack[Bvh::MAX_STACK];
+    int top = 0;
+    if (Bvh::IntersectBox(ray, nodes[0].min, nodes[0].max, t) != FLT_MAX)
+    {
+        stack[top++] = 0;
+    }
+    while (top > 0)
+    {
+        const BvhNode& node = nodes[stack[--top]];
+        if (node.IsLeaf())
+        {
+            for (unsigned int slot = node.first; slot < node.first + node.count; slot++)
+            {
+                const unsigned int* triangle = indices + triangles[slot] * 3;
+                float t_hit;
+                if (IntersectTriangle(ray, *(const glm::vec3*)(base + triangle[0] * stride), *(const glm::vec3*)(base + triangle[1] * stride),
+                                      *(const glm::vec3*)(base + triangle[2] * stride), t_hit) && t_hit < t)
+                {
+                    t = t_hit;
+                    hit = true;
+                }
+            }
+            continue;
+        }
+        // the nearer child goes on top, a hit there often rules out the other
+        float t_left = Bvh::IntersectBox(ray, nodes[node.first].min, nodes[node.first].max, t);
+        float t_right = Bvh::IntersectBox(ray, nodes[node.first + 1].min, nodes[node.first + 1].max, t);
+        unsigned int near_child = t_left <= t_right ? node.first : node.first + 1;
+        float t_far = t_left <= t_right ? t_right : t_left;
+        if (t_far != FLT_MAX)
+        {
+            stack[top++] = near_child == node.first ? node.first + 1 : node.first;
+        }
+        if (glm::min(t_left, t_right) != FLT_MAX)
+        {
+            stack[top++] = near_child;
+        }
+    }
+    return hit;
+}
+
+/*****************************************************
+* Trees over random boxes checked for what the queries,
+* Refit and the stacks rely on: every primitive in one
+* leaf, children after their parent and inside its box,
+* no path deeper than MAX_STACK. Then a MeshBvh over a
+* random triangle soup, its ray casts against testing
+* every triangle. One thread.
+*****************************************************/
+void Bvh::Benchmark()
+{
+    RendererConsole::GetInstance()->AddNote("Bvh, one core");
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    const unsigned int sizes[] = { 10000, 100000, 1000000 };
+    for (unsigned int count : sizes)
+    {
+        std::vector<AABB> boxes(count);
+        for (AABB& box : boxes)
+        {
+            glm::vec3 center = glm::vec3(unit(random), unit(random), unit(random)) * 1000.0f;
+            glm::vec3 extent = glm::vec3(1.1f + unit(random), 1.1f + unit(random), 1.1f + unit(random)) * 2.5f;
+            box = AABB(center - extent, center + extent);
+        }
+        std::vector<BvhNode> nodes;
+        std::vector<unsigned int> order;
+        auto start = std::chrono::high_resolution_clock::now();
+        Build(boxes.data(), count, 2, nodes, order);
+        float build_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::vector<unsigned int> seen(count, 0);
+        std::vector<unsigned int> depth(nodes.size(), 1);
+        unsigned int max_depth = 0;
+        bool valid = true;
+        for (unsigned int i = 0; i < nodes.size(); i++)
+        {
+            const BvhNode& node = nodes[i];
+            max_depth = std::max(max_depth, depth[i]);
+            if (node.IsLeaf())
+            {
+                for (unsigned int slot = node.first; slot < node.first + node.count; slot++)
+                {
+                    const AABB& box = boxes[order[slot]];
+                    seen[order[slot]]++;
+                    valid &= glm::all(glm::lessThanEqual(node.min, box.min)) && glm::all(glm::lessThanEqual(box.max, node.max));
+                }
+                continue;
+            }
+            valid &= node.first > i && node.first + 1 < nodes.size();
+            for (unsigned int child = node.first; valid && child <= node.first + 1; child++)
+            {
+                depth[child] = depth[i] + 1;
+                valid &= glm::all(glm::lessThanEqual(node.min, nodes[child].min)) && glm::all(glm::lessThanEqual(nodes[child].max, node.max));
+            }
+        }
+        for (unsigned int n : seen)
+        {
+            valid &= n == 1;
+        }
+        valid &= max_depth <= MAX_STACK;
+        RendererConsole::GetInstance()->AddNote("  %7u boxes: build %8.2f ms, %7zu nodes, depth %3u, cost %.1f, %s",
+            count, build_ms, nodes.size(), max_depth, Cost(nodes), valid ? "valid" : "BROKEN");
+    }
+
+    const unsigned int triangle_count = 1000000;
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    for (unsigned int i = 0; i < triangle_count; i++)
+    {
+        glm::vec3 center = glm::vec3(unit(random), unit(random), unit(random)) * 100.0f;
+        for (int k = 0; k < 3; k++)
+        {
+            positions.push_back(center + glm::vec3(unit(random), unit(random), unit(random)));
+            indices.push_back(i * 3 + k);
+        }
+    }
+    MeshBvh mesh;
+    auto start = std::chrono::high_resolution_clock::now();
+    mesh.Build(positions.data(), sizeof(glm::vec3), indices.data(), indices.size());
+    float build_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    const int rays = 50;
+    int hits = 0, mismatches = 0;
+    float tree_ms = 0, brute_force_ms = 0;
+    for (int r = 0; r < rays; r++)
+    {
+        Ray ray(glm::vec3(unit(random) * 150.0f, unit(random) * 150.0f, -200.0f), glm::normalize(glm::vec3(unit(random) * 0.3f, unit(random) * 0.3f, 1.0f)));
+        float t = FLT_MAX;
+        start = std::chrono::high_resolution_clock::now();
+        bool hit = mesh.Raycast(ray, positions.data(), sizeof(glm::vec3), indices.data(), t);
+        tree_ms += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        float t_brute_force = FLT_MAX;
+        start = std::chrono::high_resolution_clock::now();
+        for (unsigned int i = 0; i < triangle_count; i++)
+        {
+            float t_hit;
+            if (IntersectTriangle(ray, positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2], t_hit) && t_hit < t_brute_force)
+            {
+                t_brute_force = t_hit;
+            }
+        }
+        brute_force_ms += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        hits += hit;
+        mismatches += hit != (t_brute_force != FLT_MAX) || (hit && std::abs(t - t_brute_force) > 1e-3f);
+    }
+    RendererConsole::GetInstance()->AddNote("  MeshBvh %u tris: build %.1f ms, ray %.4f ms (brute force %.2f ms), %d/%d hits, %d mismatches",
+        triangle_count, build_ms, tree_ms / rays, brute_force_ms / rays, hits, rays, mismatches);
+}
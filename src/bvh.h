@@ -0,0 +1,115 @@
+#pragma once
+#include <cfloat>
+#include <vector>
+#include <glm/glm.hpp>
+#include "bounds.h"
+
+/*****************************************************
+* origin + t * direction. Transformed keeps t: a hit at
+* t in object space is the hit at t in world space, so
+* distances from different meshes compare directly.
+*****************************************************/
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 inv_direction;
+
+    Ray() {}
+    Ray(const glm::vec3& _origin, const glm::vec3& _direction) : origin(_origin), direction(_direction), inv_direction(1.0f / _direction) {}
+
+    Ray Transformed(const glm::mat4& m) const
+    {
+        return Ray(glm::vec3(m * glm::vec4(origin, 1.0f)), glm::mat3(m) * direction);
+    }
+
+    glm::vec3 At(float t) const { return origin + direction * t; }
+};
+
+// 32 bytes, two to a cache line
+struct BvhNode
+{
+    glm::vec3       min;
+    unsigned int    first;      // first slot of a leaf in the order array, left child of an inner node (the right one is first + 1)
+    glm::vec3       max;
+    unsigned int    count;      // primitives of a leaf, 0 for an inner node
+
+    bool IsLeaf() const { return count > 0; }
+    AABB Bounds() const { return AABB(min, max); }
+};
+
+/*****************************************************
+* Bounding volume hierarchy over boxes, built top down
+* with the binned surface area heuristic: centroids are
+* sorted into BINS slots along each axis and the split
+* between bins with the lowest expected cost wins, down
+* to ranges that fit a leaf. Children always follow
+* their parent in the node array, so a reverse walk
+* refits the whole tree after the boxes moved. Cost
+* grows as refits stretch the boxes, a rebuild is due
+* once it strays far from what the build gave.
+*****************************************************/
+class Bvh
+{
+public:
+    static const int BINS = 16;
+    // entries of a traversal stack, Build keeps every tree shallow enough for it
+    static const int MAX_STACK = 128;
+
+    // order receives the primitive of every leaf slot, nodes[0] is the root, nothing for count 0
+    static void Build(const AABB* boxes, unsigned int count, unsigned int max_leaf_size, std::vector<BvhNode>& nodes, std::vector<unsigned int>& order);
+    // leaves from boxes[order[slot]], inner nodes from their children
+    static void Refit(std::vector<BvhNode>& nodes, const std::vector<unsigned int>& order, const AABB* boxes);
+    // expected cost of a ray through the tree relative to one through the root box, in box and primitive tests
+    static float Cost(const std::vector<BvhNode>& nodes);
+
+    // entry distance of the ray into the box within [0, t_max], FLT_MAX on a miss, an empty box never hits
+    static float IntersectBox(const Ray& ray, const glm::vec3& min, const glm::vec3& max, float t_max)
+    {
+        if (min.x > max.x)
+        {
+            return FLT_MAX;
+        }
+        glm::vec3 t0 = (min - ray.origin) * ray.inv_direction;
+        glm::vec3 t1 = (max - ray.origin) * ray.inv_direction;
+        glm::vec3 t_near = glm::min(t0, t1);
+        glm::vec3 t_far = glm::max(t0, t1);
+        float enter = glm::max(glm::max(t_near.x, t_near.y), glm::max(t_near.z, 0.0f));
+        float exit = glm::min(glm::min(t_far.x, t_far.y), glm::min(t_far.z, t_max));
+        return enter <= exit ? enter : FLT_MAX;
+    }
+
+    // check trees over 10k to 1M random boxes and MeshBvh ray casts against brute force, log to the console
+    static void Benchmark();
+
+    // squared distance from the point to the box, 0 inside
+    static float DistanceSquared(const glm::vec3& point, const glm::vec3& min, const glm::vec3& max)
+    {
+        if (min.x > max.x)
+        {
+            return FLT_MAX;
+        }
+        glm::vec3 d = glm::max(glm::max(min - point, point - max), glm::vec3(0.0f));
+        return glm::dot(d, d);
+    }
+};
+
+/*****************************************************
+* Triangle BVH of one mesh in object space, built once
+* in the import jobs and kept in the MeshCache with the
+* rest of the mesh. Positions are read every `stride`
+* bytes, the same ones it was built from.
+*****************************************************/
+class MeshBvh
+{
+public:
+    static const unsigned int MAX_LEAF_TRIANGLES = 4;
+
+    std::vector<BvhNode>        nodes;
+    std::vector<unsigned int>   triangles;      // triangle (first index / 3) of every leaf slot
+
+    void Build(const glm::vec3* positions, size_t stride, const unsigned int* indices, size_t index_count);
+    bool IsBuilt() const { return !nodes.empty(); }
+    // nearest triangle the ray hits before t, t receives its distance
+    bool Raycast(const Ray& ray, const glm::vec3* positions, size_t stride, const unsigned int* indices, float& t) const;
+};
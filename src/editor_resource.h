@@ -1,15 +1,58 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 
 using namespace std;
 
+/*****************************************************
+* Who uses a resource. A referrer added more than once
+* (a material with the same texture in two slots) is
+* listed once and stays until removed as often.
+* Removal moves the last reference into the gap, so
+* both take O(1) and references never holds a stale
+* entry.
+*****************************************************/
 template <class T>
 class EditorResource
 {
 public:
     vector<T> references;
 
-    void AddRef(T ref_target) { references.push_back(ref_target); }
-    void RemoveRef(T remove_target) { remove(references.begin(), references.end(), remove_target); }
-};
\ No newline at end of file
+    void AddRef(T ref_target)
+    {
+        auto it = slots.find(ref_target);
+        if (it != slots.end())
+        {
+            it->second.count++;
+            return;
+        }
+        slots[ref_target] = { (unsigned int)references.size(), 1 };
+        references.push_back(ref_target);
+    }
+
+    void RemoveRef(T remove_target)
+    {
+        auto it = slots.find(remove_target);
+        if (it == slots.end() || --it->second.count > 0)
+        {
+            return;
+        }
+        unsigned int index = it->second.index;
+        slots.erase(it);
+        if (index + 1 < references.size())
+        {
+            references[index] = references.back();
+            slots[references[index]].index = index;
+        }
+        references.pop_back();
+    }
+
+private:
+    struct Slot
+    {
+        unsigned int index;     // in references
+        unsigned int count;
+    };
+    unordered_map<T, Slot> slots;
+};
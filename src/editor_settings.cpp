@@ -4,6 +4,19 @@ bool EditorSettings::UsePostProcess = true;
 bool EditorSettings::UsePolygonMode = false;
 bool EditorSettings::DrawGizmos     = true;
 bool EditorSettings::SkyboxEnabled  = true;
+bool EditorSettings::UseFrustumCulling = true;
+bool EditorSettings::UseOcclusionCulling = false;
+bool EditorSettings::UseSoftwareOcclusion = false;
+bool EditorSettings::UseLod = true;
+float EditorSettings::LodErrorPixels = 1.0f;
+int EditorSettings::ShadowLodBias = 1;
+bool EditorSettings::QuantizePositions = false;
+bool EditorSettings::UseMeshCache = true;
+bool EditorSettings::UseInstancing = true;
+bool EditorSettings::UseMultiDrawIndirect = true;
+bool EditorSettings::CacheShadowMaps = true;
+int EditorSettings::ZPrePassMode = ZPREPASS_AUTO;
+float EditorSettings::ZPrePassOverdrawThreshold = 1.5f;
 std::vector<WindowSize> EditorSettings::window_size_list = {    WindowSize(800, 600),
                                                                 WindowSize(1024, 768),
                                                                 WindowSize(1200, 900),
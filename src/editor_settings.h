@@ -19,6 +19,13 @@ struct WindowSize
     }
 };
 
+enum EZPrePassMode
+{
+    ZPREPASS_OFF = 0,
+    ZPREPASS_ON,
+    ZPREPASS_AUTO       // on when last frame's estimated overdraw reached ZPrePassOverdrawThreshold
+};
+
 static class EditorSettings
 {
 public:
@@ -26,5 +33,18 @@ public:
     static bool UsePostProcess;
     static bool DrawGizmos;
     static bool SkyboxEnabled;
+    static bool UseFrustumCulling;
+    static bool UseOcclusionCulling;
+    static bool UseSoftwareOcclusion;
+    static bool UseLod;
+    static float LodErrorPixels;        // screen space error a level of detail may show
+    static int ShadowLodBias;           // extra levels dropped in the shadow pass
+    static bool QuantizePositions;      // 16-bit vertex positions for meshes imported from now on
+    static bool UseMeshCache;           // load models from their MeshCache file when it is valid
+    static bool UseInstancing;
+    static bool UseMultiDrawIndirect;
+    static bool CacheShadowMaps;
+    static int ZPrePassMode;
+    static float ZPrePassOverdrawThreshold;
     static std::vector<WindowSize> window_size_list;
 };
\ No newline at end of file
@@ -13,6 +13,7 @@ public:
     static const fs::path GetProjectPath()      { return run_path/*.parent_path().parent_path()*/; }
     static const fs::path GetContentPath()      { return GetProjectPath() / "content"; }
     static const fs::path GetEditorPath()       { return GetProjectPath() / "editor"; }
+    static const fs::path GetCachePath()        { return GetProjectPath() / "cache"; }
     static std::vector<fs::path> GetRootPaths();
 private:
     static std::vector<fs::path> root_paths;
@@ -16,7 +16,7 @@ public:
     GLine() {}
     ~GLine() 
     {
-        glDeleteVertexArrays(1, &VAO);
+        GLState::GetInstance()->DeleteVertexArray(VAO);
         glDeleteBuffers(1, &VBO);
     }
 
@@ -26,12 +26,12 @@ public:
         line.end_pos = end;
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
-        glBindVertexArray(VAO);
+        GLState::GetInstance()->BindVertexArray(VAO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(line), &line, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void *)0);
-        glBindVertexArray(0);
+        GLState::GetInstance()->BindVertexArray(0);
     }
 
     void DrawInGlobal()
@@ -39,18 +39,16 @@ public:
         Shader::LoadedShaders["color.fs"]->use();
         Shader::LoadedShaders["color.fs"]->setVec3("color", color);
         Shader::LoadedShaders["color.fs"]->setMat4("model", glm::mat4(1));
-        glBindVertexArray(VAO);
+        GLState::GetInstance()->BindVertexArray(VAO);
         glDrawArrays(GL_LINES, 0, 2);
-        glBindVertexArray(0);
     }
 
     void Draw()
     {
         Shader::LoadedShaders["color.fs"]->use();
         Shader::LoadedShaders["color.fs"]->setVec3("color", color);
-        glBindVertexArray(VAO);
+        GLState::GetInstance()->BindVertexArray(VAO);
         glDrawArrays(GL_LINES, 0, 2);
-        glBindVertexArray(0);
     }
 
 private:
@@ -160,7 +158,7 @@ private:
         // Screen quad VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
+        GLState::GetInstance()->BindVertexArray(quadVAO);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -178,18 +176,17 @@ public:
 
     ~GGrid() 
     {
-        glDeleteVertexArrays(1, &quadVAO);
+        GLState::GetInstance()->DeleteVertexArray(quadVAO);
         glDeleteBuffers(1, &quadVBO);
     }
 
     void Draw()
     {
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        GLState::GetInstance()->Enable(GL_BLEND);
+        GLState::GetInstance()->BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         shader->use();
-        glBindVertexArray(quadVAO);
+        GLState::GetInstance()->BindVertexArray(quadVAO);
         glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
-        glDisable(GL_BLEND);
+        GLState::GetInstance()->Disable(GL_BLEND);
     }
 };
\ No newline at end of file
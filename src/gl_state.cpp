@@ -0,0 +1,225 @@
+#include "gl_state.h"
+
+void GLState::Invalidate()
+{
+    program = UNKNOWN;
+    vao = UNKNOWN;
+    active_unit = UNKNOWN;
+    for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+    {
+        for (int t = 0; t < TARGET_COUNT; t++)
+        {
+            textures[i][t] = UNKNOWN;
+        }
+        samplers[i] = UNKNOWN;
+    }
+    for (int i = 0; i < CAP_COUNT; i++)
+    {
+        caps[i] = UNKNOWN;
+    }
+    cull_face = UNKNOWN;
+    depth_func = UNKNOWN;
+    depth_mask = UNKNOWN;
+    color_mask = UNKNOWN;
+    blend_src = UNKNOWN;
+    blend_dst = UNKNOWN;
+    polygon_mode = UNKNOWN;
+    read_framebuffer = UNKNOWN;
+    draw_framebuffer = UNKNOWN;
+    viewport_known = false;
+}
+
+void GLState::BeginFrame()
+{
+    last_issued = issued;
+    last_filtered = filtered;
+    issued = 0;
+    filtered = 0;
+    Invalidate();
+}
+
+int GLState::CapIndex(GLenum cap)
+{
+    switch (cap)
+    {
+    case GL_DEPTH_TEST: return CAP_DEPTH_TEST;
+    case GL_CULL_FACE:  return CAP_CULL_FACE;
+    case GL_BLEND:      return CAP_BLEND;
+    default:            return -1;
+    }
+}
+
+int GLState::TargetIndex(GLenum target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D:         return TARGET_2D;
+    case GL_TEXTURE_CUBE_MAP:   return TARGET_CUBE_MAP;
+    case GL_TEXTURE_2D_ARRAY:   return TARGET_2D_ARRAY;
+    default:                    return -1;
+    }
+}
+
+void GLState::UseProgram(unsigned int _program)
+{
+    if (Redundant(program == _program)) return;
+    program = _program;
+    glUseProgram(_program);
+}
+
+void GLState::BindVertexArray(unsigned int _vao)
+{
+    if (Redundant(vao == _vao)) return;
+    vao = _vao;
+    glBindVertexArray(_vao);
+}
+
+void GLState::ActiveTexture(unsigned int unit)
+{
+    if (Redundant(active_unit == unit)) return;
+    active_unit = unit;
+    glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GLState::BindTexture(GLenum target, unsigned int texture)
+{
+    if (active_unit == UNKNOWN)
+    {
+        ActiveTexture(0);
+    }
+    BindTexture(active_unit, target, texture);
+}
+
+void GLState::BindTexture(unsigned int unit, GLenum target, unsigned int texture)
+{
+    int t = TargetIndex(target);
+    bool known = t >= 0 && unit < MAX_TEXTURE_UNITS;
+    if (Redundant(known && textures[unit][t] == texture)) return;
+    if (known)
+    {
+        textures[unit][t] = texture;
+    }
+    ActiveTexture(unit);
+    glBindTexture(target, texture);
+}
+
+void GLState::BindSampler(unsigned int unit, unsigned int sampler)
+{
+    bool known = unit < MAX_TEXTURE_UNITS;
+    if (Redundant(known && samplers[unit] == sampler)) return;
+    if (known)
+    {
+        samplers[unit] = sampler;
+    }
+    glBindSampler(unit, sampler);
+}
+
+void GLState::SetEnabled(GLenum cap, bool enabled)
+{
+    int c = CapIndex(cap);
+    if (Redundant(c >= 0 && caps[c] == (unsigned int)enabled)) return;
+    if (c >= 0)
+    {
+        caps[c] = enabled;
+    }
+    if (enabled) glEnable(cap);
+    else glDisable(cap);
+}
+
+void GLState::CullFace(GLenum mode)
+{
+    if (Redundant(cull_face == mode)) return;
+    cull_face = mode;
+    glCullFace(mode);
+}
+
+void GLState::DepthFunc(GLenum func)
+{
+    if (Redundant(depth_func == func)) return;
+    depth_func = func;
+    glDepthFunc(func);
+}
+
+void GLState::DepthMask(bool write)
+{
+    if (Redundant(depth_mask == (unsigned int)write)) return;
+    depth_mask = write;
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void GLState::ColorMask(bool write)
+{
+    if (Redundant(color_mask == (unsigned int)write)) return;
+    color_mask = write;
+    GLboolean value = write ? GL_TRUE : GL_FALSE;
+    glColorMask(value, value, value, value);
+}
+
+void GLState::BlendFunc(GLenum src, GLenum dst)
+{
+    if (Redundant(blend_src == src && blend_dst == dst)) return;
+    blend_src = src;
+    blend_dst = dst;
+    glBlendFunc(src, dst);
+}
+
+void GLState::PolygonMode(GLenum mode)
+{
+    if (Redundant(polygon_mode == mode)) return;
+    polygon_mode = mode;
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void GLState::BindFramebuffer(GLenum target, unsigned int framebuffer)
+{
+    bool read = (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER);
+    bool draw = (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER);
+    if (Redundant((!read || read_framebuffer == framebuffer) && (!draw || draw_framebuffer == framebuffer))) return;
+    if (read) read_framebuffer = framebuffer;
+    if (draw) draw_framebuffer = framebuffer;
+    glBindFramebuffer(target, framebuffer);
+}
+
+void GLState::Viewport(int x, int y, int width, int height)
+{
+    if (Redundant(viewport_known && viewport[0] == x && viewport[1] == y && viewport[2] == width && viewport[3] == height)) return;
+    viewport[0] = x;
+    viewport[1] = y;
+    viewport[2] = width;
+    viewport[3] = height;
+    viewport_known = true;
+    glViewport(x, y, width, height);
+}
+
+void GLState::DeleteTexture(unsigned int texture)
+{
+    // GL unbinds a deleted texture from every unit
+    for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+    {
+        for (int t = 0; t < TARGET_COUNT; t++)
+        {
+            if (textures[i][t] == texture) textures[i][t] = 0;
+        }
+    }
+    glDeleteTextures(1, &texture);
+}
+
+void GLState::DeleteVertexArray(unsigned int _vao)
+{
+    if (vao == _vao) vao = 0;
+    glDeleteVertexArrays(1, &_vao);
+}
+
+void GLState::DeleteProgram(unsigned int _program)
+{
+    // a program in use is only flagged for deletion, the binding stays
+    glDeleteProgram(_program);
+    if (program == _program) program = UNKNOWN;
+}
+
+void GLState::DeleteFramebuffer(unsigned int framebuffer)
+{
+    if (read_framebuffer == framebuffer) read_framebuffer = 0;
+    if (draw_framebuffer == framebuffer) draw_framebuffer = 0;
+    glDeleteFramebuffers(1, &framebuffer);
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <glad/glad.h>
+#include "singleton_util.h"
+
+/*****************************************************
+* Shadow copy of the GL state the renderer touches.
+* A call that would set the value already current is
+* dropped and counted as filtered. Any code changing
+* the same state must go through here (ImGui restores
+* what it changes), deleted objects must be reported
+* since GL reuses their names.
+*****************************************************/
+class GLState : public Singleton<GLState>
+{
+public:
+    static const int MAX_TEXTURE_UNITS = 32;
+
+    GLState() { Invalidate(); }
+
+    // forget everything, the next call of each kind is always issued
+    void Invalidate();
+    // store last frame's counters, reset them and invalidate
+    void BeginFrame();
+
+    void UseProgram         (unsigned int program);
+    void BindVertexArray    (unsigned int vao);
+    void ActiveTexture      (unsigned int unit);
+    void BindTexture        (GLenum target, unsigned int texture);                     // on the active unit
+    void BindTexture        (unsigned int unit, GLenum target, unsigned int texture);
+    void BindSampler        (unsigned int unit, unsigned int sampler);
+    void SetEnabled         (GLenum cap, bool enabled);
+    void Enable             (GLenum cap)        { SetEnabled(cap, true);    }
+    void Disable            (GLenum cap)        { SetEnabled(cap, false);   }
+    void CullFace           (GLenum mode);
+    void DepthFunc          (GLenum func);
+    void DepthMask          (bool write);
+    void ColorMask          (bool write);       // all four channels together
+    void BlendFunc          (GLenum src, GLenum dst);
+    void PolygonMode        (GLenum mode);      // always GL_FRONT_AND_BACK in core profile
+    void BindFramebuffer    (GLenum target, unsigned int framebuffer);
+    void Viewport           (int x, int y, int width, int height);
+
+    void DeleteTexture      (unsigned int texture);
+    void DeleteVertexArray  (unsigned int vao);
+    void DeleteProgram      (unsigned int program);
+    void DeleteFramebuffer  (unsigned int framebuffer);
+
+    unsigned int issued = 0;            // calls passed to GL this frame
+    unsigned int filtered = 0;          // redundant calls dropped this frame
+    unsigned int last_issued = 0;
+    unsigned int last_filtered = 0;
+
+private:
+    enum ECap
+    {
+        CAP_DEPTH_TEST = 0,
+        CAP_CULL_FACE,
+        CAP_BLEND,
+        CAP_COUNT
+    };
+    enum ETextureTarget
+    {
+        TARGET_2D = 0,
+        TARGET_CUBE_MAP,
+        TARGET_2D_ARRAY,
+        TARGET_COUNT
+    };
+    static const unsigned int UNKNOWN = 0xFFFFFFFF;
+
+    // returns true (and counts it) if the call can be dropped
+    bool Redundant(bool redundant)
+    {
+        if (redundant) filtered++;
+        else issued++;
+        return redundant;
+    }
+    static int CapIndex(GLenum cap);
+    static int TargetIndex(GLenum target);
+
+    unsigned int program;
+    unsigned int vao;
+    unsigned int active_unit;
+    unsigned int textures[MAX_TEXTURE_UNITS][TARGET_COUNT];
+    unsigned int samplers[MAX_TEXTURE_UNITS];
+    unsigned int caps[CAP_COUNT];
+    unsigned int cull_face;
+    unsigned int depth_func;
+    unsigned int depth_mask;
+    unsigned int color_mask;
+    unsigned int blend_src;
+    unsigned int blend_dst;
+    unsigned int polygon_mode;
+    unsigned int read_framebuffer;
+    unsigned int draw_framebuffer;
+    int          viewport[4];
+    bool         viewport_known;
+};
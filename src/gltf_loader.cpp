@@ -0,0 +1,1078 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "gltf_loader.h"
+#include "model.h"
+#include "mapped_file.h"
+#include "job_pool.h"
+#include "renderer_console.h"
+
+#define JSON_MAX_DEPTH 128
+#define GLTF_MAX_NODE_DEPTH 64
+
+namespace
+{
+    const uint32_t GLB_MAGIC        = 0x46546C67;  // "glTF"
+    const uint32_t GLB_CHUNK_JSON   = 0x4E4F534A;
+    const uint32_t GLB_CHUNK_BIN    = 0x004E4942;
+
+    enum EComponentType
+    {
+        COMPONENT_BYTE              = 5120,
+        COMPONENT_UNSIGNED_BYTE     = 5121,
+        COMPONENT_SHORT             = 5122,
+        COMPONENT_UNSIGNED_SHORT    = 5123,
+        COMPONENT_UNSIGNED_INT      = 5125,
+        COMPONENT_FLOAT             = 5126,
+    };
+
+    const int PRIMITIVE_TRIANGLES = 4;
+
+    /*****************************************************
+    * Just enough JSON for glTF: a tree of values, object
+    * members kept in file order. Lookups of a missing key
+    * or index give a null value, so chained lookups of
+    * optional properties need no checks in between.
+    *****************************************************/
+    struct JsonValue
+    {
+        enum EType { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+        EType                       type = NUL;
+        bool                        boolean = false;
+        double                      number = 0;
+        std::string                 string;
+        std::vector<JsonValue>      items;      // array elements or object values
+        std::vector<std::string>    keys;       // object keys, parallel to items
+
+        const JsonValue& operator[](const char* key) const
+        {
+            for (size_t i = 0; type == OBJECT && i < keys.size(); i++)
+            {
+                if (keys[i] == key) return items[i];
+            }
+            return Null();
+        }
+        const JsonValue& operator[](size_t index) const
+        {
+            return type == ARRAY && index < items.size() ? items[index] : Null();
+        }
+        // negative indices come from Int() of a missing property
+        const JsonValue& operator[](int index) const { return index < 0 ? Null() : (*this)[(size_t)index]; }
+
+        size_t Size() const { return type == ARRAY ? items.size() : 0; }
+        double Number(double fallback) const { return type == NUMBER ? number : fallback; }
+        int Int(int fallback = -1) const { return type == NUMBER ? (int)number : fallback; }
+
+        static const JsonValue& Null()
+        {
+            static const JsonValue null_value;
+            return null_value;
+        }
+    };
+
+    class JsonParser
+    {
+    public:
+        JsonParser(const char* _begin, const char* _end) : p(_begin), end(_end) {}
+
+        bool Parse(JsonValue& value)
+        {
+            return ParseValue(value, 0);
+        }
+
+    private:
+        void SkipSpace()
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+        }
+
+        bool Literal(const char* word)
+        {
+            size_t length = strlen(word);
+            if ((size_t)(end - p) < length || strncmp(p, word, length) != 0)
+            {
+                return false;
+            }
+            p += length;
+            return true;
+        }
+
+        bool ParseValue(JsonValue& value, int depth)
+        {
+            SkipSpace();
+            if (p >= end || depth > JSON_MAX_DEPTH)
+            {
+                return false;
+            }
+            switch (*p)
+            {
+            case '{':
+                return ParseObject(value, depth);
+            case '[':
+                return ParseArray(value, depth);
+            case '"':
+                value.type = JsonValue::STRING;
+                return ParseString(value.string);
+            case 't':
+                value.type = JsonValue::BOOLEAN;
+                value.boolean = true;
+                return Literal("true");
+            case 'f':
+                value.type = JsonValue::BOOLEAN;
+                return Literal("false");
+            case 'n':
+                return Literal("null");
+            default:
+                return ParseNumber(value);
+            }
+        }
+
+        bool ParseNumber(JsonValue& value)
+        {
+            // the buffer isn't null terminated, strtod gets a copy
+            char digits[64];
+            size_t length = 0;
+            while (p < end && length + 1 < sizeof(digits) && strchr("+-0123456789.eE", *p) != nullptr && *p != '\0')
+            {
+                digits[length++] = *p++;
+            }
+            digits[length] = '\0';
+            char* stop = nullptr;
+            value.type = JsonValue::NUMBER;
+            value.number = strtod(digits, &stop);
+            return length > 0 && stop == digits + length;
+        }
+
+        bool ParseHex4(unsigned int& code)
+        {
+            code = 0;
+            for (int i = 0; i < 4; i++, p++)
+            {
+                if (p >= end) return false;
+                char c = *p;
+                code <<= 4;
+                if (c >= '0' && c <= '9')       code |= c - '0';
+                else if (c >= 'a' && c <= 'f')  code |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F')  code |= c - 'A' + 10;
+                else return false;
+            }
+            return true;
+        }
+
+        static void AppendUtf8(std::string& out, unsigned int code)
+        {
+            if (code < 0x80)
+            {
+                out += (char)code;
+            }
+            else if (code < 0x800)
+            {
+                out += (char)(0xC0 | (code >> 6));
+                out += (char)(0x80 | (code & 0x3F));
+            }
+            else if (code < 0x10000)
+            {
+                out += (char)(0xE0 | (code >> 12));
+                out += (char)(0x80 | ((code >> 6) & 0x3F));
+                out += (char)(0x80 | (code & 0x3F));
+            }
+            else
+            {
+                out += (char)(0xF0 | (code >> 18));
+                out += (char)(0x80 | ((code >> 12) & 0x3F));
+                out += (char)(0x80 | ((code >> 6) & 0x3F));
+                out += (char)(0x80 | (code & 0x3F));
+            }
+        }
+
+        bool ParseString(std::string& out)
+        {
+            p++;    // opening quote
+            while (p < end)
+            {
+                char c = *p++;
+                if (c == '"')
+                {
+                    return true;
+                }
+                if (c != '\\')
+                {
+                    out += c;
+                    continue;
+                }
+                if (p >= end) return false;
+                c = *p++;
+                switch (c)
+                {
+                case '"': case '\\': case '/': out += c; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u':
+                {
+                    unsigned int code;
+                    if (!ParseHex4(code)) return false;
+                    // a surrogate pair spells one code point past the BMP
+                    unsigned int low;
+                    if (code >= 0xD800 && code < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+                    {
+                        p += 2;
+                        if (!ParseHex4(low)) return false;
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    AppendUtf8(out, code);
+                    break;
+                }
+                default:
+                    return false;
+                }
+            }
+            return false;
+        }
+
+        bool ParseArray(JsonValue& value, int depth)
+        {
+            value.type = JsonValue::ARRAY;
+            p++;
+            SkipSpace();
+            if (p < end && *p == ']')
+            {
+                p++;
+                return true;
+            }
+            while (true)
+            {
+                value.items.emplace_back();
+                if (!ParseValue(value.items.back(), depth + 1)) return false;
+                SkipSpace();
+                if (p >= end) return false;
+                char c = *p++;
+                if (c == ']') return true;
+                if (c != ',') return false;
+            }
+        }
+
+        bool ParseObject(JsonValue& value, int depth)
+        {
+            value.type = JsonValue::OBJECT;
+            p++;
+            SkipSpace();
+            if (p < end && *p == '}')
+            {
+                p++;
+                return true;
+            }
+            while (true)
+            {
+                SkipSpace();
+                if (p >= end || *p != '"') return false;
+                value.keys.emplace_back();
+                if (!ParseString(value.keys.back())) return false;
+                SkipSpace();
+                if (p >= end || *p++ != ':') return false;
+                value.items.emplace_back();
+                if (!ParseValue(value.items.back(), depth + 1)) return false;
+                SkipSpace();
+                if (p >= end) return false;
+                char c = *p++;
+                if (c == '}') return true;
+                if (c != ',') return false;
+            }
+        }
+
+        const char* p;
+        const char* end;
+    };
+
+    bool IsDataUri(const std::string& uri)
+    {
+        return uri.compare(0, 5, "data:") == 0;
+    }
+
+    // the payload of a base64 data URI
+    bool DecodeDataUri(const std::string& uri, std::vector<unsigned char>& out)
+    {
+        size_t start = uri.find(";base64,");
+        if (start == std::string::npos)
+        {
+            return false;
+        }
+        unsigned int bits = 0;
+        int bit_count = 0;
+        for (size_t i = start + 8; i < uri.size() && uri[i] != '='; i++)
+        {
+            char c = uri[i];
+            int value;
+            if (c >= 'A' && c <= 'Z')       value = c - 'A';
+            else if (c >= 'a' && c <= 'z')  value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9')  value = c - '0' + 52;
+            else if (c == '+')              value = 62;
+            else if (c == '/')              value = 63;
+            else return false;
+            bits = (bits << 6) | value;
+            bit_count += 6;
+            if (bit_count >= 8)
+            {
+                bit_count -= 8;
+                out.push_back((unsigned char)(bits >> bit_count));
+            }
+        }
+        return true;
+    }
+
+    // relative URIs may escape spaces and other characters as %XX
+    std::string DecodeUri(const std::string& uri)
+    {
+        std::string result;
+        for (size_t i = 0; i < uri.size(); i++)
+        {
+            if (uri[i] == '%' && i + 2 < uri.size())
+            {
+                result += (char)strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16);
+                i += 2;
+            }
+            else
+            {
+                result += uri[i];
+            }
+        }
+        return result;
+    }
+
+    struct GltfBuffer
+    {
+        const unsigned char*    data = nullptr;
+        size_t                  size = 0;
+    };
+
+    struct GltfDocument
+    {
+        std::string                                 path;
+        std::string                                 directory;
+        JsonValue                                   json;
+        MappedFile                                  file;               // the .gltf or .glb itself
+        std::vector<GltfBuffer>                     buffers;
+        std::vector<std::unique_ptr<MappedFile>>    buffer_files;       // external .bin files
+        std::vector<std::vector<unsigned char>>     decoded_buffers;    // data URIs
+    };
+
+    bool OpenDocument(const std::string& path, GltfDocument& doc, std::string& error)
+    {
+        doc.path = path;
+        std::replace(doc.path.begin(), doc.path.end(), '\\', '/');
+        size_t slash = doc.path.find_last_of('/');
+        doc.directory = slash == std::string::npos ? "." : doc.path.substr(0, slash);
+        if (!doc.file.Open(path))
+        {
+            error = "can't read the file";
+            return false;
+        }
+
+        // a .glb holds the JSON and the first buffer as chunks of one file
+        const unsigned char* data = doc.file.Data();
+        const unsigned char* json_begin = data;
+        size_t json_size = doc.file.Size();
+        GltfBuffer bin;
+        uint32_t header[3];
+        if (doc.file.Size() >= sizeof(header) && (memcpy(header, data, sizeof(header)), header[0] == GLB_MAGIC))
+        {
+            if (header[1] != 2)
+            {
+                error = "unsupported GLB version";
+                return false;
+            }
+            size_t length = std::min<size_t>(header[2], doc.file.Size());
+            size_t offset = sizeof(header);
+            json_begin = nullptr;
+            while (offset + 8 <= length)
+            {
+                uint32_t chunk[2];
+                memcpy(chunk, data + offset, sizeof(chunk));
+                offset += sizeof(chunk);
+                if (chunk[0] > length - offset)
+                {
+                    break;
+                }
+                if (chunk[1] == GLB_CHUNK_JSON && json_begin == nullptr)
+                {
+                    json_begin = data + offset;
+                    json_size = chunk[0];
+                }
+                else if (chunk[1] == GLB_CHUNK_BIN && bin.data == nullptr)
+                {
+                    bin = { data + offset, chunk[0] };
+                }
+                offset += (chunk[0] + 3) & ~3u;
+            }
+            if (json_begin == nullptr)
+            {
+                error = "GLB without a JSON chunk";
+                return false;
+            }
+        }
+
+        JsonParser parser((const char*)json_begin, (const char*)json_begin + json_size);
+        if (!parser.Parse(doc.json) || doc.json.type != JsonValue::OBJECT)
+        {
+            error = "malformed JSON";
+            return false;
+        }
+        if (doc.json["asset"]["version"].string.compare(0, 2, "2.") != 0)
+        {
+            error = "not a glTF 2.0 asset";
+            return false;
+        }
+
+        const JsonValue& buffers = doc.json["buffers"];
+        doc.buffers.resize(buffers.Size());
+        for (size_t i = 0; i < buffers.Size(); i++)
+        {
+            const JsonValue& uri = buffers[i]["uri"];
+            if (uri.type != JsonValue::STRING)
+            {
+                if (i == 0) doc.buffers[i] = bin;
+            }
+            else if (IsDataUri(uri.string))
+            {
+                doc.decoded_buffers.emplace_back();
+                if (DecodeDataUri(uri.string, doc.decoded_buffers.back()))
+                {
+                    doc.buffers[i] = { doc.decoded_buffers.back().data(), doc.decoded_buffers.back().size() };
+                }
+            }
+            else
+            {
+                std::unique_ptr<MappedFile> file(new MappedFile());
+                if (file->Open(doc.directory + '/' + DecodeUri(uri.string)))
+                {
+                    doc.buffers[i] = { file->Data(), file->Size() };
+                    doc.buffer_files.push_back(std::move(file));
+                }
+            }
+            // a buffer shorter than it claims can't be trusted, its accessors fail instead
+            if (doc.buffers[i].size < (size_t)buffers[i]["byteLength"].Number(0))
+            {
+                doc.buffers[i] = GltfBuffer();
+            }
+        }
+        return true;
+    }
+
+    // byte range of a bufferView, false if it lies outside its buffer
+    bool GetBufferView(const GltfDocument& doc, int index, const unsigned char*& data, size_t& size, size_t& stride)
+    {
+        const JsonValue& view = doc.json["bufferViews"][index];
+        int buffer = view["buffer"].Int();
+        if (view.type != JsonValue::OBJECT || buffer < 0 || (size_t)buffer >= doc.buffers.size() || doc.buffers[buffer].data == nullptr)
+        {
+            return false;
+        }
+        size_t offset = (size_t)view["byteOffset"].Number(0);
+        size = (size_t)view["byteLength"].Number(0);
+        stride = (size_t)view["byteStride"].Number(0);
+        if (offset > doc.buffers[buffer].size || size > doc.buffers[buffer].size - offset)
+        {
+            return false;
+        }
+        data = doc.buffers[buffer].data + offset;
+        return true;
+    }
+
+    // an accessor's elements where they lie in the buffer
+    struct AccessorView
+    {
+        const unsigned char*    data = nullptr;
+        size_t                  count = 0;
+        size_t                  stride = 0;
+        int                     component_type = 0;
+        int                     components = 0;
+        bool                    normalized = false;
+    };
+
+    int ComponentSize(int component_type)
+    {
+        switch (component_type)
+        {
+        case COMPONENT_BYTE:
+        case COMPONENT_UNSIGNED_BYTE:   return 1;
+        case COMPONENT_SHORT:
+        case COMPONENT_UNSIGNED_SHORT:  return 2;
+        case COMPONENT_UNSIGNED_INT:
+        case COMPONENT_FLOAT:           return 4;
+        default:                        return 0;
+        }
+    }
+
+    int ComponentCount(const std::string& type)
+    {
+        if (type == "SCALAR")   return 1;
+        if (type == "VEC2")     return 2;
+        if (type == "VEC3")     return 3;
+        if (type == "VEC4")     return 4;
+        return 0;               // matrices aren't vertex attributes
+    }
+
+    // false for a missing, sparse or out of range accessor, or one without the expected component count
+    bool GetAccessor(const GltfDocument& doc, int index, int components, AccessorView& view)
+    {
+        const JsonValue& accessor = doc.json["accessors"][index];
+        if (accessor.type != JsonValue::OBJECT || accessor["sparse"].type != JsonValue::NUL)
+        {
+            return false;
+        }
+        view.count = (size_t)accessor["count"].Number(0);
+        view.component_type = accessor["componentType"].Int(0);
+        view.components = ComponentCount(accessor["type"].string);
+        view.normalized = accessor["normalized"].boolean;
+        size_t element = (size_t)ComponentSize(view.component_type) * view.components;
+        size_t size;
+        if (element == 0 || view.components != components || !GetBufferView(doc, accessor["bufferView"].Int(), view.data, size, view.stride))
+        {
+            return false;
+        }
+        size_t offset = (size_t)accessor["byteOffset"].Number(0);
+        view.stride = view.stride != 0 ? view.stride : element;
+        if (view.count == 0 || offset > size || element > size - offset || (view.count - 1) > (size - offset - element) / view.stride)
+        {
+            return false;
+        }
+        view.data += offset;
+        return true;
+    }
+
+    float ReadComponent(const unsigned char* p, int component_type, bool normalized)
+    {
+        switch (component_type)
+        {
+        case COMPONENT_FLOAT:           { float v;    memcpy(&v, p, 4); return v; }
+        case COMPONENT_UNSIGNED_BYTE:   { return normalized ? p[0] / 255.0f : p[0]; }
+        case COMPONENT_BYTE:            { int8_t v = (int8_t)p[0]; return normalized ? std::max(v / 127.0f, -1.0f) : v; }
+        case COMPONENT_UNSIGNED_SHORT:  { uint16_t v; memcpy(&v, p, 2); return normalized ? v / 65535.0f : v; }
+        case COMPONENT_SHORT:           { int16_t v;  memcpy(&v, p, 2); return normalized ? std::max(v / 32767.0f, -1.0f) : v; }
+        case COMPONENT_UNSIGNED_INT:    { uint32_t v; memcpy(&v, p, 4); return (float)v; }
+        default:                        return 0;
+        }
+    }
+
+    // element i of the accessor as floats, out holds view.components of them
+    void ReadElement(const AccessorView& view, size_t i, float* out)
+    {
+        const unsigned char* p = view.data + i * view.stride;
+        int size = ComponentSize(view.component_type);
+        for (int c = 0; c < view.components; c++)
+        {
+            out[c] = ReadComponent(p + c * size, view.component_type, view.normalized);
+        }
+    }
+
+    unsigned int ReadIndex(const AccessorView& view, size_t i)
+    {
+        const unsigned char* p = view.data + i * view.stride;
+        switch (view.component_type)
+        {
+        case COMPONENT_UNSIGNED_BYTE:   return p[0];
+        case COMPONENT_UNSIGNED_SHORT:  { uint16_t v; memcpy(&v, p, 2); return v; }
+        case COMPONENT_UNSIGNED_INT:    { uint32_t v; memcpy(&v, p, 4); return v; }
+        default:                        return 0xFFFFFFFF;
+        }
+    }
+
+    glm::mat4 NodeMatrix(const JsonValue& node)
+    {
+        const JsonValue& matrix = node["matrix"];
+        if (matrix.Size() == 16)
+        {
+            // column major like glm
+            glm::mat4 result;
+            for (int i = 0; i < 16; i++)
+            {
+                glm::value_ptr(result)[i] = (float)matrix[i].Number(0);
+            }
+            return result;
+        }
+        const JsonValue& t = node["translation"];
+        const JsonValue& r = node["rotation"];
+        const JsonValue& s = node["scale"];
+        glm::vec3 translation(t[0].Number(0), t[1].Number(0), t[2].Number(0));
+        glm::quat rotation((float)r[3].Number(1), (float)r[0].Number(0), (float)r[1].Number(0), (float)r[2].Number(0));
+        glm::vec3 scale(s[0].Number(1), s[1].Number(1), s[2].Number(1));
+        return glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+    }
+
+    // a mesh placed by a node
+    struct MeshInstance
+    {
+        int         mesh;
+        glm::mat4   transform;
+    };
+
+    void CollectNodes(const GltfDocument& doc, int node_index, const glm::mat4& parent, int depth, std::vector<MeshInstance>& found)
+    {
+        const JsonValue& node = doc.json["nodes"][node_index];
+        // the depth limit also stops cycles of a malformed file
+        if (node.type != JsonValue::OBJECT || depth > GLTF_MAX_NODE_DEPTH)
+        {
+            return;
+        }
+        glm::mat4 world = parent * NodeMatrix(node);
+        if (node["mesh"].type == JsonValue::NUMBER)
+        {
+            found.push_back({ node["mesh"].Int(), world });
+        }
+        const JsonValue& children = node["children"];
+        for (size_t i = 0; i < children.Size(); i++)
+        {
+            CollectNodes(doc, children[i].Int(), world, depth + 1, found);
+        }
+    }
+
+    // like aiProcess_GenSmoothNormals: area weighted face normals summed per vertex
+    void GenerateNormals(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+    {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            Vertex& v0 = vertices[indices[i]];
+            Vertex& v1 = vertices[indices[i + 1]];
+            Vertex& v2 = vertices[indices[i + 2]];
+            glm::vec3 normal = glm::cross(v1.Position - v0.Position, v2.Position - v0.Position);
+            v0.Normal += normal;
+            v1.Normal += normal;
+            v2.Normal += normal;
+        }
+        for (Vertex& v : vertices)
+        {
+            float length = glm::length(v.Normal);
+            v.Normal = length > 0 ? v.Normal / length : glm::vec3(0, 1, 0);
+        }
+    }
+
+    // like aiProcess_CalcTangentSpace: per triangle UV gradients summed per vertex
+    void GenerateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+    {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            Vertex& v0 = vertices[indices[i]];
+            Vertex& v1 = vertices[indices[i + 1]];
+            Vertex& v2 = vertices[indices[i + 2]];
+            glm::vec3 e1 = v1.Position - v0.Position;
+            glm::vec3 e2 = v2.Position - v0.Position;
+            glm::vec2 d1 = v1.TexCoords - v0.TexCoords;
+            glm::vec2 d2 = v2.TexCoords - v0.TexCoords;
+            float det = d1.x * d2.y - d2.x * d1.y;
+            if (std::fabs(det) < 1e-12f)
+            {
+                continue;
+            }
+            glm::vec3 tangent = (e1 * d2.y - e2 * d1.y) / det;
+            glm::vec3 bitangent = (e2 * d1.x - e1 * d2.x) / det;
+            for (Vertex* v : { &v0, &v1, &v2 })
+            {
+                v->Tangent += tangent;
+                v->Bitangent += bitangent;
+            }
+        }
+        for (Vertex& v : vertices)
+        {
+            glm::vec3 tangent = v.Tangent - v.Normal * glm::dot(v.Normal, v.Tangent);
+            float length = glm::length(tangent);
+            v.Tangent = length > 0 ? tangent / length : glm::vec3(0);
+            length = glm::length(v.Bitangent);
+            v.Bitangent = length > 0 ? v.Bitangent / length : glm::vec3(0);
+        }
+    }
+
+    // one triangle primitive of a placed mesh
+    struct PrimitiveJob
+    {
+        int         mesh;
+        int         primitive;
+        glm::mat4   transform;
+    };
+
+    // read one primitive into result and prepare it, message says why when it's skipped
+    bool ImportPrimitive(const GltfDocument& doc, const PrimitiveJob& job, ImportedMesh& result, std::string& message)
+    {
+        const JsonValue& mesh = doc.json["meshes"][job.mesh];
+        const JsonValue& primitive = mesh["primitives"][job.primitive];
+        const JsonValue& attributes = primitive["attributes"];
+        if (primitive["mode"].Int(PRIMITIVE_TRIANGLES) != PRIMITIVE_TRIANGLES)
+        {
+            message = "not a triangle list";
+            return false;
+        }
+        AccessorView positions, normals, uvs, tangents, joints, weights, index_view;
+        if (!GetAccessor(doc, attributes["POSITION"].Int(), 3, positions))
+        {
+            message = "no readable POSITION";
+            return false;
+        }
+        size_t count = positions.count;
+        bool has_normals = GetAccessor(doc, attributes["NORMAL"].Int(), 3, normals) && normals.count == count;
+        bool has_uvs = GetAccessor(doc, attributes["TEXCOORD_0"].Int(), 2, uvs) && uvs.count == count;
+        bool has_tangents = has_uvs && GetAccessor(doc, attributes["TANGENT"].Int(), 4, tangents) && tangents.count == count;
+        bool skinned = GetAccessor(doc, attributes["JOINTS_0"].Int(), 4, joints) && joints.count == count &&
+                       GetAccessor(doc, attributes["WEIGHTS_0"].Int(), 4, weights) && weights.count == count;
+
+        vector<Vertex>& vertices = result.vertices;
+        vector<unsigned int>& indices = result.indices;
+        vertices.resize(count);     // value initialized, zeroed for the welder
+        float value[4];
+        for (size_t i = 0; i < count; i++)
+        {
+            Vertex& v = vertices[i];
+            ReadElement(positions, i, value);
+            v.Position = glm::vec3(value[0], value[1], value[2]);
+            if (has_normals)
+            {
+                ReadElement(normals, i, value);
+                v.Normal = glm::vec3(value[0], value[1], value[2]);
+            }
+            if (has_uvs)
+            {
+                ReadElement(uvs, i, value);
+                v.TexCoords = glm::vec2(value[0], value[1]);
+            }
+            if (skinned)
+            {
+                ReadElement(joints, i, value);
+                for (int b = 0; b < MAX_BONE_INFLUENCE; b++) v.m_BoneIDs[b] = (int)value[b];
+                ReadElement(weights, i, value);
+                float total = value[0] + value[1] + value[2] + value[3];
+                for (int b = 0; b < MAX_BONE_INFLUENCE; b++) v.m_Weights[b] = total > 0 ? value[b] / total : 0;
+            }
+        }
+
+        if (primitive["indices"].type == JsonValue::NUMBER)
+        {
+            if (!GetAccessor(doc, primitive["indices"].Int(), 1, index_view))
+            {
+                message = "unreadable indices";
+                return false;
+            }
+            indices.resize(index_view.count);
+            for (size_t i = 0; i < index_view.count; i++)
+            {
+                indices[i] = ReadIndex(index_view, i);
+                if (indices[i] >= count)
+                {
+                    message = "index out of range";
+                    return false;
+                }
+            }
+        }
+        else
+        {
+            indices.resize(count);
+            for (size_t i = 0; i < count; i++) indices[i] = (unsigned int)i;
+        }
+        if (indices.size() < 3 || indices.size() % 3 != 0)
+        {
+            message = "not a whole number of triangles";
+            return false;
+        }
+
+        if (!has_normals)
+        {
+            GenerateNormals(vertices, indices);
+        }
+        if (has_tangents)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                ReadElement(tangents, i, value);
+                vertices[i].Tangent = glm::vec3(value[0], value[1], value[2]);
+                vertices[i].Bitangent = glm::cross(vertices[i].Normal, vertices[i].Tangent) * (value[3] < 0 ? -1.0f : 1.0f);
+            }
+        }
+        else if (has_uvs)
+        {
+            GenerateTangents(vertices, indices);
+        }
+
+        // the node's world transform goes into the vertices
+        if (job.transform != glm::mat4(1.0f))
+        {
+            glm::mat3 linear(job.transform);
+            glm::mat3 normal_matrix = glm::transpose(glm::inverse(linear));
+            for (Vertex& v : vertices)
+            {
+                v.Position = glm::vec3(job.transform * glm::vec4(v.Position, 1.0f));
+                v.Normal = glm::normalize(normal_matrix * v.Normal);
+                if (v.Tangent != glm::vec3(0)) v.Tangent = glm::normalize(linear * v.Tangent);
+                if (v.Bitangent != glm::vec3(0)) v.Bitangent = glm::normalize(linear * v.Bitangent);
+            }
+            // a mirroring transform turns the winding around
+            if (glm::determinant(linear) < 0)
+            {
+                for (size_t i = 0; i < indices.size(); i += 3) std::swap(indices[i + 1], indices[i + 2]);
+            }
+        }
+
+        result.name = mesh["name"].type == JsonValue::STRING ? mesh["name"].string : "mesh" + std::to_string(job.mesh);
+        if (mesh["primitives"].Size() > 1)
+        {
+            result.name += "_" + std::to_string(job.primitive);
+        }
+        Model::prepareMesh(result);
+        return true;
+    }
+
+    // how a material slot reads its texture
+    enum ETextureUse
+    {
+        TEXTURE_COLOR,      // sRGB
+        TEXTURE_LINEAR,
+        TEXTURE_RED,        // single channels, linear
+        TEXTURE_GREEN,
+        TEXTURE_BLUE,
+    };
+
+    // the PbrMaterialInfo maps in order
+    enum EPbrSlot
+    {
+        SLOT_ALBEDO,
+        SLOT_NORMAL,
+        SLOT_METALLIC,
+        SLOT_ROUGHNESS,
+        SLOT_AO,
+        SLOT_COUNT
+    };
+
+    const ETextureUse SLOT_USE[SLOT_COUNT] = { TEXTURE_COLOR, TEXTURE_LINEAR, TEXTURE_BLUE, TEXTURE_GREEN, TEXTURE_RED };
+
+    const JsonValue& SlotTextureInfo(const JsonValue& material, int slot)
+    {
+        switch (slot)
+        {
+        case SLOT_ALBEDO:       return material["pbrMetallicRoughness"]["baseColorTexture"];
+        case SLOT_NORMAL:       return material["normalTexture"];
+        case SLOT_METALLIC:
+        case SLOT_ROUGHNESS:    return material["pbrMetallicRoughness"]["metallicRoughnessTexture"];
+        case SLOT_AO:           return material["occlusionTexture"];
+        default:                return JsonValue::Null();
+        }
+    }
+
+    // file images are known by their path, embedded ones by the model's
+    std::string ImageKey(const GltfDocument& doc, int image)
+    {
+        const JsonValue& uri = doc.json["images"][image]["uri"];
+        if (uri.type == JsonValue::STRING && !IsDataUri(uri.string))
+        {
+            return doc.directory + '/' + DecodeUri(uri.string);
+        }
+        return doc.path + "#image" + std::to_string(image);
+    }
+
+    // image index a slot's texture reads, -1 for none or one this loader can't map
+    int SlotImage(const GltfDocument& doc, const JsonValue& material, int slot)
+    {
+        const JsonValue& info = SlotTextureInfo(material, slot);
+        // every vertex carries TEXCOORD_0 only
+        if (info.type != JsonValue::OBJECT || info["texCoord"].Int(0) != 0)
+        {
+            return -1;
+        }
+        int image = doc.json["textures"][info["index"].Int()]["source"].Int();
+        return doc.json["images"][image].type == JsonValue::OBJECT ? image : -1;
+    }
+
+    std::string TextureKey(const GltfDocument& doc, int image, ETextureUse use)
+    {
+        static const char* suffix[] = { "", "#linear", "#r", "#g", "#b" };
+        return ImageKey(doc, image) + suffix[use];
+    }
+
+    bool DecodeGltfImage(const GltfDocument& doc, int index, TextureImage& result)
+    {
+        const JsonValue& image = doc.json["images"][index];
+        const JsonValue& uri = image["uri"];
+        if (uri.type == JsonValue::STRING && IsDataUri(uri.string))
+        {
+            std::vector<unsigned char> bytes;
+            return DecodeDataUri(uri.string, bytes) && Texture2D::DecodeImage(bytes.data(), bytes.size(), ImageKey(doc, index), result);
+        }
+        if (uri.type == JsonValue::STRING)
+        {
+            return Texture2D::DecodeImage(ImageKey(doc, index), result);
+        }
+        // embedded: stb_image reads the encoded file straight from the mapped buffer
+        const unsigned char* data;
+        size_t size, stride;
+        result.path = ImageKey(doc, index);
+        return GetBufferView(doc, image["bufferView"].Int(), data, size, stride) && Texture2D::DecodeImage(data, size, result.path, result);
+    }
+
+    // a texture to create: the image it comes from and how it's read
+    struct TextureRequest
+    {
+        int             image;
+        ETextureUse     use;
+        std::string     key;
+    };
+}
+
+bool GltfLoader::IsGltf(const std::string& path)
+{
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".gltf" || extension == ".glb";
+}
+
+bool GltfLoader::Load(const std::string& path, Model* model, std::vector<ImportedMesh>& meshes)
+{
+    GltfDocument doc;
+    std::string error;
+    if (!OpenDocument(path, doc, error))
+    {
+        RendererConsole::GetInstance()->AddError("[error] glTF: %s: %s", path.c_str(), error.c_str());
+        return false;
+    }
+
+    // meshes the scene's nodes place, a file without scenes gets each of its meshes once
+    std::vector<MeshInstance> instances;
+    const JsonValue& scene = doc.json["scenes"][doc.json["scene"].Int(0)];
+    if (scene.type == JsonValue::OBJECT)
+    {
+        const JsonValue& roots = scene["nodes"];
+        for (size_t i = 0; i < roots.Size(); i++)
+        {
+            CollectNodes(doc, roots[i].Int(), glm::mat4(1.0f), 0, instances);
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < doc.json["meshes"].Size(); i++)
+        {
+            instances.push_back({ (int)i, glm::mat4(1.0f) });
+        }
+    }
+    std::vector<PrimitiveJob> jobs;
+    for (const MeshInstance& instance : instances)
+    {
+        for (size_t p = 0; p < doc.json["meshes"][instance.mesh]["primitives"].Size(); p++)
+        {
+            jobs.push_back({ instance.mesh, (int)p, instance.transform });
+        }
+    }
+
+    // textures of the materials used, each decoded once whatever the slots reading it
+    std::vector<TextureRequest> requests;
+    std::set<std::string> requested;
+    std::vector<int> images;
+    for (const PrimitiveJob& job : jobs)
+    {
+        const JsonValue& material = doc.json["materials"][doc.json["meshes"][job.mesh]["primitives"][job.primitive]["material"].Int()];
+        for (int slot = 0; slot < SLOT_COUNT; slot++)
+        {
+            int image = SlotImage(doc, material, slot);
+            if (image < 0)
+            {
+                continue;
+            }
+            std::string key = TextureKey(doc, image, SLOT_USE[slot]);
+            if (model->textures_by_path.count(key) == 0 && requested.insert(key).second)
+            {
+                requests.push_back({ image, SLOT_USE[slot], key });
+                if (std::find(images.begin(), images.end(), image) == images.end())
+                {
+                    images.push_back(image);
+                }
+            }
+        }
+    }
+
+    // primitives and images side by side, nothing in there needs GL
+    std::vector<ImportedMesh> imported(jobs.size());
+    std::vector<std::string> messages(jobs.size());
+    std::vector<char> succeeded(jobs.size(), 0);
+    std::vector<TextureImage> decoded(doc.json["images"].Size());
+    JobPool::GetInstance()->ParallelFor(jobs.size() + images.size(), [&](unsigned int i)
+    {
+        if (i < jobs.size())
+        {
+            succeeded[i] = ImportPrimitive(doc, jobs[i], imported[i], messages[i]);
+        }
+        else
+        {
+            DecodeGltfImage(doc, images[i - jobs.size()], decoded[images[i - jobs.size()]]);
+        }
+    });
+
+    // uploads, a texture that failed to decode leaves its slots at the material's defaults
+    for (const TextureRequest& request : requests)
+    {
+        const TextureImage& image = decoded[request.image];
+        if (image.data == nullptr)
+        {
+            RendererConsole::GetInstance()->AddWarn("Failed to load texture at:  %s", image.path.c_str());
+            continue;
+        }
+        Texture2D* texture;
+        if (request.use >= TEXTURE_RED)
+        {
+            TextureImage channel;
+            Texture2D::ExtractChannel(image, request.use - TEXTURE_RED, channel);
+            texture = new Texture2D(channel, ETexType::RGBA);
+            Texture2D::FreeImage(channel);
+        }
+        else
+        {
+            texture = new Texture2D(image, request.use == TEXTURE_COLOR ? ETexType::SRGBA : ETexType::RGBA);
+        }
+        texture->path = request.key;
+        model->textures_by_path[request.key] = texture;
+        model->textures_loaded.push_back(texture);
+    }
+    for (TextureImage& image : decoded)
+    {
+        Texture2D::FreeImage(image);
+    }
+
+    // metallic-roughness factors and maps onto the meshes, glTF's defaults where the file has none
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        if (!succeeded[i])
+        {
+            RendererConsole::GetInstance()->AddWarn("glTF: skipped primitive %d of mesh %d in %s: %s",
+                jobs[i].primitive, jobs[i].mesh, path.c_str(), messages[i].c_str());
+            continue;
+        }
+        ImportedMesh& mesh = imported[i];
+        const JsonValue& material = doc.json["materials"][doc.json["meshes"][jobs[i].mesh]["primitives"][jobs[i].primitive]["material"].Int()];
+        const JsonValue& pbr = material["pbrMetallicRoughness"];
+        const JsonValue& color = pbr["baseColorFactor"];
+        mesh.pbr.valid = true;
+        mesh.pbr.color = glm::vec3(color[0].Number(1), color[1].Number(1), color[2].Number(1));
+        mesh.pbr.metallic = (float)pbr["metallicFactor"].Number(1);
+        mesh.pbr.roughness = (float)pbr["roughnessFactor"].Number(1);
+        mesh.pbr.ao = (float)material["occlusionTexture"]["strength"].Number(1);
+        Texture2D** maps[SLOT_COUNT] = { &mesh.pbr.albedo_map, &mesh.pbr.normal_map, &mesh.pbr.metallic_map, &mesh.pbr.roughness_map, &mesh.pbr.ao_map };
+        for (int slot = 0; slot < SLOT_COUNT; slot++)
+        {
+            int image = SlotImage(doc, material, slot);
+            if (image < 0)
+            {
+                continue;
+            }
+            auto texture = model->textures_by_path.find(TextureKey(doc, image, SLOT_USE[slot]));
+            if (texture != model->textures_by_path.end())
+            {
+                *maps[slot] = texture->second;
+                mesh.texture_paths.push_back(texture->first);
+            }
+        }
+        meshes.push_back(std::move(mesh));
+    }
+    return true;
+}
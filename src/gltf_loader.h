@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <vector>
+
+class Model;
+struct ImportedMesh;
+
+/*****************************************************
+* Native glTF 2.0 import, .gltf with its .bin and
+* image files or a single .glb. The JSON is parsed
+* here and accessors are read in place from memory
+* mapped buffers (the GLB's BIN chunk or the external
+* .bin files), straight into the import Vertex, so no
+* Assimp scene sits in between.
+*
+* Every triangle primitive of every mesh a node of the
+* scene references becomes one ImportedMesh, with the
+* node's world transform baked in (Assimp's import of
+* other formats leaves node transforms out). Missing
+* normals and tangents are generated like Assimp's
+* GenSmoothNormals and CalcTangentSpace would.
+*
+* Metallic-roughness materials fill the mesh's
+* PbrMaterialInfo: base color, normal and occlusion
+* maps as they are, the metallic (blue) and roughness
+* (green) channels of the packed texture split into
+* the single channel maps CTPBRMaterial samples.
+* Primitives and images are imported on the JobPool,
+* textures uploaded on the calling thread.
+*****************************************************/
+class GltfLoader
+{
+public:
+    static bool IsGltf(const std::string& path);
+    // false when the file can't be read at all, a bad primitive is only skipped
+    static bool Load(const std::string& path, Model* model, std::vector<ImportedMesh>& meshes);
+};
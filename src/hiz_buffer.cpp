@@ -0,0 +1,263 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cfloat>
+
+#include "hiz_buffer.h"
+#include "shader.h"
+#include "file_system.h"
+#include "gl_state.h"
+#include "renderer_console.h"
+
+HiZBuffer::HiZBuffer()
+{
+    reduce_shader = new Shader( FileSystem::GetContentPath() / "Shader/hiz_reduce.vs",
+                                FileSystem::GetContentPath() / "Shader/hiz_reduce.fs",
+                                true);
+    reduce_shader->LoadShader();
+    glGenVertexArrays(1, &empty_vao);
+    for (Readback& readback : readbacks)
+    {
+        glGenBuffers(1, &readback.pbo);
+    }
+}
+
+HiZBuffer::~HiZBuffer()
+{
+    Invalidate();
+    DeleteTargets();
+    for (Readback& readback : readbacks)
+    {
+        glDeleteBuffers(1, &readback.pbo);
+    }
+    glDeleteVertexArrays(1, &empty_vao);
+    delete reduce_shader;
+}
+
+void HiZBuffer::CreateTargets(int width, int height)
+{
+    DeleteTargets();
+    source_width = width;
+    source_height = height;
+    base_width = std::min(BASE_WIDTH, width);
+    base_height = std::max(1, height * base_width / width);
+
+    // same format as the color targets' depth, glBlitFramebuffer needs it to match
+    glGenTextures(1, &depth_copy);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_2D, depth_copy);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glGenFramebuffers(1, &depth_framebuffer);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, depth_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth_copy, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    glGenTextures(1, &base_texture);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_2D, base_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, base_width, base_height, 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_2D, 0);
+    glGenFramebuffers(1, &base_framebuffer);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, base_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, base_texture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        RendererConsole::GetInstance()->AddError("[error] FRAMEBUFFER: Hi-Z framebuffer is not complete!");
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    for (Readback& readback : readbacks)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)base_width * base_height * sizeof(float), NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    RendererConsole::GetInstance()->AddLog("Create Hi-Z Buffer: %dx%d", base_width, base_height);
+}
+
+void HiZBuffer::DeleteTargets()
+{
+    if (depth_framebuffer == 0)
+    {
+        return;
+    }
+    GLState::GetInstance()->DeleteFramebuffer(depth_framebuffer);
+    GLState::GetInstance()->DeleteFramebuffer(base_framebuffer);
+    GLState::GetInstance()->DeleteTexture(depth_copy);
+    GLState::GetInstance()->DeleteTexture(base_texture);
+    depth_framebuffer = base_framebuffer = depth_copy = base_texture = 0;
+}
+
+void HiZBuffer::Build(int width, int height, const glm::mat4& _view_projection)
+{
+    if (width != source_width || height != source_height)
+    {
+        Invalidate();
+        CreateTargets(width, height);
+    }
+    Readback& readback = readbacks[next_readback];
+    if (readback.fence != 0)
+    {
+        // both readbacks still in flight, skip a frame rather than wait
+        return;
+    }
+
+    // the reduction has to sample the depth, the color targets keep it in a renderbuffer
+    GLState::GetInstance()->BindFramebuffer(GL_DRAW_FRAMEBUFFER, depth_framebuffer);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, base_framebuffer);
+    GLState::GetInstance()->Viewport(0, 0, base_width, base_height);
+    GLState::GetInstance()->Disable(GL_DEPTH_TEST);
+    reduce_shader->use();
+    reduce_shader->setInt("depthMap", 0);
+    reduce_shader->setVec2("targetSize", glm::vec2(base_width, base_height));
+    GLState::GetInstance()->BindTexture(0, GL_TEXTURE_2D, depth_copy);
+    GLState::GetInstance()->BindVertexArray(empty_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    GLState::GetInstance()->Enable(GL_DEPTH_TEST);
+
+    // into the PBO, glReadPixels returns at once and the copy runs after the reduction
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    glReadPixels(0, 0, base_width, base_height, GL_RED, GL_FLOAT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.width = base_width;
+    readback.height = base_height;
+    readback.view_projection = _view_projection;
+    next_readback = (next_readback + 1) % 2;
+}
+
+void HiZBuffer::Update()
+{
+    // oldest first, so the newest finished one is adopted last
+    for (int i = 0; i < 2; i++)
+    {
+        Readback& readback = readbacks[(next_readback + i) % 2];
+        if (readback.fence == 0 || glClientWaitSync(readback.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            continue;
+        }
+        glDeleteSync(readback.fence);
+        readback.fence = 0;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+        const float* base = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (size_t)readback.width * readback.height * sizeof(float), GL_MAP_READ_BIT);
+        if (base != nullptr)
+        {
+            BuildLevels(base, readback.width, readback.height);
+            view_projection = readback.view_projection;
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
+
+void HiZBuffer::Invalidate()
+{
+    for (Readback& readback : readbacks)
+    {
+        if (readback.fence != 0)
+        {
+            glDeleteSync(readback.fence);
+            readback.fence = 0;
+        }
+    }
+    levels.clear();
+    level_width.clear();
+    level_height.clear();
+}
+
+/*****************************************************
+* Level n + 1 texel (x, y) is the max of level n texels
+* 2x..2x+1, 2y..2y+1, clamped at odd edges, so texel
+* (x, y) of level n covers level 0 texels
+* [x << n, (x + 1) << n) and lookups can shift.
+*****************************************************/
+void HiZBuffer::BuildLevels(const float* base, int width, int height)
+{
+    levels.clear();
+    level_width.clear();
+    level_height.clear();
+    levels.emplace_back(base, base + width * height);
+    level_width.push_back(width);
+    level_height.push_back(height);
+
+    while (width > 1 || height > 1)
+    {
+        const std::vector<float>& src = levels.back();
+        int w = (width + 1) / 2;
+        int h = (height + 1) / 2;
+        std::vector<float> dst(w * h);
+        for (int y = 0; y < h; y++)
+        {
+            int y0 = y * 2, y1 = std::min(y * 2 + 1, height - 1);
+            for (int x = 0; x < w; x++)
+            {
+                int x0 = x * 2, x1 = std::min(x * 2 + 1, width - 1);
+                dst[y * w + x] = std::max(std::max(src[y0 * width + x0], src[y0 * width + x1]),
+                                          std::max(src[y1 * width + x0], src[y1 * width + x1]));
+            }
+        }
+        levels.push_back(std::move(dst));
+        level_width.push_back(w);
+        level_height.push_back(h);
+        width = w;
+        height = h;
+    }
+}
+
+bool HiZBuffer::IsOccluded(const AABB& bounds) const
+{
+    if (!IsReady() || !bounds.IsValid())
+    {
+        return false;
+    }
+
+    // screen rectangle and nearest depth of the box in the pyramid's view
+    glm::vec3 ndc_min(FLT_MAX), ndc_max(-FLT_MAX);
+    for (int c = 0; c < 8; c++)
+    {
+        glm::vec3 corner((c & 1) ? bounds.max.x : bounds.min.x, (c & 2) ? bounds.max.y : bounds.min.y, (c & 4) ? bounds.max.z : bounds.min.z);
+        glm::vec4 clip = view_projection * glm::vec4(corner, 1.0f);
+        if (clip.w <= 0.0f)
+        {
+            // crosses the near plane, nothing can be in front of it
+            return false;
+        }
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndc_min = glm::min(ndc_min, ndc);
+        ndc_max = glm::max(ndc_max, ndc);
+    }
+    if (ndc_min.x < -1.0f || ndc_max.x > 1.0f || ndc_min.y < -1.0f || ndc_max.y > 1.0f)
+    {
+        // even partly outside the view the pyramid saw, it knows nothing about that part
+        return false;
+    }
+    float nearest = ndc_min.z * 0.5f + 0.5f;
+
+    int width = level_width[0], height = level_height[0];
+    int x0 = glm::clamp((int)((ndc_min.x * 0.5f + 0.5f) * width), 0, width - 1);
+    int x1 = glm::clamp((int)((ndc_max.x * 0.5f + 0.5f) * width), 0, width - 1);
+    int y0 = glm::clamp((int)((ndc_min.y * 0.5f + 0.5f) * height), 0, height - 1);
+    int y1 = glm::clamp((int)((ndc_max.y * 0.5f + 0.5f) * height), 0, height - 1);
+
+    // coarsest level where the rectangle still spans at most 2x2 texels
+    int level = 0;
+    while (level + 1 < (int)levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+    {
+        level++;
+    }
+
+    const std::vector<float>& depth = levels[level];
+    int w = level_width[level];
+    float farthest = 0.0f;
+    for (int y = y0 >> level; y <= (y1 >> level); y++)
+    {
+        for (int x = x0 >> level; x <= (x1 >> level); x++)
+        {
+            farthest = std::max(farthest, depth[y * w + x]);
+        }
+    }
+    return nearest > farthest;
+}
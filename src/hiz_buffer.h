@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "bounds.h"
+
+class Shader;
+
+/*****************************************************
+* Hierarchical-Z occlusion culling. Once the opaque
+* geometry is drawn, the depth of the color target is
+* max-reduced on the GPU into a small float grid and
+* read back through a PBO, guarded by a fence so the
+* CPU never waits on it. The CPU then builds the rest
+* of the max pyramid and tests bounds against it.
+*
+* A box is occluded when its nearest depth is behind
+* the farthest depth under its screen rectangle. Tests
+* use the newest pyramid that finished reading back,
+* projected with the view-projection it was rendered
+* with, so the result lags a frame or two behind.
+*****************************************************/
+class HiZBuffer
+{
+public:
+    static const int BASE_WIDTH = 256;  // width of level 0, its height follows the aspect ratio
+
+    HiZBuffer();
+    ~HiZBuffer();
+
+    // reduce the depth of the bound read framebuffer (width x height) and start reading it back
+    void Build(int width, int height, const glm::mat4& view_projection);
+    // adopt the newest readback that has finished, never stalls
+    void Update();
+    // drop every pyramid, e.g. when the depth no longer matches the scene
+    void Invalidate();
+    bool IsReady() const { return !levels.empty(); }
+    bool IsOccluded(const AABB& bounds) const;
+
+    // for the stats panel
+    int Width() const { return level_width.empty() ? 0 : level_width[0]; }
+    int Height() const { return level_height.empty() ? 0 : level_height[0]; }
+    int LevelCount() const { return levels.size(); }
+
+private:
+    struct Readback
+    {
+        unsigned int    pbo = 0;
+        GLsync          fence = 0;
+        int             width = 0;
+        int             height = 0;
+        glm::mat4       view_projection;
+    } readbacks[2];
+    int next_readback = 0;
+
+    // GPU side: a copy of the scene depth, and the reduced level 0
+    int source_width = 0, source_height = 0;
+    unsigned int depth_copy = 0, depth_framebuffer = 0;
+    int base_width = 0, base_height = 0;
+    unsigned int base_texture = 0, base_framebuffer = 0;
+    unsigned int empty_vao = 0;
+    Shader* reduce_shader;
+
+    // CPU side: max pyramid of the adopted readback, level 0 first
+    std::vector<std::vector<float>> levels;
+    std::vector<int> level_width;
+    std::vector<int> level_height;
+    glm::mat4 view_projection;
+
+    void CreateTargets(int width, int height);
+    void DeleteTargets();
+    void BuildLevels(const float* base, int width, int height);
+};
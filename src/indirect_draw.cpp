@@ -0,0 +1,51 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+
+#include "indirect_draw.h"
+#include "renderer_console.h"
+
+void IndirectDraw::Init()
+{
+    bool core = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 3);
+    bool extension = glfwExtensionSupported("GL_ARB_multi_draw_indirect") && glfwExtensionSupported("GL_ARB_base_instance");
+    if (core || extension)
+    {
+        multi_draw_elements_indirect = (PFNMULTIDRAWELEMENTSINDIRECTPROC)glfwGetProcAddress("glMultiDrawElementsIndirect");
+    }
+    if (IsSupported())
+    {
+        RendererConsole::GetInstance()->AddNote("Multi-draw indirect supported (GL %d.%d)", GLVersion.major, GLVersion.minor);
+    }
+    else
+    {
+        RendererConsole::GetInstance()->AddNote("Multi-draw indirect unsupported (GL %d.%d), drawing batch by batch", GLVersion.major, GLVersion.minor);
+    }
+}
+
+void IndirectDraw::Upload(const std::vector<DrawElementsIndirectCommand>& commands)
+{
+    if (id == 0)
+    {
+        glGenBuffers(1, &id);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, id);
+    size_t size = commands.size() * sizeof(DrawElementsIndirectCommand);
+    if (size > capacity)
+    {
+        capacity = std::max(size, capacity * 2);
+    }
+    // orphan like the InstanceBuffer, the previous pass may still be reading it
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+    if (size > 0)
+    {
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, size, commands.data());
+    }
+}
+
+void IndirectDraw::MultiDraw(unsigned int first, unsigned int count, GLenum index_type)
+{
+    // the indirect buffer binding is global state, it stays bound since Upload
+    multi_draw_elements_indirect(GL_TRIANGLES, index_type,
+        (void*)((size_t)first * sizeof(DrawElementsIndirectCommand)), count, sizeof(DrawElementsIndirectCommand));
+}
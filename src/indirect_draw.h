@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include <glad/glad.h>
+#include "singleton_util.h"
+
+// the glad loader only covers GL 3.3, the indirect entry points are fetched by hand
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+typedef void (APIENTRYP PFNMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+
+// layout fixed by GL, see glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    unsigned int    count;
+    unsigned int    instance_count;
+    unsigned int    first_index;
+    int             base_vertex;
+    unsigned int    base_instance;
+};
+
+/*****************************************************
+* glMultiDrawElementsIndirect when the context has it
+* (GL 4.3, or ARB_multi_draw_indirect with
+* ARB_base_instance). The per-draw model matrix still
+* comes from the InstanceBuffer: base_instance offsets
+* the instanced attributes, so the shaders need
+* neither gl_DrawID nor a storage buffer. Without
+* support the passes keep drawing batch by batch.
+*****************************************************/
+class IndirectDraw : public Singleton<IndirectDraw>
+{
+public:
+    // query support and load the entry point, needs a current context
+    void Init();
+    bool IsSupported() const { return multi_draw_elements_indirect != nullptr; }
+
+    // one command per draw batch of the pass, in batch order
+    void Upload(const std::vector<DrawElementsIndirectCommand>& commands);
+    // submit commands [first, first + count) on the bound VAO, index_type of its element buffer
+    void MultiDraw(unsigned int first, unsigned int count, GLenum index_type);
+
+private:
+    PFNMULTIDRAWELEMENTSINDIRECTPROC multi_draw_elements_indirect = nullptr;
+    unsigned int id = 0;
+    size_t capacity = 0;
+};
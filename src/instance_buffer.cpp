@@ -0,0 +1,43 @@
+#include <glad/glad.h>
+#include <algorithm>
+
+#include "instance_buffer.h"
+
+void InstanceBuffer::Upload(const std::vector<glm::mat4>& matrices)
+{
+    if (id == 0)
+    {
+        glGenBuffers(1, &id);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, id);
+    size_t size = matrices.size() * sizeof(glm::mat4);
+    if (size > capacity)
+    {
+        capacity = std::max(size, capacity * 2);
+    }
+    // orphan the old storage so draws still reading it don't stall the upload
+    glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+    if (size > 0)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, matrices.data());
+    }
+}
+
+void InstanceBuffer::BindRange(unsigned int first)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, id);
+    size_t offset = first * sizeof(glm::mat4);
+    for (int i = 0; i < 4; i++)
+    {
+        glVertexAttribPointer(INSTANCE_MATRIX_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + i * sizeof(glm::vec4)));
+    }
+}
+
+void InstanceBuffer::SetupVertexArray()
+{
+    for (int i = 0; i < 4; i++)
+    {
+        glEnableVertexAttribArray(INSTANCE_MATRIX_LOCATION + i);
+        glVertexAttribDivisor(INSTANCE_MATRIX_LOCATION + i, 1);
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "singleton_util.h"
+
+// Vertex attribute locations 7..10 hold the per-instance model matrix, one column each
+#define INSTANCE_MATRIX_LOCATION 7
+
+/*****************************************************
+* Per-instance model matrices of one pass. The pass
+* uploads every matrix of its sorted draw list at once,
+* each instanced draw then points the instance
+* attributes at its own range of the buffer.
+*****************************************************/
+class InstanceBuffer : public Singleton<InstanceBuffer>
+{
+public:
+    void Upload(const std::vector<glm::mat4>& matrices);
+    // set the instance attribute pointers of the bound VAO to start at instance `first`
+    void BindRange(unsigned int first);
+    // enable the instance attributes on the bound VAO, done once when a mesh is created
+    static void SetupVertexArray();
+
+private:
+    unsigned int id = 0;
+    size_t capacity = 0;
+};
@@ -0,0 +1,93 @@
+#include "job_pool.h"
+
+namespace
+{
+    thread_local bool in_job = false;
+}
+
+JobPool::JobPool()
+{
+    unsigned int hardware_threads = std::thread::hardware_concurrency();
+    for (unsigned int i = 1; i < hardware_threads; i++)
+    {
+        workers.emplace_back(&JobPool::WorkerLoop, this);
+    }
+}
+
+void JobPool::ParallelFor(unsigned int count, const std::function<void(unsigned int)>& _job)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (workers.empty() || count == 1 || in_job)
+    {
+        for (unsigned int i = 0; i < count; i++)
+        {
+            _job(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit_lock(submit);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &_job;
+        job_count = count;
+        finished = 0;
+        next = 0;
+        generation++;
+    }
+    wake.notify_all();
+    RunJobs();
+
+    // a worker still inside RunJobs holds `job`, it must leave before the batch ends
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return finished == job_count && active == 0; });
+    job = nullptr;
+}
+
+void JobPool::RunJobs()
+{
+    in_job = true;
+    unsigned int completed = 0;
+    for (unsigned int i = next++; i < job_count; i = next++)
+    {
+        (*job)(i);
+        completed++;
+    }
+    in_job = false;
+    if (completed > 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished += completed;
+        if (finished == job_count)
+        {
+            done.notify_all();
+        }
+    }
+}
+
+void JobPool::WorkerLoop()
+{
+    unsigned int seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [&] { return generation != seen; });
+        seen = generation;
+        // the batch may have ended before this worker woke up
+        if (job == nullptr)
+        {
+            continue;
+        }
+        active++;
+        lock.unlock();
+        RunJobs();
+        lock.lock();
+        if (--active == 0)
+        {
+            done.notify_all();
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "singleton_util.h"
+
+/*****************************************************
+* Worker threads for CPU work that splits into
+* independent jobs (mesh import, texture decode). One
+* worker per hardware thread but the caller's, which
+* works through the jobs too, so ParallelFor never
+* leaves a core idle waiting. Jobs must not touch GL
+* or the RendererConsole. A ParallelFor from inside a
+* job runs serially on that thread.
+*****************************************************/
+class JobPool : public Singleton<JobPool>
+{
+public:
+    JobPool();
+
+    // run job(i) for every i in [0, count), returns once all of them are done
+    void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& job);
+    // threads ParallelFor spreads over, the caller included
+    unsigned int ThreadCount() const { return workers.size() + 1; }
+
+private:
+    void WorkerLoop();
+    // claim and run jobs of the current batch until none is left
+    void RunJobs();
+
+    std::vector<std::thread> workers;
+    std::mutex submit;                  // one batch at a time
+    std::mutex mutex;                   // guards everything below but `next`
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(unsigned int)>* job = nullptr;
+    unsigned int job_count = 0;
+    unsigned int finished = 0;
+    unsigned int active = 0;            // workers inside RunJobs
+    unsigned int generation = 0;        // bumped by every batch
+    std::atomic<unsigned int> next { 0 };
+};
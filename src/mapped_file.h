@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+
+/*****************************************************
+* A whole file mapped read-only, for the MeshCache and
+* the glTF buffers, so their bytes are read in place
+* and paged in by the OS as they are touched.
+*****************************************************/
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { Close(); }
+
+    // false for a missing or empty file
+    bool Open(const std::filesystem::path& path);
+    void Close();
+
+    const unsigned char* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file = (void*)-1;     // INVALID_HANDLE_VALUE, windows.h stays out of the header
+    void* mapping = nullptr;
+#endif
+};
@@ -1,4 +1,5 @@
 #include <string>
+#include <cstring>
 
 #include "renderer_console.h"
 #include "material.h"
@@ -6,14 +7,30 @@
 #include "shader.h"
 #include "file_system.h"
 
-unsigned int Material::cur_id = 0;
+SlotMap<Material*> Material::Registry;
 
-Material::Material() { id = cur_id++; }
-Material::~Material() { RendererConsole::GetInstance()->AddLog("delete Material"); }
-PhongMaterial::~PhongMaterial() { RendererConsole::GetInstance()->AddLog("delete Phong Material"); }
-BlinnPhongMaterial::~BlinnPhongMaterial() { RendererConsole::GetInstance()->AddLog("delete Blinn-Phong Material"); }
-CTPBRMaterial::~CTPBRMaterial() { RendererConsole::GetInstance()->AddLog("delete Cook-Torrance Material"); }
-bool Material::IsValid() { return shader != nullptr; }
+Material::Material() { id = Registry.Insert(this); }
+Material::~Material() { Registry.Remove(id); RendererConsole::GetInstance()->AddLog("delete Material"); }
+PhongMaterial::~PhongMaterial() { ReleaseTextures(); RendererConsole::GetInstance()->AddLog("delete Phong Material"); }
+BlinnPhongMaterial::~BlinnPhongMaterial() { ReleaseTextures(); RendererConsole::GetInstance()->AddLog("delete Blinn-Phong Material"); }
+CTPBRMaterial::~CTPBRMaterial() { ReleaseTextures(); RendererConsole::GetInstance()->AddLog("delete Cook-Torrance Material"); }
+Shader* Material::GetShader() const { return Shader::Get(shader_handle); }
+bool Material::IsValid() { return GetShader() != nullptr; }
+
+Material* Material::Get(Handle handle)
+{
+    Material** material = Registry.Get(handle);
+    return material != nullptr ? *material : nullptr;
+}
+
+// from the derived destructors, while the texture members are still there
+void Material::ReleaseTextures()
+{
+    for (auto tex : material_variables.allTextures)
+    {
+        (*tex->variable.texture)->textureRefs.RemoveRef(this);
+    }
+}
 
 void Material::SetTexture(Texture2D **slot, Texture2D *new_tex)
 {
@@ -22,35 +39,132 @@ void Material::SetTexture(Texture2D **slot, Texture2D *new_tex)
     (*slot)->textureRefs.AddRef(this);
 }
 
+// Resolve the uniform handle of a value slot once per link of the shader
+template <class T>
+static UniformHandle SlotHandle(Shader* shader, MaterialSlot<T>* slot)
+{
+    if (slot->uniform_version != shader->uniform_version)
+    {
+        slot->uniform_version = shader->uniform_version;
+        slot->handles[0] = shader->GetUniformHandle(slot->slot_name);
+    }
+    return slot->handles[0];
+}
+
 void Material::DefaultSetup()
 {
+    Shader* shader = GetShader();
+    shader->use();
     unsigned int gl_tex_id = 0;
     for (auto tex : material_variables.allTextures)
     {
-        glActiveTexture(GL_TEXTURE1 + gl_tex_id);
-        glUniform1i(glGetUniformLocation(shader->ID, (tex->slot_name + ".texture").c_str()), 1 + gl_tex_id);
-        shader->setVec2((tex->slot_name + ".tilling").c_str(), tex->variable.tilling );
-        shader->setVec2((tex->slot_name + ".offset").c_str(), tex->variable.offset );
-        glBindTexture(GL_TEXTURE_2D, (*tex->variable.texture)->id);
+        if (tex->uniform_version != shader->uniform_version)
+        {
+            tex->uniform_version = shader->uniform_version;
+            tex->handles[0] = shader->GetUniformHandle(tex->slot_name + ".texture");
+            tex->handles[1] = shader->GetUniformHandle(tex->slot_name + ".tilling");
+            tex->handles[2] = shader->GetUniformHandle(tex->slot_name + ".offset");
+        }
+        shader->setInt(tex->handles[0], 1 + gl_tex_id);
+        shader->setVec2(tex->handles[1], tex->variable.tilling);
+        shader->setVec2(tex->handles[2], tex->variable.offset);
+        GLState::GetInstance()->BindTexture(1 + gl_tex_id, GL_TEXTURE_2D, (*tex->variable.texture)->id);
         gl_tex_id++;
     }
-    shader->use();
     for (auto value : material_variables.allColor)
     {
-        shader->setVec3(value->slot_name.c_str(), glm::vec3(value->variable[0], value->variable[1], value->variable[2]));
+        shader->setVec3(SlotHandle(shader, value), glm::vec3(value->variable[0], value->variable[1], value->variable[2]));
     }
     for (auto value : material_variables.allFloat)
     {
-        shader->setFloat(value->slot_name.c_str(), *value->variable);
+        shader->setFloat(SlotHandle(shader, value), *value->variable);
     }
     for (auto value : material_variables.allInt)
     {
-        shader->setInt(value->slot_name.c_str(), *value->variable);
+        shader->setInt(SlotHandle(shader, value), *value->variable);
     }
     for (auto value : material_variables.allVec3)
     {
-        shader->setVec3(value->slot_name.c_str(), glm::vec3(value->variable[0], value->variable[1], value->variable[2]));
+        shader->setVec3(SlotHandle(shader, value), glm::vec3(value->variable[0], value->variable[1], value->variable[2]));
+    }
+}
+
+/*****************************************************
+* Materials can share one instanced draw when every
+* uniform and texture they would set is identical.
+* BatchKey hashes the same state, so compatible
+* materials always get the same key.
+*****************************************************/
+bool Material::IsBatchCompatible(const Material* other) const
+{
+    if (other == this)
+    {
+        return true;
+    }
+    const MaterialVariables& a = material_variables;
+    const MaterialVariables& b = other->material_variables;
+    if (shader_handle != other->shader_handle || cullface != other->cullface ||
+        a.allTextures.size() != b.allTextures.size() || a.allInt.size() != b.allInt.size() ||
+        a.allFloat.size() != b.allFloat.size() || a.allVec3.size() != b.allVec3.size() ||
+        a.allColor.size() != b.allColor.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < a.allTextures.size(); i++)
+    {
+        const MaterialTexture2D& ta = a.allTextures[i]->variable;
+        const MaterialTexture2D& tb = b.allTextures[i]->variable;
+        if (*ta.texture != *tb.texture || ta.tilling != tb.tilling || ta.offset != tb.offset)
+        {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.allInt.size(); i++)
+    {
+        if (*a.allInt[i]->variable != *b.allInt[i]->variable) return false;
+    }
+    for (size_t i = 0; i < a.allFloat.size(); i++)
+    {
+        if (*a.allFloat[i]->variable != *b.allFloat[i]->variable) return false;
+    }
+    for (size_t i = 0; i < a.allVec3.size(); i++)
+    {
+        if (memcmp(a.allVec3[i]->variable, b.allVec3[i]->variable, sizeof(float) * 3) != 0) return false;
+    }
+    for (size_t i = 0; i < a.allColor.size(); i++)
+    {
+        if (memcmp(a.allColor[i]->variable, b.allColor[i]->variable, sizeof(float) * 3) != 0) return false;
+    }
+    return true;
+}
+
+// FNV-1a
+static void HashBytes(unsigned int& hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+}
+
+unsigned int Material::BatchKey() const
+{
+    unsigned int hash = 2166136261u;
+    HashBytes(hash, &shader_handle, sizeof(shader_handle));
+    HashBytes(hash, &cullface, sizeof(cullface));
+    for (auto tex : material_variables.allTextures)
+    {
+        unsigned int tex_id = (*tex->variable.texture)->id;
+        HashBytes(hash, &tex_id, sizeof(tex_id));
+        HashBytes(hash, &tex->variable.tilling, sizeof(glm::vec2));
+        HashBytes(hash, &tex->variable.offset, sizeof(glm::vec2));
     }
+    for (auto value : material_variables.allInt)   HashBytes(hash, value->variable, sizeof(int));
+    for (auto value : material_variables.allFloat) HashBytes(hash, value->variable, sizeof(float));
+    for (auto value : material_variables.allVec3)  HashBytes(hash, value->variable, sizeof(float) * 3);
+    for (auto value : material_variables.allColor) HashBytes(hash, value->variable, sizeof(float) * 3);
+    return hash;
 }
 
 void Material::OnTextureRemoved(Texture2D *removed_texture)
@@ -85,7 +199,7 @@ Material* MaterialManager::CreateMaterialByType(EMaterialType type)
 
 PhongMaterial::PhongMaterial() : Material::Material()
 {
-    shader = Shader::LoadedShaders["phong.fs"];
+    shader_handle = Shader::LoadedShaders["phong.fs"]->handle;
 
     // Init all material variables
     albedo_map->textureRefs.AddRef(this);
@@ -108,7 +222,7 @@ void PhongMaterial::Setup(std::vector<Texture2D*> default_textures)
 
 BlinnPhongMaterial::BlinnPhongMaterial() : Material::Material()
 {
-    shader = Shader::LoadedShaders["blinn_phong.fs"];
+    shader_handle = Shader::LoadedShaders["blinn_phong.fs"]->handle;
 
     // Init all material variables
     albedo_map->textureRefs.AddRef(this);
@@ -131,7 +245,7 @@ void BlinnPhongMaterial::Setup(std::vector<Texture2D*> default_textures)
 
 CTPBRMaterial::CTPBRMaterial()
 {
-    shader = Shader::LoadedShaders["cook_torrance.fs"];
+    shader_handle = Shader::LoadedShaders["cook_torrance.fs"]->handle;
 
     // Init all material variables
     albedo_map->textureRefs.AddRef(this);
@@ -5,6 +5,7 @@
 #include "texture.h"
 #include "editor_content.h"
 #include "singleton_util.h"
+#include "slot_map.h"
 
 class Shader;
 
@@ -23,6 +24,12 @@ public:
 	
 	std::string slot_name;
 	T variable;
+
+	// UniformHandle of the slot (textures use .texture/.tilling/.offset),
+	// resolved against Shader::uniform_version and re-resolved after any link,
+	// so a reload or another shader reusing the GL program id can't match
+	unsigned int uniform_version = 0;
+	int handles[3] = { -1, -1, -1 };
 };
 
 struct MaterialTexture2D
@@ -63,24 +70,30 @@ class Material
 {
 public:
 	const std::string name = "Material Base";
-	unsigned int id;
-	Shader* shader;
+	Handle id;
+	// a handle, so removing the shader leaves the material invalid instead of dangling
+	Handle shader_handle = HandleTable::NONE;
 	E_CULL_FACE cullface = E_CULL_FACE::culloff;
 	void SetTexture(Texture2D** slot, Texture2D* new_tex);
 	MaterialVariables material_variables;
-
-private:
-	static unsigned int cur_id;
+	static SlotMap<Material*> Registry;
 
 public:
 	Material();
     virtual ~Material();
+	// nullptr once the shader is gone
+	Shader* GetShader() const;
 	bool IsValid();
+	// nullptr for a stale handle
+	static Material* Get(Handle handle);
+	bool IsBatchCompatible(const Material* other) const;
+	unsigned int BatchKey() const;
 	virtual void Setup(std::vector<Texture2D*> default_textures) = 0;
 	void OnTextureRemoved(Texture2D* removed_texture);
 
 protected:
 	void DefaultSetup();
+	void ReleaseTextures();
 };
 
 class PhongMaterial : public Material
@@ -6,15 +6,30 @@
 
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <utility>
 #include <iostream>
 
 #include "editor_settings.h"
 #include "texture.h"
 #include "material.h"
 #include "shader.h"
+#include "bounds.h"
+#include "bvh.h"
+#include "gl_state.h"
+#include "instance_buffer.h"
+#include "mesh_arena.h"
+#include "indirect_draw.h"
+#include "mesh_simplifier.h"
+#include "mesh_optimizer.h"
+#include "vertex_format.h"
 using namespace std;
 
 #define MAX_BONE_INFLUENCE 4
+#define MAX_MESH_LODS 5             // full mesh included
+#define LOD_MIN_TRIANGLES 256       // smaller meshes keep a single level
+#define LOD_MAX_ERROR 0.25f         // of the bounding sphere radius, for the coarsest level
+#define LOD_HYSTERESIS 0.75f        // a coarser level must fit this fraction of the error budget
 
 struct Vertex
 {
@@ -34,6 +49,36 @@ struct Vertex
     float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// one level of detail: a range of indices over the mesh's shared vertices
+struct MeshLod
+{
+    unsigned int    first_index;
+    unsigned int    index_count;
+    float           error;          // object space deviation from the full mesh
+};
+
+// metallic-roughness material a model file asks for, SceneModel makes a CTPBRMaterial of it
+struct PbrMaterialInfo
+{
+    bool        valid = false;
+    Texture2D*  albedo_map = nullptr;       // nullptr keeps the material's default texture
+    Texture2D*  normal_map = nullptr;
+    Texture2D*  metallic_map = nullptr;
+    Texture2D*  roughness_map = nullptr;
+    Texture2D*  ao_map = nullptr;
+    glm::vec3   color = glm::vec3(1.0f);
+    float       metallic = 1.0f;
+    float       roughness = 1.0f;
+    float       ao = 1.0f;
+};
+
+// a level built on the CPU, before it has a place in the arena
+struct MeshLodIndices
+{
+    vector<unsigned int>    indices;
+    float                   error;
+};
+
 class Mesh
 {
 public:
@@ -41,8 +86,19 @@ public:
     vector<Vertex> vertices;
     vector<unsigned int> indices;
     vector<Texture2D*> textures;
-    unsigned int VAO;
+    unsigned int id;
+    MeshAllocation allocation;  // vertex/index range in the MeshArena
+    VertexLayout layout;        // how the arena stores the vertices, see VertexFormat
+    glm::mat4 vertex_transform = glm::mat4(1.0f);   // arena positions to object space, identity unless layout.position16
+    vector<MeshLod> lods;       // lods[0] is the full mesh, each next one coarser
+    vector<vector<unsigned int>> lod_indices;   // CPU copy of lods[1..], for the MeshCache
     string name = "mesh";
+    PbrMaterialInfo pbr;        // only glTF models fill it
+    // object space bounds, filled by Model::prepareMesh
+    AABB bounds;
+    BoundingSphere bounding_sphere;
+    // triangles in object space for ray casts, over vertices and indices
+    MeshBvh bvh;
 
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture2D*> textures)
@@ -50,96 +106,176 @@ public:
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        if (!this->vertices.empty())
+        {
+            bvh.Build(&this->vertices[0].Position, sizeof(Vertex), this->indices.data(), this->indices.size());
+        }
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
     }
+    // from the import jobs or the MeshCache, the vertices come packed already
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture2D*> textures, const PackedVertexView& packed, const glm::mat4& vertex_transform)
+    {
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = textures;
+        this->vertex_transform = vertex_transform;
+        id = cur_id++;
+        layout = packed.layout;
+        allocation = MeshArena::GetInstance()->Allocate(packed, this->indices);
+        lods.push_back({ allocation.first_index, allocation.index_count, 0.0f });
+    }
+    ~Mesh()
+    {
+        for (size_t i = 1; i < lods.size(); i++)
+        {
+            MeshArena::GetInstance()->FreeIndices(allocation.page, lods[i].first_index, lods[i].index_count);
+        }
+        MeshArena::GetInstance()->Free(allocation);
+    }
 
-    // Render the mesh
-    void Draw(Material* material)
+    /*****************************************************
+    * Simplified index buffers over the same vertices,
+    * each aiming at half the triangles of the previous
+    * one, for the mesh's arena page. Every level is
+    * simplified from the full mesh so its error is
+    * measured against the original. Stops early when the
+    * simplifier can't make real progress within
+    * LOD_MAX_ERROR. Touches no GL, so it runs in the
+    * import jobs, AddLod then stores the levels in order.
+    *****************************************************/
+    static vector<MeshLodIndices> BuildLods(const vector<Vertex>& vertices, const vector<unsigned int>& indices, float radius)
     {
-        // Use material shader
-        material->Setup(textures);
+        vector<MeshLodIndices> levels;
+        if (indices.size() / 3 < LOD_MIN_TRIANGLES)
+        {
+            return levels;
+        }
+        float max_error = radius * LOD_MAX_ERROR;
+        size_t target = indices.size();
+        size_t previous = indices.size();
+        while (levels.size() + 1 < MAX_MESH_LODS)
+        {
+            target /= 2;
+            float error = 0;
+            vector<unsigned int> level_indices = MeshSimplifier::Simplify(vertices, indices, target / 3 * 3, max_error, error);
+            // less than a fifth saved over the previous level is not worth a switch
+            if (level_indices.empty() || level_indices.size() * 5 > previous * 4)
+            {
+                break;
+            }
+            // collapses scatter the cache order of the full mesh, the vertex order stays shared
+            MeshOptimizer::OptimizeVertexCache(level_indices, vertices.size());
+            previous = level_indices.size();
+            levels.push_back({ std::move(level_indices), error });
+        }
+        return levels;
+    }
 
-        // Draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // append a coarser level over the mesh's vertices, false when the arena page is full
+    bool AddLod(const vector<unsigned int>& level_indices, float error)
+    {
+        MeshLod lod = { 0, (unsigned int)level_indices.size(), error };
+        if (allocation.page < 0 || !MeshArena::GetInstance()->AllocateIndices(allocation.page, level_indices, lod.first_index))
+        {
+            return false;
+        }
+        lods.push_back(lod);
+        lod_indices.push_back(level_indices);
+        return true;
+    }
 
-        // Always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    /*****************************************************
+    * 12 bits for the render queue key: arena page first,
+    * so the VAO only changes with the page, then the low
+    * bits of the id to keep copies of a mesh adjacent.
+    *****************************************************/
+    unsigned int SortKey() const
+    {
+        return ((allocation.page & 0xF) << 8) | (id & 0xFF);
     }
 
-    // Draw without material setting (use shader.use() to set render method)
-    void Draw()
+    // the same draw as Draw(first_instance, instance_count, lod, ...), for glMultiDrawElementsIndirect
+    DrawElementsIndirectCommand IndirectCommand(unsigned int first_instance, unsigned int instance_count, int lod = 0) const
     {
-        // Draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        const MeshLod& level = lods[std::min<size_t>(lod, lods.size() - 1)];
+        return { level.index_count, instance_count, level.first_index, (int)allocation.base_vertex, first_instance };
+    }
 
-        // Always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // Draw instances [first_instance, first_instance + instance_count) of the pass's InstanceBuffer,
+    // without material setting (use shader.use() or MeshRenderer::Setup to set render method).
+    // depth_only draws from the position stream alone, for shaders reading nothing but location 0
+    void Draw(unsigned int first_instance, unsigned int instance_count, int lod = 0, bool depth_only = false)
+    {
+        if (allocation.page < 0)
+        {
+            return;
+        }
+        const MeshLod& level = lods[std::min<size_t>(lod, lods.size() - 1)];
+        MeshArena* arena = MeshArena::GetInstance();
+        // Draw mesh, bindings are left in place for GLState to filter
+        GLState::GetInstance()->BindVertexArray(depth_only ? arena->GetDepthVertexArray(allocation.page) : arena->GetVertexArray(allocation.page));
+        InstanceBuffer::GetInstance()->BindRange(first_instance);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level.index_count, arena->GetIndexType(allocation.page),
+            (void*)((size_t)level.first_index * arena->GetIndexSize(allocation.page)), instance_count, allocation.base_vertex);
     }
 
 private:
-    // Render data
-    unsigned int VBO, EBO;
+    static unsigned int cur_id;
 
-    // Initializes all the buffer objects/arrays
+    // Pack the mesh into the shared MeshArena, the CPU copy stays full precision
     void setupMesh()
     {
-        // Create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // Load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // Again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // Set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-        // ids
-        glEnableVertexAttribArray(5);
-        glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-        // weights
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-        glBindVertexArray(0);
+        id = cur_id++;
+        PackedVertices packed = VertexFormat::Pack(vertices, EditorSettings::QuantizePositions, vertex_transform);
+        layout = packed.layout;
+        allocation = MeshArena::GetInstance()->Allocate(packed.View(), indices);
+        lods.push_back({ allocation.first_index, allocation.index_count, 0.0f });
     }
 };
 
+// lives in the SceneStore's renderer array, which moves it around as renderers come and go
 class MeshRenderer
 {
 public:
-    Material*   material;
-    Mesh*       mesh;
+    Material*   material = nullptr;
+    Mesh*       mesh = nullptr;
+    unsigned int entity = 0xFFFFFFFF;           // SceneStore entity whose world matrix it is drawn with
     bool        cast_shadow = true;
+    bool        occluder = false;               // drawn into the software occlusion buffer
+    AABB        world_bounds;                   // updated by SceneStore::UpdateWorldBounds
+    BoundingSphere world_sphere;                // updated by SceneStore::UpdateWorldBounds
+    glm::mat4   model_matrix = glm::mat4(1.0f); // updated by SceneStore::UpdateWorldBounds
+    Mesh*       shadow_mesh = nullptr;          // mesh the shadow maps last saw casting, nullptr if none
+    int         lod = 0;                        // level drawn by the camera passes, see UpdateLod
+    int         shadow_lod = 0;                 // level drawn into the shadow maps
 
 public:
     MeshRenderer(Material* _material, Mesh* _mesh) : material(_material), mesh(_mesh) {}
+    MeshRenderer(const MeshRenderer&) = delete;
+    MeshRenderer& operator=(const MeshRenderer&) = delete;
+    MeshRenderer(MeshRenderer&& other) noexcept { *this = std::move(other); }
+
+    // the material goes along, the one this renderer had is freed
+    MeshRenderer& operator=(MeshRenderer&& other) noexcept
+    {
+        if (this == &other) return *this;
+        delete material;
+        material = other.material;
+        other.material = nullptr;
+        mesh = other.mesh;
+        entity = other.entity;
+        cast_shadow = other.cast_shadow;
+        occluder = other.occluder;
+        world_bounds = other.world_bounds;
+        world_sphere = other.world_sphere;
+        model_matrix = other.model_matrix;
+        shadow_mesh = other.shadow_mesh;
+        lod = other.lod;
+        shadow_lod = other.shadow_lod;
+        return *this;
+    }
+
     ~MeshRenderer()
     {
         if (material == nullptr) return;
@@ -153,51 +289,90 @@ public:
         material = MaterialManager::CreateMaterialByType(type);
     }
 
-    void Draw()
+    /*****************************************************
+    * Pick the coarsest level whose error, projected at
+    * pixels_per_unit, stays under threshold pixels. Going
+    * coarser must also fit LOD_HYSTERESIS of the budget,
+    * so a renderer resting near a switch distance doesn't
+    * flip between two levels every frame.
+    *****************************************************/
+    void UpdateLod(float pixels_per_unit, float threshold)
     {
-        if (material->IsValid() && mesh != nullptr)
+        int count = mesh != nullptr ? (int)mesh->lods.size() : 1;
+        lod = std::min(lod, count - 1);
+        int coarser = lod;
+        while (coarser + 1 < count && mesh->lods[coarser + 1].error * pixels_per_unit <= threshold * LOD_HYSTERESIS)
         {
-            switch (material->cullface)
-            {
-            case E_CULL_FACE::culloff:
-                glDisable(GL_CULL_FACE);
-                break;
-            case E_CULL_FACE::cullfront:
-                glEnable(GL_CULL_FACE);
-                glCullFace(GL_FRONT);
-                break;
-            case E_CULL_FACE::cullback:
-                glEnable(GL_CULL_FACE);
-                glCullFace(GL_BACK);
-                break;
-            default:
-                glEnable(GL_CULL_FACE);
-                break;
-            }
+            coarser++;
+        }
+        if (coarser > lod)
+        {
+            lod = coarser;
+            return;
+        }
+        while (lod > 0 && mesh->lods[lod].error * pixels_per_unit > threshold)
+        {
+            lod--;
+        }
+    }
 
-            if (EditorSettings::UsePolygonMode)
-            {
-                // draw mesh
-                glBindVertexArray(mesh->VAO);
-                glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(mesh->indices.size()), GL_UNSIGNED_INT, 0);
-                glBindVertexArray(0);
+    // the material's cull mode, the Z-prepass draws with it too so its depth matches the color pass
+    void SetCullState() const
+    {
+        switch (material->cullface)
+        {
+        case E_CULL_FACE::culloff:
+            GLState::GetInstance()->Disable(GL_CULL_FACE);
+            break;
+        case E_CULL_FACE::cullfront:
+            GLState::GetInstance()->Enable(GL_CULL_FACE);
+            GLState::GetInstance()->CullFace(GL_FRONT);
+            break;
+        case E_CULL_FACE::cullback:
+            GLState::GetInstance()->Enable(GL_CULL_FACE);
+            GLState::GetInstance()->CullFace(GL_BACK);
+            break;
+        default:
+            GLState::GetInstance()->Enable(GL_CULL_FACE);
+            break;
+        }
+    }
 
-                // always good practice to set everything back to defaults once configured.
-                glActiveTexture(GL_TEXTURE0);
-            }
-            else
+    // Set cull state and material, false if there is nothing to draw.
+    // A material whose shader was removed draws with whatever shader
+    // is bound, the color pass binds the default one for it.
+    bool Setup()
+    {
+        if (mesh != nullptr)
+        {
+            SetCullState();
+
+            if (!EditorSettings::UsePolygonMode && material->IsValid())
             {
                 //setTB();
-                mesh->Draw(material);
+                // Use material shader
+                material->Setup(mesh->textures);
             }
+            return true;
+        }
+        return false;
+    }
+
+    void Draw(unsigned int first_instance, unsigned int instance_count)
+    {
+        if (Setup())
+        {
+            // draw mesh
+            mesh->Draw(first_instance, instance_count);
         }
     }
 
-    void PureDraw()
+    // positions only, for depth-only passes
+    void PureDraw(unsigned int first_instance, unsigned int instance_count)
     {
         if (mesh != nullptr)
         {
-            mesh->Draw();
+            mesh->Draw(first_instance, instance_count, 0, true);
         }
     }
 
@@ -219,7 +394,7 @@ public:
         bitangent.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
         bitangent.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
         bitangent.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-        material->shader->setVec3("tangent", tangent);
-		material->shader->setVec3("bitangent", bitangent);
+        material->GetShader()->setVec3("tangent", tangent);
+		material->GetShader()->setVec3("bitangent", bitangent);
     }
 };
\ No newline at end of file
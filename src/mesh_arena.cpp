@@ -0,0 +1,254 @@
+#include <glad/glad.h>
+#include <algorithm>
+
+#include "mesh_arena.h"
+#include "mesh.h"
+#include "renderer_console.h"
+
+bool MeshArena::FreeList::Allocate(unsigned int size, unsigned int& offset)
+{
+    for (auto it = ranges.begin(); it != ranges.end(); it++)
+    {
+        if (it->size >= size)
+        {
+            offset = it->offset;
+            it->offset += size;
+            it->size -= size;
+            if (it->size == 0)
+            {
+                ranges.erase(it);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void MeshArena::FreeList::Free(unsigned int offset, unsigned int size)
+{
+    auto next = std::lower_bound(ranges.begin(), ranges.end(), offset,
+        [](const Range& range, unsigned int value) { return range.offset < value; });
+    auto it = ranges.insert(next, { offset, size });
+
+    // merge with the following range, then with the previous one
+    auto after = it + 1;
+    if (after != ranges.end() && it->offset + it->size == after->offset)
+    {
+        it->size += after->size;
+        it = ranges.erase(after) - 1;
+    }
+    if (it != ranges.begin())
+    {
+        auto before = it - 1;
+        if (before->offset + before->size == it->offset)
+        {
+            before->size += it->size;
+            ranges.erase(it);
+        }
+    }
+}
+
+bool MeshArena::FreeList::CanFit(unsigned int size) const
+{
+    for (const Range& range : ranges)
+    {
+        if (range.size >= size) return true;
+    }
+    return false;
+}
+
+unsigned int MeshArena::FreeList::FreeSize() const
+{
+    unsigned int size = 0;
+    for (const Range& range : ranges)
+    {
+        size += range.size;
+    }
+    return size;
+}
+
+int MeshArena::CreatePage(unsigned int vertex_capacity, unsigned int index_capacity, unsigned int index_type, const VertexLayout& layout)
+{
+    Page page;
+    page.layout = layout;
+    page.index_type = index_type;
+    page.index_size = index_type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    page.vertices.capacity = vertex_capacity;
+    page.vertices.ranges.push_back({ 0, vertex_capacity });
+    page.indices.capacity = index_capacity;
+    page.indices.ranges.push_back({ 0, index_capacity });
+
+    glGenVertexArrays(1, &page.vao);
+    glGenVertexArrays(1, &page.depth_vao);
+    glGenBuffers(1, &page.position_vbo);
+    glGenBuffers(1, &page.vbo);
+    glGenBuffers(1, &page.ebo);
+
+    GLState::GetInstance()->BindVertexArray(page.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, page.position_vbo);
+    glBufferData(GL_ARRAY_BUFFER, (size_t)vertex_capacity * layout.PositionStride(), NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, page.vbo);
+    glBufferData(GL_ARRAY_BUFFER, (size_t)vertex_capacity * layout.Stride(), NULL, GL_STATIC_DRAW);
+    if (layout.skinned)
+    {
+        glGenBuffers(1, &page.skin_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, page.skin_vbo);
+        glBufferData(GL_ARRAY_BUFFER, (size_t)vertex_capacity * layout.SkinStride(), NULL, GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (size_t)index_capacity * page.index_size, NULL, GL_STATIC_DRAW);
+
+    // Set the vertex attribute pointers
+    VertexFormat::SetupVertexArray(layout, page.position_vbo, page.vbo, page.skin_vbo);
+    // instance model matrix, pointers are set per draw
+    InstanceBuffer::SetupVertexArray();
+
+    GLState::GetInstance()->BindVertexArray(page.depth_vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page.ebo);
+    VertexFormat::SetupPositionArray(layout, page.position_vbo);
+    InstanceBuffer::SetupVertexArray();
+    GLState::GetInstance()->BindVertexArray(0);
+
+    pages.push_back(page);
+    RendererConsole::GetInstance()->AddNote("Mesh arena: new page %d (%u vertices of %u + %u bytes%s, %u %d-bit indices)", (int)pages.size() - 1,
+        vertex_capacity, layout.PositionStride(), layout.Stride(), layout.skinned ? " + skin" : "", index_capacity, page.index_size * 8);
+    return (int)pages.size() - 1;
+}
+
+MeshAllocation MeshArena::Allocate(const PackedVertexView& vertices, const std::vector<unsigned int>& indices)
+{
+    MeshAllocation allocation;
+    unsigned int vertex_count = vertices.count;
+    unsigned int index_count = indices.size();
+    if (vertex_count == 0 || index_count == 0)
+    {
+        return allocation;
+    }
+
+    unsigned int index_type = vertex_count <= SHORT_INDEX_VERTICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    int page = -1;
+    for (int i = 0; i < (int)pages.size(); i++)
+    {
+        if (pages[i].index_type == index_type && pages[i].layout == vertices.layout && pages[i].vertices.CanFit(vertex_count) && pages[i].indices.CanFit(index_count))
+        {
+            page = i;
+            break;
+        }
+    }
+    if (page < 0)
+    {
+        // meshes larger than a page get a page of their own
+        page = CreatePage(std::max(vertex_count, PAGE_VERTICES), std::max(index_count, PAGE_INDICES), index_type, vertices.layout);
+    }
+
+    Page& p = pages[page];
+    p.vertices.Allocate(vertex_count, allocation.base_vertex);
+    p.indices.Allocate(index_count, allocation.first_index);
+    allocation.page = page;
+    allocation.vertex_count = vertex_count;
+    allocation.index_count = index_count;
+
+    // the element buffer binding belongs to the VAO
+    GLState::GetInstance()->BindVertexArray(p.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, p.position_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, (size_t)allocation.base_vertex * p.layout.PositionStride(), (size_t)vertex_count * p.layout.PositionStride(), vertices.positions);
+    glBindBuffer(GL_ARRAY_BUFFER, p.vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, (size_t)allocation.base_vertex * p.layout.Stride(), (size_t)vertex_count * p.layout.Stride(), vertices.data);
+    if (p.layout.skinned)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, p.skin_vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, (size_t)allocation.base_vertex * p.layout.SkinStride(), (size_t)vertex_count * p.layout.SkinStride(), vertices.skin);
+    }
+    UploadIndices(p, allocation.first_index, indices);
+    GLState::GetInstance()->BindVertexArray(0);
+    return allocation;
+}
+
+void MeshArena::Free(MeshAllocation& allocation)
+{
+    if (allocation.page < 0)
+    {
+        return;
+    }
+    Page& p = pages[allocation.page];
+    p.vertices.Free(allocation.base_vertex, allocation.vertex_count);
+    p.indices.Free(allocation.first_index, allocation.index_count);
+    allocation = MeshAllocation();
+}
+
+bool MeshArena::AllocateIndices(int page, const std::vector<unsigned int>& indices, unsigned int& first_index)
+{
+    if (page < 0 || indices.empty())
+    {
+        return false;
+    }
+    Page& p = pages[page];
+    if (!p.indices.Allocate(indices.size(), first_index))
+    {
+        return false;
+    }
+    GLState::GetInstance()->BindVertexArray(p.vao);
+    UploadIndices(p, first_index, indices);
+    GLState::GetInstance()->BindVertexArray(0);
+    return true;
+}
+
+void MeshArena::UploadIndices(const Page& page, unsigned int first_index, const std::vector<unsigned int>& indices)
+{
+    if (page.index_type == GL_UNSIGNED_INT)
+    {
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (size_t)first_index * sizeof(unsigned int), indices.size() * sizeof(unsigned int), indices.data());
+        return;
+    }
+    std::vector<unsigned short> narrow(indices.begin(), indices.end());
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (size_t)first_index * sizeof(unsigned short), narrow.size() * sizeof(unsigned short), narrow.data());
+}
+
+void MeshArena::FreeIndices(int page, unsigned int first_index, unsigned int index_count)
+{
+    if (page < 0)
+    {
+        return;
+    }
+    pages[page].indices.Free(first_index, index_count);
+}
+
+unsigned int MeshArena::ShortIndexPageCount() const
+{
+    unsigned int count = 0;
+    for (const Page& page : pages)
+    {
+        count += page.index_type == GL_UNSIGNED_SHORT;
+    }
+    return count;
+}
+
+unsigned int MeshArena::UsedVertices() const
+{
+    unsigned int used = 0;
+    for (const Page& page : pages)
+    {
+        used += page.vertices.capacity - page.vertices.FreeSize();
+    }
+    return used;
+}
+
+size_t MeshArena::UsedVertexBytes() const
+{
+    size_t used = 0;
+    for (const Page& page : pages)
+    {
+        used += (size_t)(page.vertices.capacity - page.vertices.FreeSize()) * (page.layout.PositionStride() + page.layout.Stride() + page.layout.SkinStride());
+    }
+    return used;
+}
+
+unsigned int MeshArena::UsedIndices() const
+{
+    unsigned int used = 0;
+    for (const Page& page : pages)
+    {
+        used += page.indices.capacity - page.indices.FreeSize();
+    }
+    return used;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <vector>
+#include "singleton_util.h"
+#include "vertex_format.h"
+
+// Where a mesh lives inside the arena, page < 0 means not allocated
+struct MeshAllocation
+{
+    int             page = -1;
+    unsigned int    base_vertex = 0;    // added to every index by glDraw*BaseVertex
+    unsigned int    first_index = 0;
+    unsigned int    vertex_count = 0;
+    unsigned int    index_count = 0;
+};
+
+/*****************************************************
+* Static mesh storage shared by every Mesh. Vertices
+* and indices are suballocated from a few large pages,
+* each page owning one VBO/EBO pair and the single VAO
+* of its packed VertexLayout, so meshes of the same page
+* draw without switching vertex arrays. Positions have a
+* VBO of their own, shared by the page's depth VAO that
+* the depth-only passes draw with, and skinned layouts
+* add one more for the bone stream. Both VAOs share the
+* page's EBO. Freed ranges go back
+* to a per-page free list and are merged with their
+* neighbours.
+*
+* Meshes of at most 65536 vertices index relative to
+* their base vertex with 16 bits, so they go to pages
+* whose element buffer is GL_UNSIGNED_SHORT, half the
+* index bandwidth. Larger meshes use 32-bit pages.
+* Callers always pass 32-bit indices.
+*****************************************************/
+class MeshArena : public Singleton<MeshArena>
+{
+public:
+    static const unsigned int PAGE_VERTICES = 1 << 18;
+    static const unsigned int PAGE_INDICES  = 1 << 20;
+    static const unsigned int SHORT_INDEX_VERTICES = 1 << 16;
+
+    MeshAllocation Allocate(const PackedVertexView& vertices, const std::vector<unsigned int>& indices);
+    void Free(MeshAllocation& allocation);
+    // extra indices over vertices already in `page` (mesh LODs), false when the page is full
+    bool AllocateIndices(int page, const std::vector<unsigned int>& indices, unsigned int& first_index);
+    void FreeIndices(int page, unsigned int first_index, unsigned int index_count);
+    unsigned int GetVertexArray(int page) const { return pages[page].vao; }
+    // position only, for the shadow and Z-prepass passes
+    unsigned int GetDepthVertexArray(int page) const { return pages[page].depth_vao; }
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, and its size in bytes
+    unsigned int GetIndexType(int page) const { return pages[page].index_type; }
+    unsigned int GetIndexSize(int page) const { return pages[page].index_size; }
+
+    // for the stats panel
+    unsigned int PageCount() const { return pages.size(); }
+    unsigned int ShortIndexPageCount() const;
+    unsigned int UsedVertices() const;
+    size_t UsedVertexBytes() const;
+    unsigned int UsedIndices() const;
+
+private:
+    struct Range
+    {
+        unsigned int offset;
+        unsigned int size;
+    };
+
+    // first-fit range allocator, free ranges are kept sorted by offset
+    struct FreeList
+    {
+        unsigned int capacity = 0;
+        std::vector<Range> ranges;
+
+        bool Allocate(unsigned int size, unsigned int& offset);
+        void Free(unsigned int offset, unsigned int size);
+        bool CanFit(unsigned int size) const;
+        unsigned int FreeSize() const;
+    };
+
+    struct Page
+    {
+        unsigned int vao = 0;
+        unsigned int depth_vao = 0;
+        unsigned int position_vbo = 0;
+        unsigned int vbo = 0;
+        unsigned int ebo = 0;
+        unsigned int skin_vbo = 0;
+        VertexLayout layout;
+        unsigned int index_type = 0;
+        unsigned int index_size = 0;
+        FreeList vertices;
+        FreeList indices;
+    };
+
+    int CreatePage(unsigned int vertex_capacity, unsigned int index_capacity, unsigned int index_type, const VertexLayout& layout);
+    // write indices at first_index of the page's bound element buffer in its index type
+    void UploadIndices(const Page& page, unsigned int first_index, const std::vector<unsigned int>& indices);
+
+    std::vector<Page> pages;
+};
@@ -0,0 +1,460 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "mesh_cache.h"
+#include "mapped_file.h"
+#include "model.h"
+#include "file_system.h"
+#include "renderer_console.h"
+
+// every section of the file starts at a multiple of this
+#define MESH_CACHE_ALIGNMENT 8
+
+namespace
+{
+    const char CACHE_MAGIC[8] = { 'M', 'E', 'S', 'H', 'C', 'A', 'C', 'H' };
+
+    // import settings the cached data depends on
+    enum ECacheFlags
+    {
+        CACHE_QUANTIZED_POSITIONS = 1 << 0,
+    };
+
+    enum ELayoutBits
+    {
+        LAYOUT_POSITION16   = 1 << 0,
+        LAYOUT_UV16         = 1 << 1,
+        LAYOUT_SKINNED      = 1 << 2,
+    };
+
+    struct CacheHeader
+    {
+        char        magic[8];
+        uint32_t    version;
+        uint32_t    vertex_size;        // sizeof(Vertex), the CPU copy is stored as is
+        uint32_t    max_lods;           // MAX_MESH_LODS
+        uint32_t    flags;              // ECacheFlags
+        uint64_t    source_size;
+        int64_t     source_mtime;
+        uint64_t    source_hash;
+        uint32_t    mesh_count;
+        uint32_t    padding;
+    };
+
+    /*****************************************************
+    * One per mesh, followed by its sections in order:
+    * name, Vertex[vertex_count], uint32 indices, packed
+    * position, attribute and (if skinned) skin streams,
+    * the index buffer of every level after the first,
+    * BvhNode[bvh_node_count] and, if there are any, one
+    * uint32 triangle per leaf slot (index_count / 3),
+    * then per texture a uint32 length and the path.
+    *****************************************************/
+    struct CacheMesh
+    {
+        uint32_t    vertex_count;
+        uint32_t    index_count;
+        uint32_t    lod_count;          // levels after the full mesh
+        uint32_t    texture_count;
+        uint32_t    name_length;
+        uint32_t    layout;             // ELayoutBits
+        uint32_t    bvh_node_count;     // 0 for a mesh without triangles
+        uint32_t    padding;
+        float       bounds_min[3];
+        float       bounds_max[3];
+        float       sphere_center[3];
+        float       sphere_radius;
+        float       vertex_transform[16];
+        uint32_t    lod_index_count[MAX_MESH_LODS];
+        float       lod_error[MAX_MESH_LODS];
+    };
+
+    // pointers into the mapping for one mesh, gathered before anything is created
+    struct CachedMeshView
+    {
+        const CacheMesh*                    record;
+        const char*                         name;
+        const Vertex*                       vertices;
+        const unsigned int*                 indices;
+        PackedVertexView                    packed;
+        std::vector<const unsigned int*>    lods;
+        const BvhNode*                      bvh_nodes;
+        const unsigned int*                 bvh_triangles;
+        std::vector<std::string>            textures;
+    };
+
+    size_t Align(size_t offset)
+    {
+        return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+    }
+
+    // bounds checked cursor over the mapping, failed stays set after the first overrun
+    class CacheReader
+    {
+    public:
+        CacheReader(const unsigned char* _data, size_t _size) : data(_data), size(_size) {}
+
+        template <typename T>
+        const T* Take(size_t count = 1)
+        {
+            size_t bytes = sizeof(T) * count;
+            if (failed || bytes > size - offset)
+            {
+                failed = true;
+                return nullptr;
+            }
+            const T* result = (const T*)(data + offset);
+            offset = std::min(Align(offset + bytes), size);
+            return result;
+        }
+
+        bool failed = false;
+
+    private:
+        const unsigned char* data;
+        size_t size;
+        size_t offset = 0;
+    };
+
+    class CacheWriter
+    {
+    public:
+        CacheWriter(std::ofstream& _out) : out(_out) {}
+
+        template <typename T>
+        void Put(const T* values, size_t count = 1)
+        {
+            size_t bytes = sizeof(T) * count;
+            if (bytes > 0)
+            {
+                out.write((const char*)values, bytes);
+            }
+            static const char zeros[MESH_CACHE_ALIGNMENT] = { 0 };
+            size_t padding = Align(offset + bytes) - (offset + bytes);
+            out.write(zeros, padding);
+            offset += bytes + padding;
+        }
+
+    private:
+        std::ofstream& out;
+        size_t offset = 0;
+    };
+
+    // FNV-1a
+    uint64_t Hash(const unsigned char* data, size_t size)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ data[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    int64_t ModificationTime(const std::filesystem::path& path)
+    {
+        std::error_code error;
+        return (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+    }
+
+    uint32_t CurrentFlags()
+    {
+        return EditorSettings::QuantizePositions ? CACHE_QUANTIZED_POSITIONS : 0;
+    }
+
+    uint32_t LayoutBits(const VertexLayout& layout)
+    {
+        return (layout.position16 ? LAYOUT_POSITION16 : 0) | (layout.uv16 ? LAYOUT_UV16 : 0) | (layout.skinned ? LAYOUT_SKINNED : 0);
+    }
+
+    VertexLayout LayoutFromBits(uint32_t bits)
+    {
+        VertexLayout layout;
+        layout.position16 = (bits & LAYOUT_POSITION16) != 0;
+        layout.uv16 = (bits & LAYOUT_UV16) != 0;
+        layout.skinned = (bits & LAYOUT_SKINNED) != 0;
+        return layout;
+    }
+
+    // a draw or a raycast reads the vertex each index names, the file must not name one past the end
+    bool IndicesInRange(const unsigned int* indices, uint32_t count, uint32_t vertex_count)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (indices[i] >= vertex_count)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool ReadMesh(CacheReader& reader, CachedMeshView& view)
+    {
+        view.record = reader.Take<CacheMesh>();
+        if (view.record == nullptr || view.record->lod_count >= MAX_MESH_LODS)
+        {
+            return false;
+        }
+        const CacheMesh& record = *view.record;
+        view.name = reader.Take<char>(record.name_length);
+        view.vertices = reader.Take<Vertex>(record.vertex_count);
+        view.indices = reader.Take<unsigned int>(record.index_count);
+
+        view.packed.layout = LayoutFromBits(record.layout);
+        view.packed.count = record.vertex_count;
+        view.packed.positions = reader.Take<unsigned char>((size_t)record.vertex_count * view.packed.layout.PositionStride());
+        view.packed.data = reader.Take<unsigned char>((size_t)record.vertex_count * view.packed.layout.Stride());
+        view.packed.skin = view.packed.layout.skinned ? reader.Take<unsigned char>((size_t)record.vertex_count * view.packed.layout.SkinStride()) : nullptr;
+
+        if (reader.failed || !IndicesInRange(view.indices, record.index_count, record.vertex_count))
+        {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < record.lod_count; i++)
+        {
+            view.lods.push_back(reader.Take<unsigned int>(record.lod_index_count[i]));
+            if (reader.failed || !IndicesInRange(view.lods[i], record.lod_index_count[i], record.vertex_count))
+            {
+                return false;
+            }
+        }
+        uint32_t triangle_count = record.bvh_node_count > 0 ? record.index_count / 3 : 0;
+        view.bvh_nodes = reader.Take<BvhNode>(record.bvh_node_count);
+        view.bvh_triangles = reader.Take<unsigned int>(triangle_count);
+        // a traversal trusts every child and leaf range, the file must not point it outside the arrays
+        for (uint32_t i = 0; i < record.bvh_node_count && !reader.failed; i++)
+        {
+            const BvhNode& node = view.bvh_nodes[i];
+            if (node.IsLeaf() ? (uint64_t)node.first + node.count > triangle_count : node.first <= i || (uint64_t)node.first + 1 >= record.bvh_node_count)
+            {
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < triangle_count && !reader.failed; i++)
+        {
+            if (view.bvh_triangles[i] >= triangle_count)
+            {
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < record.texture_count && !reader.failed; i++)
+        {
+            const uint32_t* length = reader.Take<uint32_t>();
+            const char* path = length != nullptr ? reader.Take<char>(*length) : nullptr;
+            if (path != nullptr)
+            {
+                view.textures.push_back(std::string(path, *length));
+            }
+        }
+        return !reader.failed;
+    }
+}
+
+std::filesystem::path MeshCache::CacheFilePath(const std::string& source_path)
+{
+    std::error_code error;
+    std::filesystem::path absolute = std::filesystem::absolute(source_path, error);
+    std::string key = absolute.generic_string();
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)Hash((const unsigned char*)key.data(), key.size()));
+    return FileSystem::GetCachePath() / (absolute.stem().string() + "_" + hash + ".meshcache");
+}
+
+bool MeshCache::Load(const std::string& source_path, Model* model)
+{
+    std::filesystem::path cache_path = CacheFilePath(source_path);
+    std::error_code error;
+    uintmax_t source_size = std::filesystem::file_size(source_path, error);
+    if (error || !std::filesystem::exists(cache_path, error))
+    {
+        return false;
+    }
+
+    MappedFile cache;
+    if (!cache.Open(cache_path))
+    {
+        return false;
+    }
+    CacheReader reader(cache.Data(), cache.Size());
+    const CacheHeader* header = reader.Take<CacheHeader>();
+    if (header == nullptr || memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header->version != VERSION ||
+        header->vertex_size != sizeof(Vertex) || header->max_lods != MAX_MESH_LODS || header->flags != CurrentFlags() ||
+        header->source_size != source_size)
+    {
+        return false;
+    }
+
+    // a touched but unchanged source (a checkout, a copy) keeps its cache, only the stored time is renewed
+    int64_t source_mtime = ModificationTime(source_path);
+    bool renew_mtime = false;
+    if (header->source_mtime != source_mtime)
+    {
+        MappedFile source;
+        if (!source.Open(source_path) || Hash(source.Data(), source.Size()) != header->source_hash)
+        {
+            return false;
+        }
+        renew_mtime = true;
+    }
+
+    std::vector<CachedMeshView> views(header->mesh_count);
+    for (CachedMeshView& view : views)
+    {
+        if (!ReadMesh(reader, view))
+        {
+            RendererConsole::GetInstance()->AddWarn("Mesh cache %s is truncated or damaged, importing again", cache_path.string().c_str());
+            return false;
+        }
+    }
+
+    // every texture of the model first, so they decode side by side
+    vector<std::string> texture_paths;
+    for (const CachedMeshView& view : views)
+    {
+        texture_paths.insert(texture_paths.end(), view.textures.begin(), view.textures.end());
+    }
+    model->loadTextures(texture_paths);
+
+    for (const CachedMeshView& view : views)
+    {
+        const CacheMesh& record = *view.record;
+        vector<Texture2D*> textures;
+        for (const std::string& path : view.textures)
+        {
+            textures.push_back(model->textures_by_path[path]);
+        }
+        glm::mat4 vertex_transform;
+        memcpy(&vertex_transform, record.vertex_transform, sizeof(vertex_transform));
+
+        Mesh* mesh = new Mesh(vector<Vertex>(view.vertices, view.vertices + record.vertex_count),
+                              vector<unsigned int>(view.indices, view.indices + record.index_count),
+                              textures, view.packed, vertex_transform);
+        mesh->name = std::string(view.name, record.name_length);
+        mesh->bounds = AABB(glm::vec3(record.bounds_min[0], record.bounds_min[1], record.bounds_min[2]),
+                            glm::vec3(record.bounds_max[0], record.bounds_max[1], record.bounds_max[2]));
+        mesh->bounding_sphere = BoundingSphere(glm::vec3(record.sphere_center[0], record.sphere_center[1], record.sphere_center[2]), record.sphere_radius);
+        mesh->bvh.nodes.assign(view.bvh_nodes, view.bvh_nodes + record.bvh_node_count);
+        mesh->bvh.triangles.assign(view.bvh_triangles, view.bvh_triangles + (record.bvh_node_count > 0 ? record.index_count / 3 : 0));
+        for (uint32_t i = 0; i < record.lod_count; i++)
+        {
+            if (!mesh->AddLod(vector<unsigned int>(view.lods[i], view.lods[i] + record.lod_index_count[i]), record.lod_error[i]))
+            {
+                break;
+            }
+        }
+        model->meshes.push_back(mesh);
+    }
+    cache.Close();
+
+    if (renew_mtime)
+    {
+        std::fstream file(cache_path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(offsetof(CacheHeader, source_mtime));
+        file.write((const char*)&source_mtime, sizeof(source_mtime));
+    }
+    return true;
+}
+
+void MeshCache::Save(const std::string& source_path, const Model* model, const std::vector<PackedVertexView>& packed)
+{
+    std::filesystem::path cache_path = CacheFilePath(source_path);
+    std::filesystem::path temp_path = cache_path;
+    temp_path += ".tmp";
+    std::error_code error;
+    std::filesystem::create_directories(cache_path.parent_path(), error);
+
+    MappedFile source;
+    if (!source.Open(source_path))
+    {
+        return;
+    }
+    CacheHeader header = {};
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = VERSION;
+    header.vertex_size = sizeof(Vertex);
+    header.max_lods = MAX_MESH_LODS;
+    header.flags = CurrentFlags();
+    header.source_size = source.Size();
+    header.source_mtime = ModificationTime(source_path);
+    header.source_hash = Hash(source.Data(), source.Size());
+    header.mesh_count = model->meshes.size();
+    source.Close();
+
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        RendererConsole::GetInstance()->AddWarn("Can't write mesh cache %s", temp_path.string().c_str());
+        return;
+    }
+    CacheWriter writer(out);
+    writer.Put(&header);
+    for (size_t m = 0; m < model->meshes.size(); m++)
+    {
+        const Mesh* mesh = model->meshes[m];
+        const PackedVertexView& streams = packed[m];
+
+        CacheMesh record = {};
+        record.vertex_count = mesh->vertices.size();
+        record.index_count = mesh->indices.size();
+        record.lod_count = mesh->lod_indices.size();
+        record.texture_count = mesh->textures.size();
+        record.name_length = mesh->name.size();
+        record.layout = LayoutBits(streams.layout);
+        record.bvh_node_count = mesh->bvh.nodes.size();
+        memcpy(record.bounds_min, &mesh->bounds.min, sizeof(record.bounds_min));
+        memcpy(record.bounds_max, &mesh->bounds.max, sizeof(record.bounds_max));
+        memcpy(record.sphere_center, &mesh->bounding_sphere.center, sizeof(record.sphere_center));
+        record.sphere_radius = mesh->bounding_sphere.radius;
+        memcpy(record.vertex_transform, &mesh->vertex_transform, sizeof(record.vertex_transform));
+        for (uint32_t i = 0; i < record.lod_count; i++)
+        {
+            record.lod_index_count[i] = mesh->lod_indices[i].size();
+            record.lod_error[i] = mesh->lods[i + 1].error;
+        }
+
+        writer.Put(&record);
+        writer.Put(mesh->name.data(), mesh->name.size());
+        writer.Put(mesh->vertices.data(), mesh->vertices.size());
+        writer.Put(mesh->indices.data(), mesh->indices.size());
+        writer.Put((const unsigned char*)streams.positions, (size_t)streams.count * streams.layout.PositionStride());
+        writer.Put((const unsigned char*)streams.data, (size_t)streams.count * streams.layout.Stride());
+        if (streams.layout.skinned)
+        {
+            writer.Put((const unsigned char*)streams.skin, (size_t)streams.count * streams.layout.SkinStride());
+        }
+        for (const vector<unsigned int>& level : mesh->lod_indices)
+        {
+            writer.Put(level.data(), level.size());
+        }
+        writer.Put(mesh->bvh.nodes.data(), mesh->bvh.nodes.size());
+        if (!mesh->bvh.nodes.empty())
+        {
+            writer.Put(mesh->bvh.triangles.data(), mesh->bvh.triangles.size());
+        }
+        for (const Texture2D* texture : mesh->textures)
+        {
+            uint32_t length = texture->path.size();
+            writer.Put(&length);
+            writer.Put(texture->path.data(), length);
+        }
+    }
+    out.close();
+    if (!out)
+    {
+        RendererConsole::GetInstance()->AddWarn("Can't write mesh cache %s", temp_path.string().c_str());
+        std::filesystem::remove(temp_path, error);
+        return;
+    }
+    // replace the old cache only once the new one is complete
+    std::filesystem::rename(temp_path, cache_path, error);
+    if (error)
+    {
+        RendererConsole::GetInstance()->AddWarn("Can't write mesh cache %s: %s", cache_path.string().c_str(), error.message().c_str());
+    }
+}
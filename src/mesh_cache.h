@@ -0,0 +1,37 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "vertex_format.h"
+
+class Model;
+
+/*****************************************************
+* Binary cache of a model's imported meshes, one file
+* per source model under FileSystem::GetCachePath().
+* It holds what import and setup produce: the welded
+* and reordered vertices and indices, the packed GPU
+* streams, LOD index buffers, bounds, the triangle BVH
+* and the paths of the material textures, so a hit
+* skips Assimp, the MeshOptimizer, VertexFormat::Pack,
+* the simplifier and the BVH build.
+*
+* The file is memory-mapped and the packed streams are
+* uploaded straight from the mapping. A cache is valid
+* while the source has the size, modification time (or
+* failing that, content hash) and import settings it
+* was written with, and the format VERSION matches.
+*****************************************************/
+class MeshCache
+{
+public:
+    // bump whenever the file layout or anything import produces changes
+    static const unsigned int VERSION = 2;
+
+    // fill model->meshes from the cache of source_path, false on a miss
+    static bool Load(const std::string& source_path, Model* model);
+    // write the cache for a model just imported from source_path, packed holds the streams each mesh was uploaded from
+    static void Save(const std::string& source_path, const Model* model, const std::vector<PackedVertexView>& packed);
+
+    static std::filesystem::path CacheFilePath(const std::string& source_path);
+};
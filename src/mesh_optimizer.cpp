@@ -0,0 +1,405 @@
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include "mesh_optimizer.h"
+#include "mesh.h"
+#include "renderer_console.h"
+
+// a cluster may be cut where its running ACMR is within this factor of the whole cluster's
+#define OVERDRAW_ACMR_THRESHOLD 1.05f
+#define OVERDRAW_MIN_CLUSTER_TRIANGLES 32
+
+namespace
+{
+    struct VertexHash
+    {
+        const std::vector<Vertex>* vertices;
+        size_t operator()(unsigned int v) const
+        {
+            const unsigned char* bytes = (const unsigned char*)&(*vertices)[v];
+            size_t hash = 2166136261u;
+            for (size_t i = 0; i < sizeof(Vertex); i++)
+            {
+                hash = (hash ^ bytes[i]) * 16777619u;
+            }
+            return hash;
+        }
+    };
+
+    struct VertexEqual
+    {
+        const std::vector<Vertex>* vertices;
+        bool operator()(unsigned int a, unsigned int b) const
+        {
+            return memcmp(&(*vertices)[a], &(*vertices)[b], sizeof(Vertex)) == 0;
+        }
+    };
+
+    // FIFO cache simulation, returns the number of vertices transformed. Moving time on by
+    // more than the cache size empties the cache, so one timestamp array serves many runs.
+    size_t CountTransforms(const unsigned int* indices, size_t index_count, std::vector<unsigned int>& timestamps, unsigned int& time)
+    {
+        time += MeshOptimizer::CACHE_SIZE + 1;
+        size_t transforms = 0;
+        for (size_t i = 0; i < index_count; i++)
+        {
+            unsigned int v = indices[i];
+            if (time - timestamps[v] > MeshOptimizer::CACHE_SIZE)
+            {
+                timestamps[v] = time++;
+                transforms++;
+            }
+        }
+        return transforms;
+    }
+
+    size_t CountTransforms(const std::vector<unsigned int>& indices, size_t vertex_count)
+    {
+        std::vector<unsigned int> timestamps(vertex_count, 0);
+        unsigned int time = 0;
+        return CountTransforms(indices.data(), indices.size(), timestamps, time);
+    }
+}
+
+MeshOptimizer::Stats MeshOptimizer::Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    Stats stats;
+    // point and line primitives stay as they are
+    if (vertices.empty() || indices.size() < 3 || indices.size() % 3 != 0)
+    {
+        return stats;
+    }
+    stats.vertices_before = vertices.size();
+    stats.acmr_before = ACMR(indices, vertices.size());
+    stats.atvr_before = ATVR(indices, vertices.size());
+
+    std::vector<unsigned int> clusters;
+    WeldVertices(vertices, indices);
+    OptimizeVertexCache(indices, vertices.size(), &clusters);
+    OptimizeOverdraw(vertices, indices, clusters);
+    OptimizeVertexFetch(vertices, indices);
+
+    stats.vertices_after = vertices.size();
+    stats.acmr_after = ACMR(indices, vertices.size());
+    stats.atvr_after = ATVR(indices, vertices.size());
+    return stats;
+}
+
+void MeshOptimizer::LogStats(const std::string& name, const Stats& stats)
+{
+    if (stats.vertices_before == 0)
+    {
+        return;
+    }
+    RendererConsole::GetInstance()->AddNote("Optimize mesh %s: %zu -> %zu vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+        name.c_str(), stats.vertices_before, stats.vertices_after, stats.acmr_before, stats.acmr_after, stats.atvr_before, stats.atvr_after);
+}
+
+void MeshOptimizer::WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    std::unordered_map<unsigned int, unsigned int, VertexHash, VertexEqual> unique(vertices.size(), VertexHash{ &vertices }, VertexEqual{ &vertices });
+    std::vector<unsigned int> remap(vertices.size());
+    std::vector<Vertex> welded;
+    welded.reserve(vertices.size());
+    for (unsigned int v = 0; v < vertices.size(); v++)
+    {
+        auto it = unique.emplace(v, (unsigned int)welded.size());
+        if (it.second)
+        {
+            welded.push_back(vertices[v]);
+        }
+        remap[v] = it.first->second;
+    }
+    if (welded.size() == vertices.size())
+    {
+        return;
+    }
+    for (unsigned int& index : indices)
+    {
+        index = remap[index];
+    }
+    vertices.swap(welded);
+}
+
+/*****************************************************
+* Tipsify (Sander, Nehab, Barczak 2007). Fans around a
+* vertex, emitting all its triangles, then moves on to
+* the emitted vertex that is still in the cache and
+* has the fewest triangles left. When none qualifies
+* it backtracks through recently emitted vertices, and
+* only then restarts at the next vertex in file order.
+* Those restarts begin a new cluster.
+*****************************************************/
+void MeshOptimizer::OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertex_count, std::vector<unsigned int>* clusters)
+{
+    size_t triangle_count = indices.size() / 3;
+    if (clusters != nullptr)
+    {
+        clusters->clear();
+    }
+    if (triangle_count == 0)
+    {
+        return;
+    }
+
+    // triangles around each vertex, and how many of them are still to be emitted
+    std::vector<unsigned int> live(vertex_count, 0);
+    for (size_t i = 0; i < triangle_count * 3; i++)
+    {
+        live[indices[i]]++;
+    }
+    std::vector<unsigned int> offsets(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; v++)
+    {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+    std::vector<unsigned int> adjacency(triangle_count * 3);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < triangle_count * 3; i++)
+    {
+        adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+    }
+
+    std::vector<unsigned int> timestamps(vertex_count, 0);
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<unsigned int> dead_end;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> result;
+    result.reserve(triangle_count * 3);
+    unsigned int time = CACHE_SIZE + 1;
+    size_t cursor = 0;
+
+    int fan = 0;
+    if (clusters != nullptr)
+    {
+        clusters->push_back(0);
+    }
+    while (fan >= 0)
+    {
+        candidates.clear();
+        for (unsigned int a = offsets[fan]; a < offsets[fan + 1]; a++)
+        {
+            unsigned int t = adjacency[a];
+            if (emitted[t])
+            {
+                continue;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[t * 3 + k];
+                result.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - timestamps[v] > CACHE_SIZE)
+                {
+                    timestamps[v] = time++;
+                }
+            }
+            emitted[t] = true;
+        }
+
+        // the candidate still in the cache after its remaining fan is emitted, the oldest wins
+        int best = -1;
+        int best_priority = -1;
+        for (unsigned int v : candidates)
+        {
+            if (live[v] == 0)
+            {
+                continue;
+            }
+            int priority = 0;
+            if (time - timestamps[v] + 2 * live[v] <= CACHE_SIZE)
+            {
+                priority = time - timestamps[v];
+            }
+            if (priority > best_priority)
+            {
+                best_priority = priority;
+                best = v;
+            }
+        }
+
+        if (best < 0)
+        {
+            while (!dead_end.empty() && best < 0)
+            {
+                unsigned int v = dead_end.back();
+                dead_end.pop_back();
+                if (live[v] > 0)
+                {
+                    best = v;
+                }
+            }
+        }
+        if (best < 0)
+        {
+            while (cursor < vertex_count && live[cursor] == 0)
+            {
+                cursor++;
+            }
+            if (cursor < vertex_count)
+            {
+                best = (int)cursor;
+                if (clusters != nullptr)
+                {
+                    clusters->push_back((unsigned int)result.size());
+                }
+            }
+        }
+        fan = best;
+    }
+    indices.swap(result);
+}
+
+/*****************************************************
+* Overdraw from the cache order (Tipsify, section 5):
+* cut the hard clusters further wherever the running
+* ACMR has come back near the cluster's own, then draw
+* the clusters facing most outwards from the mesh
+* center first, since they tend to hide the others.
+* The cuts only cost the reuse across a boundary.
+*****************************************************/
+void MeshOptimizer::OptimizeOverdraw(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const std::vector<unsigned int>& clusters)
+{
+    size_t index_count = indices.size();
+    if (clusters.empty() || index_count < 3)
+    {
+        return;
+    }
+
+    // soft boundaries inside every hard cluster
+    std::vector<unsigned int> starts;
+    std::vector<unsigned int> timestamps(vertices.size(), 0);
+    unsigned int time = 0;
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        size_t begin = clusters[c];
+        size_t end = c + 1 < clusters.size() ? clusters[c + 1] : index_count;
+        if (begin >= end)
+        {
+            continue;
+        }
+        float cluster_acmr = (float)CountTransforms(&indices[begin], end - begin, timestamps, time) / ((end - begin) / 3);
+
+        size_t transforms = 0;
+        size_t start = begin;
+        starts.push_back((unsigned int)begin);
+        for (size_t i = begin; i < end; i += 3)
+        {
+            if (i == start)
+            {
+                time += CACHE_SIZE + 1;
+                transforms = 0;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[i + k];
+                if (time - timestamps[v] > CACHE_SIZE)
+                {
+                    timestamps[v] = time++;
+                    transforms++;
+                }
+            }
+            size_t triangles = (i + 3 - start) / 3;
+            if (i + 3 < end && triangles >= OVERDRAW_MIN_CLUSTER_TRIANGLES &&
+                (float)transforms / triangles <= cluster_acmr * OVERDRAW_ACMR_THRESHOLD)
+            {
+                start = i + 3;
+                starts.push_back((unsigned int)start);
+            }
+        }
+    }
+    if (starts.size() < 2)
+    {
+        return;
+    }
+
+    // area weighted center of the mesh and of each cluster, and each cluster's normal
+    glm::vec3 mesh_center(0);
+    float mesh_area = 0;
+    std::vector<glm::vec3> centers(starts.size(), glm::vec3(0));
+    std::vector<glm::vec3> normals(starts.size(), glm::vec3(0));
+    std::vector<float> areas(starts.size(), 0.0f);
+    for (size_t c = 0; c < starts.size(); c++)
+    {
+        size_t end = c + 1 < starts.size() ? starts[c + 1] : index_count;
+        for (size_t i = starts[c]; i < end; i += 3)
+        {
+            const glm::vec3& p0 = vertices[indices[i]].Position;
+            const glm::vec3& p1 = vertices[indices[i + 1]].Position;
+            const glm::vec3& p2 = vertices[indices[i + 2]].Position;
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(n);
+            centers[c] += (p0 + p1 + p2) * (area / 3.0f);
+            normals[c] += n;
+            areas[c] += area;
+        }
+        mesh_center += centers[c];
+        mesh_area += areas[c];
+    }
+    if (mesh_area <= 0.0f)
+    {
+        return;
+    }
+    mesh_center /= mesh_area;
+
+    std::vector<float> outwardness(starts.size());
+    std::vector<unsigned int> order(starts.size());
+    for (size_t c = 0; c < starts.size(); c++)
+    {
+        glm::vec3 center = areas[c] > 0.0f ? centers[c] / areas[c] : mesh_center;
+        float length = glm::length(normals[c]);
+        glm::vec3 normal = length > 0.0f ? normals[c] / length : glm::vec3(0);
+        outwardness[c] = glm::dot(center - mesh_center, normal);
+        order[c] = (unsigned int)c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return outwardness[a] > outwardness[b]; });
+
+    std::vector<unsigned int> result;
+    result.reserve(index_count);
+    for (unsigned int c : order)
+    {
+        size_t end = c + 1 < starts.size() ? starts[c + 1] : index_count;
+        result.insert(result.end(), indices.begin() + starts[c], indices.begin() + end);
+    }
+    indices.swap(result);
+}
+
+// vertices in order of first use, unused ones are dropped
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    const unsigned int unused = 0xFFFFFFFF;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (unsigned int& index : indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = (unsigned int)ordered.size();
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+float MeshOptimizer::ACMR(const std::vector<unsigned int>& indices, size_t vertex_count)
+{
+    if (indices.size() < 3)
+    {
+        return 0.0f;
+    }
+    return (float)CountTransforms(indices, vertex_count) / (indices.size() / 3);
+}
+
+float MeshOptimizer::ATVR(const std::vector<unsigned int>& indices, size_t vertex_count)
+{
+    if (vertex_count == 0)
+    {
+        return 0.0f;
+    }
+    return (float)CountTransforms(indices, vertex_count) / vertex_count;
+}
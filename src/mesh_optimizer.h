@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include <vector>
+
+struct Vertex;
+
+/*****************************************************
+* Import-time reordering of a mesh's vertex and index
+* buffers. Nothing here changes what is drawn, only
+* the order the GPU meets it in:
+*
+*   weld          merge byte-identical vertices
+*   vertex cache  Tipsify triangle order, so the post
+*                 transform cache reuses vertices
+*   overdraw      clusters of that order sorted so the
+*                 outward-facing ones draw first
+*   vertex fetch  vertices in order of first use
+*
+* ACMR is transformed vertices per triangle, ATVR per
+* vertex, both with a FIFO cache of CACHE_SIZE.
+*****************************************************/
+class MeshOptimizer
+{
+public:
+    static const unsigned int CACHE_SIZE = 16;
+
+    // what Optimize changed, it doesn't log itself so import jobs can run it
+    struct Stats
+    {
+        size_t  vertices_before = 0;
+        size_t  vertices_after  = 0;
+        float   acmr_before     = 0;
+        float   acmr_after      = 0;
+        float   atvr_before     = 0;
+        float   atvr_after      = 0;
+    };
+
+    // run every stage, returns the cache statistics before and after
+    static Stats Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+    static void LogStats(const std::string& name, const Stats& stats);
+
+    static void WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+    // clusters receives the first index of each cluster the order can be cut at without losing much reuse
+    static void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertex_count, std::vector<unsigned int>* clusters = nullptr);
+    static void OptimizeOverdraw(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const std::vector<unsigned int>& clusters);
+    static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+    static float ACMR(const std::vector<unsigned int>& indices, size_t vertex_count);
+    static float ATVR(const std::vector<unsigned int>& indices, size_t vertex_count);
+};
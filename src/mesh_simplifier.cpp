@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include "mesh_simplifier.h"
+#include "mesh.h"
+
+namespace
+{
+    // symmetric 4x4 matrix of the summed squared plane distances, upper triangle
+    struct Quadric
+    {
+        double a[10] = { 0 };
+
+        void AddPlane(const glm::dvec3& n, double d)
+        {
+            a[0] += n.x * n.x; a[1] += n.x * n.y; a[2] += n.x * n.z; a[3] += n.x * d;
+            a[4] += n.y * n.y; a[5] += n.y * n.z; a[6] += n.y * d;
+            a[7] += n.z * n.z; a[8] += n.z * d;
+            a[9] += d * d;
+        }
+
+        void Add(const Quadric& q)
+        {
+            for (int i = 0; i < 10; i++) a[i] += q.a[i];
+        }
+
+        // squared distance sum of p to every plane
+        double Evaluate(const glm::vec3& p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double result = a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+                          + a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+                          + a[7] * z * z + 2 * a[8] * z
+                          + a[9];
+            return std::max(result, 0.0);
+        }
+    };
+
+    struct Collapse
+    {
+        unsigned int    from;
+        unsigned int    to;
+        double          cost;
+    };
+
+    uint64_t EdgeKey(unsigned int a, unsigned int b)
+    {
+        return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+    }
+
+    struct PositionHash
+    {
+        size_t operator()(const glm::vec3& p) const
+        {
+            unsigned int bits[3];
+            memcpy(bits, &p, sizeof(bits));
+            return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+        }
+    };
+
+    glm::vec3 TriangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+    {
+        return glm::cross(b - a, c - a);
+    }
+}
+
+std::vector<unsigned int> MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                                                   size_t target_index_count, float max_error, float& error)
+{
+    error = 0.0f;
+    std::vector<unsigned int> result = indices;
+    size_t vertex_count = vertices.size();
+    if (vertex_count == 0 || indices.size() < 3 || indices.size() <= target_index_count)
+    {
+        return result;
+    }
+
+    // vertices at the same position are one point of the surface
+    std::vector<unsigned int> position_group(vertex_count);
+    std::vector<unsigned int> group_size(vertex_count, 0);
+    std::unordered_map<glm::vec3, unsigned int, PositionHash> first_at_position;
+    for (unsigned int v = 0; v < vertex_count; v++)
+    {
+        auto it = first_at_position.emplace(vertices[v].Position, v).first;
+        position_group[v] = it->second;
+        group_size[it->second]++;
+    }
+
+    // edges used by one triangle are open borders, by more than two non-manifold
+    std::vector<bool> locked_group(vertex_count, false);
+    std::unordered_map<uint64_t, unsigned int> edge_use;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            edge_use[EdgeKey(position_group[indices[t + k]], position_group[indices[t + (k + 1) % 3]])]++;
+        }
+    }
+    for (const auto& edge : edge_use)
+    {
+        if (edge.second != 2)
+        {
+            locked_group[edge.first >> 32] = true;
+            locked_group[edge.first & 0xFFFFFFFF] = true;
+        }
+    }
+    std::vector<bool> locked(vertex_count);
+    for (unsigned int v = 0; v < vertex_count; v++)
+    {
+        unsigned int g = position_group[v];
+        locked[v] = locked_group[g] || group_size[g] > 1;
+    }
+
+    // plane quadrics, kept per position group
+    std::vector<Quadric> quadrics(vertex_count);
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        const glm::vec3& p0 = vertices[indices[t]].Position;
+        glm::vec3 n = TriangleNormal(p0, vertices[indices[t + 1]].Position, vertices[indices[t + 2]].Position);
+        float length = glm::length(n);
+        if (length <= 0.0f)
+        {
+            continue;
+        }
+        glm::dvec3 normal = glm::dvec3(n / length);
+        double d = -glm::dot(normal, glm::dvec3(p0));
+        for (int k = 0; k < 3; k++)
+        {
+            quadrics[position_group[indices[t + k]]].AddPlane(normal, d);
+        }
+    }
+
+    double max_cost = (double)max_error * max_error;
+    double worst_cost = 0.0;
+    std::vector<Collapse> collapses;
+    std::vector<unsigned int> remap(vertex_count);
+    std::vector<bool> touched(vertex_count);
+    std::vector<unsigned int> adjacency_offset(vertex_count + 1);
+    std::vector<unsigned int> adjacency;
+
+    // each pass collapses a set of independent edges, cheapest first, then rebuilds the triangles
+    while (result.size() > target_index_count)
+    {
+        collapses.clear();
+        for (size_t t = 0; t + 2 < result.size(); t += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[t + k], b = result[t + (k + 1) % 3];
+                if (!locked[a])
+                {
+                    Quadric q = quadrics[position_group[a]];
+                    q.Add(quadrics[position_group[b]]);
+                    collapses.push_back({ a, b, q.Evaluate(vertices[b].Position) });
+                }
+                if (!locked[b])
+                {
+                    Quadric q = quadrics[position_group[b]];
+                    q.Add(quadrics[position_group[a]]);
+                    collapses.push_back({ b, a, q.Evaluate(vertices[a].Position) });
+                }
+            }
+        }
+        if (collapses.empty())
+        {
+            break;
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+        // triangles around each vertex
+        std::fill(adjacency_offset.begin(), adjacency_offset.end(), 0);
+        for (unsigned int v : result)
+        {
+            adjacency_offset[v + 1]++;
+        }
+        for (size_t v = 0; v < vertex_count; v++)
+        {
+            adjacency_offset[v + 1] += adjacency_offset[v];
+        }
+        adjacency.resize(result.size());
+        std::vector<unsigned int> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+        for (size_t i = 0; i < result.size(); i++)
+        {
+            adjacency[fill[result[i]]++] = (unsigned int)(i / 3 * 3);
+        }
+
+        for (unsigned int v = 0; v < vertex_count; v++)
+        {
+            remap[v] = v;
+        }
+        std::fill(touched.begin(), touched.end(), false);
+        size_t triangles_left = result.size() / 3;
+        size_t target_triangles = target_index_count / 3;
+        unsigned int collapsed = 0;
+
+        for (const Collapse& c : collapses)
+        {
+            if (c.cost > max_cost || triangles_left <= target_triangles)
+            {
+                break;
+            }
+            if (touched[c.from] || touched[c.to])
+            {
+                continue;
+            }
+
+            // moving `from` onto `to` must not turn any surviving triangle over
+            bool flips = false;
+            unsigned int removed = 0;
+            for (unsigned int i = adjacency_offset[c.from]; i < adjacency_offset[c.from + 1] && !flips; i++)
+            {
+                unsigned int t = adjacency[i];
+                unsigned int v[3] = { result[t], result[t + 1], result[t + 2] };
+                if (v[0] == c.to || v[1] == c.to || v[2] == c.to)
+                {
+                    removed++;
+                    continue;
+                }
+                glm::vec3 p[3], q[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    p[k] = vertices[v[k]].Position;
+                    q[k] = v[k] == c.from ? vertices[c.to].Position : p[k];
+                }
+                flips = glm::dot(TriangleNormal(p[0], p[1], p[2]), TriangleNormal(q[0], q[1], q[2])) <= 0.0f;
+            }
+            if (flips)
+            {
+                continue;
+            }
+
+            // the neighbourhood changes shape, leave it for the next pass
+            for (unsigned int i = adjacency_offset[c.from]; i < adjacency_offset[c.from + 1]; i++)
+            {
+                unsigned int t = adjacency[i];
+                touched[result[t]] = touched[result[t + 1]] = touched[result[t + 2]] = true;
+            }
+            remap[c.from] = c.to;
+            quadrics[position_group[c.to]].Add(quadrics[position_group[c.from]]);
+            worst_cost = std::max(worst_cost, c.cost);
+            triangles_left -= std::min<size_t>(removed, triangles_left);
+            collapsed++;
+        }
+        if (collapsed == 0)
+        {
+            break;
+        }
+
+        size_t write = 0;
+        for (size_t t = 0; t + 2 < result.size(); t += 3)
+        {
+            unsigned int a = remap[result[t]], b = remap[result[t + 1]], c = remap[result[t + 2]];
+            if (a == b || b == c || c == a)
+            {
+                continue;
+            }
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    error = (float)std::sqrt(worst_cost);
+    return result;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <vector>
+
+struct Vertex;
+
+/*****************************************************
+* Quadric error metric simplification by half-edge
+* collapse: a vertex is moved onto a neighbour, so the
+* result is a new index buffer over the same vertices
+* and LODs can share one vertex buffer.
+*
+* Vertices on open borders, and vertices sharing their
+* position with another vertex (UV, normal or tangent
+* seams) never move, so seams and silhouettes of open
+* meshes stay intact. Collapses that would flip a
+* triangle are rejected.
+*****************************************************/
+class MeshSimplifier
+{
+public:
+    // Simplify towards target_index_count indices, never moving a vertex further than max_error
+    // (object space). error receives the largest deviation the result got, in the same units.
+    static std::vector<unsigned int> Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                                              size_t target_index_count, float max_error, float& error);
+};
@@ -1,12 +1,26 @@
 #include "scene_object.h"
 #include "model.h"
 #include "renderer_console.h"
+#include "mesh_optimizer.h"
+#include "mesh_cache.h"
+#include "job_pool.h"
+#include "gltf_loader.h"
+#include <chrono>
+#include <set>
 
 map<string, Model*> Model::LoadedModel;
+SlotMap<Model*> Model::Registry;
+unsigned int Mesh::cur_id = 0;
 
 // constructor, expects a filepath to a 3D model.
-Model::Model(string const& path, bool gamma) : gammaCorrection(gamma)           { loadModel(path);                  }
-Model::Model(std::filesystem::path path, bool gamma) : gammaCorrection(gamma)   { loadModel(path.string().c_str()); }
+Model::Model(string const& path, bool gamma) : gammaCorrection(gamma)           { handle = Registry.Insert(this); loadModel(path);                  }
+Model::Model(std::filesystem::path path, bool gamma) : gammaCorrection(gamma)   { handle = Registry.Insert(this); loadModel(path.string().c_str()); }
+
+Model* Model::Get(Handle handle)
+{
+    Model** model = Registry.Get(handle);
+    return model != nullptr ? *model : nullptr;
+}
 
 Model::~Model()
 {
@@ -15,62 +29,123 @@ Model::~Model()
     {
         it->OnModelRemoved();
     }
+    // gives the meshes' arena space back
+    for (auto mesh : meshes)
+    {
+        delete mesh;
+    }
     LoadedModel.erase(name);
+    Registry.Remove(handle);
 }
 
 // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
 void Model::loadModel(string const& path)
 {
-    // read file via ASSIMP
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-    // check for errors
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
-    {
-        RendererConsole::GetInstance()->AddError("[error] ASSIMP: %s", importer.GetErrorString()); 
-        return;
-    }
+    auto start = std::chrono::high_resolution_clock::now();
     // retrieve the directory path of the filepath
     string path_s = path;
     std::replace(path_s.begin(), path_s.end(), '\\', '/');
     directory = path_s.substr(0, path_s.find_last_of('/'));
     name = path_s.substr(path_s.find_last_of('/') + 1, path_s.size());
-    // process ASSIMP's root node recursively
-    processNode(scene->mRootNode, scene);
-    RendererConsole::GetInstance()->AddNote("Load Model From %s", path.c_str());
+
+    // an unchanged model comes straight from its cache, imported and optimized already,
+    // glTF keeps materials the cache doesn't hold and has a fast path of its own
+    bool use_cache = EditorSettings::UseMeshCache && !GltfLoader::IsGltf(path);
+    if (use_cache && MeshCache::Load(path, this))
+    {
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        RendererConsole::GetInstance()->AddNote("Load Model From %s (mesh cache, %.1f ms)", path.c_str(), ms);
+        LoadedModel.insert(map<string, Model*>::value_type(name, this));
+        return;
+    }
+
+    vector<ImportedMesh> imported;
+    if (GltfLoader::IsGltf(path))
+    {
+        // reads the file's own buffers, no Assimp scene in between, and uploads its textures
+        if (!GltfLoader::Load(path, this, imported))
+        {
+            return;
+        }
+    }
+    else
+    {
+        // read file via ASSIMP
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        // check for errors
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        {
+            RendererConsole::GetInstance()->AddError("[error] ASSIMP: %s", importer.GetErrorString()); 
+            return;
+        }
+        // collect the meshes in node order, then import them side by side: none of it needs GL
+        vector<aiMesh*> scene_meshes;
+        processNode(scene->mRootNode, scene, scene_meshes);
+        imported.resize(scene_meshes.size());
+        JobPool::GetInstance()->ParallelFor(scene_meshes.size(), [&](unsigned int i)
+        {
+            processMesh(scene_meshes[i], scene, imported[i]);
+        });
+
+        vector<string> texture_paths;
+        for (const ImportedMesh& mesh : imported)
+        {
+            texture_paths.insert(texture_paths.end(), mesh.texture_paths.begin(), mesh.texture_paths.end());
+        }
+        loadTextures(texture_paths);
+    }
+    for (ImportedMesh& mesh : imported)
+    {
+        meshes.push_back(createMesh(mesh));
+    }
+
+    if (use_cache)
+    {
+        // createMesh leaves the packed streams in imported, no need to pack again
+        vector<PackedVertexView> packed;
+        for (const ImportedMesh& mesh : imported)
+        {
+            packed.push_back(mesh.packed.View());
+        }
+        MeshCache::Save(path, this, packed);
+    }
+    float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    RendererConsole::GetInstance()->AddNote("Load Model From %s (%.1f ms, %u threads)", path.c_str(), ms, JobPool::GetInstance()->ThreadCount());
     LoadedModel.insert(map<string, Model*>::value_type(name, this));
 }
 
-// processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-void Model::processNode(aiNode* node, const aiScene* scene)
+// collects the meshes of a node and its children (if any), in the order they are kept in
+void Model::processNode(aiNode* node, const aiScene* scene, vector<aiMesh*>& found)
 {
-    // process each mesh located at the current node
+    // collect each mesh located at the current node
     for (unsigned int i = 0; i < node->mNumMeshes; i++)
     {
         // the node object only contains indices to index the actual objects in the scene. 
         // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        found.push_back(scene->mMeshes[node->mMeshes[i]]);
     }
-    // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+    // after we've collected all of the meshes (if any) we then recursively process each of the children nodes
     for (unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, found);
     }
 
 }
 
-Mesh* Model::processMesh(aiMesh* mesh, const aiScene* scene)
+// everything import does to a mesh short of GL: runs on the JobPool, so no console and no textures here
+void Model::processMesh(aiMesh* mesh, const aiScene* scene, ImportedMesh& result)
 {
     // data to fill
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-    vector<Texture2D*> textures;
+    vector<Vertex>& vertices = result.vertices;
+    vector<unsigned int>& indices = result.indices;
+    vector<string>& textures = result.texture_paths;
+    vertices.reserve(mesh->mNumVertices);
 
     // walk through each of the mesh's vertices
     for (unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
-        Vertex vertex;
+        Vertex vertex = {};  // zeroed, the welder compares vertices byte by byte
         glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
         // positions
         vector.x = mesh->mVertices[i].x;
@@ -110,6 +185,34 @@ Mesh* Model::processMesh(aiMesh* mesh, const aiScene* scene)
 
         vertices.push_back(vertex);
     }
+    // bone influences, ids index mesh->mBones, each vertex keeps its MAX_BONE_INFLUENCE strongest
+    for (unsigned int b = 0; b < mesh->mNumBones; b++)
+    {
+        const aiBone* bone = mesh->mBones[b];
+        for (unsigned int w = 0; w < bone->mNumWeights; w++)
+        {
+            Vertex& v = vertices[bone->mWeights[w].mVertexId];
+            int weakest = 0;
+            for (int i = 1; i < MAX_BONE_INFLUENCE; i++)
+            {
+                if (v.m_Weights[i] < v.m_Weights[weakest]) weakest = i;
+            }
+            if (bone->mWeights[w].mWeight > v.m_Weights[weakest])
+            {
+                v.m_BoneIDs[weakest] = b;
+                v.m_Weights[weakest] = bone->mWeights[w].mWeight;
+            }
+        }
+    }
+    if (mesh->HasBones())
+    {
+        for (Vertex& v : vertices)
+        {
+            float total = 0;
+            for (int i = 0; i < MAX_BONE_INFLUENCE; i++) total += v.m_Weights[i];
+            for (int i = 0; total > 0 && i < MAX_BONE_INFLUENCE; i++) v.m_Weights[i] /= total;
+        }
+    }
     // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
     for (unsigned int i = 0; i < mesh->mNumFaces; i++)
     {
@@ -128,51 +231,114 @@ Mesh* Model::processMesh(aiMesh* mesh, const aiScene* scene)
     // normal: texture_normalN
 
     // 1. diffuse maps
-    vector<Texture2D*> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE);
+    vector<string> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE);
     textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
     // 2. specular maps
-    vector<Texture2D*> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR);
+    vector<string> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR);
     textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
     // 3. normal maps
-    std::vector<Texture2D*> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT);
+    vector<string> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT);
     textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
     // 4. height maps
-    std::vector<Texture2D*> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT);
+    vector<string> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT);
     textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-    // return a mesh object created from the extracted mesh data
-    return new Mesh(vertices, indices, textures);
+    result.name = mesh->mName.C_Str();
+    prepareMesh(result);
+}
+
+// weld, reorder, bound, simplify and pack a mesh with its vertices and indices filled, no GL
+void Model::prepareMesh(ImportedMesh& mesh)
+{
+    // weld, then reorder for the post-transform cache, overdraw and vertex fetch
+    mesh.stats = MeshOptimizer::Optimize(mesh.vertices, mesh.indices);
+
+    // bounding sphere around the box center, radius reaches the furthest vertex
+    mesh.bounds = AABB();
+    for (const auto& v : mesh.vertices)
+    {
+        mesh.bounds.Expand(v.Position);
+    }
+    float radius = 0;
+    for (const auto& v : mesh.vertices)
+    {
+        radius = glm::max(radius, glm::length(v.Position - mesh.bounds.Center()));
+    }
+
+    mesh.bounding_sphere = BoundingSphere(mesh.bounds.Center(), radius);
+    mesh.lods = Mesh::BuildLods(mesh.vertices, mesh.indices, radius);
+    if (!mesh.vertices.empty())
+    {
+        mesh.bvh.Build(&mesh.vertices[0].Position, sizeof(Vertex), mesh.indices.data(), mesh.indices.size());
+    }
+    mesh.packed = VertexFormat::Pack(mesh.vertices, EditorSettings::QuantizePositions, mesh.vertex_transform);
 }
 
-// checks all material textures of a given type and loads the textures if they're not loaded yet.
-// the required info is returned as a Texture struct.
-vector<Texture2D*> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type)
+// the GL side: arena upload and textures, on the main thread
+Mesh* Model::createMesh(ImportedMesh& imported)
 {
+    MeshOptimizer::LogStats(imported.name, imported.stats);
     vector<Texture2D*> textures;
+    for (const string& path : imported.texture_paths)
+    {
+        textures.push_back(textures_by_path[path]);
+    }
+
+    // return a mesh object created from the extracted mesh data
+    Mesh* result = new Mesh(std::move(imported.vertices), std::move(imported.indices), textures, imported.packed.View(), imported.vertex_transform);
+    result->name = imported.name;
+    result->bounds = imported.bounds;
+    result->bounding_sphere = imported.bounding_sphere;
+    result->pbr = imported.pbr;
+    result->bvh = std::move(imported.bvh);
+    for (const MeshLodIndices& lod : imported.lods)
+    {
+        if (!result->AddLod(lod.indices, lod.error))
+        {
+            break;
+        }
+    }
+    return result;
+}
+
+// full paths of the material textures of a given type
+vector<string> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type)
+{
+    vector<string> paths;
     for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
     {
         aiString str;
         mat->GetTexture(type, i, &str);
-        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); j++)
+        paths.push_back(this->directory + '/' + string(str.C_Str()));
+    }
+    return paths;
+}
+
+// loads the textures of paths not in textures_by_path yet, decoding them on the JobPool
+void Model::loadTextures(const vector<string>& paths)
+{
+    // a texture shared by several materials is decoded once
+    vector<string> missing;
+    std::set<string> seen;
+    for (const string& path : paths)
+    {
+        if (textures_by_path.find(path) == textures_by_path.end() && seen.insert(path).second)
         {
-            if (std::strcmp(textures_loaded[j]->path.data(), str.C_Str()) == 0)
-            {
-                textures.push_back(textures_loaded[j]);
-                skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                break;
-            }
-        }
-        if (!skip)
-        {   // if texture hasn't been loaded already, load it
-            string filename = string(str.C_Str());
-            filename = this->directory + '/' + filename;
-            Texture2D* tex = new Texture2D(filename.c_str());
-            tex->path = filename.c_str();
-            textures.push_back(tex);
-            textures_loaded.push_back(tex);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+            missing.push_back(path);
         }
     }
-    return textures;
+    vector<TextureImage> images(missing.size());
+    JobPool::GetInstance()->ParallelFor(missing.size(), [&](unsigned int i)
+    {
+        Texture2D::DecodeImage(missing[i], images[i]);
+    });
+    // uploads stay on the GL thread, in the order the materials asked for them
+    for (size_t i = 0; i < missing.size(); i++)
+    {
+        Texture2D* tex = new Texture2D(images[i]);
+        Texture2D::FreeImage(images[i]);
+        tex->path = missing[i];
+        textures_by_path[missing[i]] = tex;
+        textures_loaded.push_back(tex);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+    }
 }
\ No newline at end of file
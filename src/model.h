@@ -23,33 +23,64 @@ using namespace std;
 
 class SceneModel;
 
+// CPU side of one mesh, filled by an import job (Assimp's or the GltfLoader's)
+struct ImportedMesh
+{
+    string                  name;
+    vector<Vertex>          vertices;
+    vector<unsigned int>    indices;
+    vector<string>          texture_paths;  // keys of textures_by_path
+    PbrMaterialInfo         pbr;
+    AABB                    bounds;
+    BoundingSphere          bounding_sphere;
+    MeshOptimizer::Stats    stats;
+    PackedVertices          packed;
+    glm::mat4               vertex_transform = glm::mat4(1.0f);
+    vector<MeshLodIndices>  lods;
+    MeshBvh                 bvh;
+};
+
 class Model 
 {
 public:
     // model data 
     vector<Texture2D*> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    map<string, Texture2D*> textures_by_path;  // textures_loaded by the path they were asked for
     vector<Mesh*>    meshes;
     string directory;
     bool gammaCorrection;
     string name;
     static map<string, Model*> LoadedModel;
     EditorResource<SceneModel*> refSceneModels;
+    Handle handle;
+    static SlotMap<Model*> Registry;
+    // nullptr for a stale handle
+    static Model* Get(Handle handle);
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false);
     Model(std::filesystem::path path, bool gamma = false);
     ~Model();
+
+    // loads the textures of paths not in textures_by_path yet, decoding them on the JobPool
+    void loadTextures(const vector<string>& paths);
+
+    // weld, reorder, bound, simplify and pack a mesh with its vertices and indices filled, no GL
+    static void prepareMesh(ImportedMesh& mesh);
     
 private:
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path);
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene);
+    // collects the meshes of a node and its children (if any), in the order they are kept in
+    void processNode(aiNode *node, const aiScene *scene, vector<aiMesh*>& found);
+
+    // everything import does to a mesh short of GL: runs on the JobPool
+    void processMesh(aiMesh *mesh, const aiScene *scene, ImportedMesh& result);
 
-    Mesh* processMesh(aiMesh *mesh, const aiScene *scene);
+    // the GL side: arena upload and textures, on the main thread
+    Mesh* createMesh(ImportedMesh& imported);
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture2D*> loadMaterialTextures(aiMaterial *mat, aiTextureType type);
+    // full paths of the material textures of a given type
+    vector<string> loadMaterialTextures(aiMaterial *mat, aiTextureType type);
 };
\ No newline at end of file
@@ -0,0 +1,534 @@
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_USE_SSE2
+#endif
+
+#include "occlusion_rasterizer.h"
+#include "job_pool.h"
+#include "bvh.h"
+#include "renderer_console.h"
+
+// below this many triangles waking the workers costs more than it saves
+#define PARALLEL_TRIANGLE_COUNT 256
+
+OcclusionRasterizer::OcclusionRasterizer(int _width, int _height)
+{
+    Resize(_width, _height);
+}
+
+void OcclusionRasterizer::Resize(int _width, int _height)
+{
+    int new_width = std::max(1, (_width + TILE_SIZE - 1) / TILE_SIZE) * TILE_SIZE;
+    int new_height = std::max(1, (_height + TILE_SIZE - 1) / TILE_SIZE) * TILE_SIZE;
+    if (new_width == width && new_height == height)
+    {
+        return;
+    }
+    width = new_width;
+    height = new_height;
+    tiles_x = width / TILE_SIZE;
+    tiles_y = height / TILE_SIZE;
+    depth.assign(width * height, 1.0f);
+    tile_max.assign(tiles_x * tiles_y, 1.0f);
+    ready = false;
+}
+
+void OcclusionRasterizer::Begin(const glm::mat4& _view_projection)
+{
+    view_projection = _view_projection;
+    triangles.clear();
+    ready = false;
+}
+
+void OcclusionRasterizer::AddOccluder(const glm::vec3* positions, size_t stride, const unsigned int* indices, size_t index_count, const glm::mat4& model)
+{
+    glm::mat4 mvp = view_projection * model;
+    const char* base = (const char*)positions;
+    for (size_t i = 0; i + 2 < index_count; i += 3)
+    {
+        glm::vec4 clip[3];
+        for (int k = 0; k < 3; k++)
+        {
+            const glm::vec3& p = *(const glm::vec3*)(base + indices[i + k] * stride);
+            clip[k] = mvp * glm::vec4(p, 1.0f);
+        }
+        ClipAndPush(clip);
+    }
+}
+
+/*****************************************************
+* Clip against the near plane (z = -w) only. x and y
+* are handled by clamping the bounding box to the
+* screen, and depth past the far plane never wins the
+* min against the cleared 1.
+*****************************************************/
+void OcclusionRasterizer::ClipAndPush(const glm::vec4* clip)
+{
+    float d[3];
+    int inside = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        d[k] = clip[k].z + clip[k].w;
+        inside += d[k] > 0.0f;
+    }
+    if (inside == 3)
+    {
+        PushTriangle(clip[0], clip[1], clip[2]);
+        return;
+    }
+    if (inside == 0)
+    {
+        return;
+    }
+
+    // Sutherland-Hodgman, a triangle becomes a triangle or a quad
+    glm::vec4 poly[4];
+    int count = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        int n = (k + 1) % 3;
+        if (d[k] > 0.0f)
+        {
+            poly[count++] = clip[k];
+        }
+        if ((d[k] > 0.0f) != (d[n] > 0.0f))
+        {
+            float t = d[k] / (d[k] - d[n]);
+            poly[count++] = clip[k] + (clip[n] - clip[k]) * t;
+        }
+    }
+    PushTriangle(poly[0], poly[1], poly[2]);
+    if (count == 4)
+    {
+        PushTriangle(poly[0], poly[2], poly[3]);
+    }
+}
+
+void OcclusionRasterizer::PushTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c)
+{
+    Triangle tri;
+    const glm::vec4* clip[3] = { &a, &b, &c };
+    for (int k = 0; k < 3; k++)
+    {
+        float w = std::max(clip[k]->w, 1e-6f);
+        tri.v[k] = glm::vec3((clip[k]->x / w * 0.5f + 0.5f) * width,
+                             (clip[k]->y / w * 0.5f + 0.5f) * height,
+                             clip[k]->z / w * 0.5f + 0.5f);
+    }
+
+    // both windings are drawn, occluders may have culling off
+    float area = (tri.v[1].x - tri.v[0].x) * (tri.v[2].y - tri.v[0].y) - (tri.v[1].y - tri.v[0].y) * (tri.v[2].x - tri.v[0].x);
+    if (std::abs(area) < 1e-6f)
+    {
+        return;
+    }
+    if (area < 0.0f)
+    {
+        std::swap(tri.v[1], tri.v[2]);
+    }
+
+    float min_x = std::min({ tri.v[0].x, tri.v[1].x, tri.v[2].x });
+    float max_x = std::max({ tri.v[0].x, tri.v[1].x, tri.v[2].x });
+    float min_y = std::min({ tri.v[0].y, tri.v[1].y, tri.v[2].y });
+    float max_y = std::max({ tri.v[0].y, tri.v[1].y, tri.v[2].y });
+    if (max_x < 0.0f || min_x > width || max_y < 0.0f || min_y > height)
+    {
+        return;
+    }
+    tri.min_y = std::max(0, (int)std::floor(min_y));
+    tri.max_y = std::min(height - 1, (int)std::ceil(max_y));
+    triangles.push_back(tri);
+}
+
+void OcclusionRasterizer::Rasterize()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    triangle_count = triangles.size();
+
+    int band_count = 1;
+    if (triangles.size() >= PARALLEL_TRIANGLE_COUNT)
+    {
+        band_count = std::max(1, std::min((int)JobPool::GetInstance()->ThreadCount(), tiles_y));
+    }
+
+    // bands of whole tile rows, so every job also owns the tiles it writes
+    int rows_per_band = (tiles_y + band_count - 1) / band_count;
+    JobPool::GetInstance()->ParallelFor(band_count, [&](unsigned int band)
+    {
+        int begin = band * rows_per_band;
+        int end = std::min(tiles_y, begin + rows_per_band);
+        if (begin < end)
+        {
+            RasterizeBand(begin, end);
+        }
+    });
+
+    ready = true;
+    raster_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void OcclusionRasterizer::RasterizeBand(int tile_row_begin, int tile_row_end)
+{
+    int y_begin = tile_row_begin * TILE_SIZE;
+    int y_end = tile_row_end * TILE_SIZE;
+    std::fill(depth.begin() + y_begin * width, depth.begin() + y_end * width, 1.0f);
+
+    for (const Triangle& tri : triangles)
+    {
+        if (tri.max_y >= y_begin && tri.min_y < y_end)
+        {
+            RasterizeTriangle(tri, y_begin, y_end);
+        }
+    }
+
+    for (int ty = tile_row_begin; ty < tile_row_end; ty++)
+    {
+        for (int tx = 0; tx < tiles_x; tx++)
+        {
+            float farthest = 0.0f;
+            for (int y = ty * TILE_SIZE; y < (ty + 1) * TILE_SIZE; y++)
+            {
+                const float* row = &depth[y * width + tx * TILE_SIZE];
+                for (int x = 0; x < TILE_SIZE; x++)
+                {
+                    farthest = std::max(farthest, row[x]);
+                }
+            }
+            tile_max[ty * tiles_x + tx] = farthest;
+        }
+    }
+}
+
+/*****************************************************
+* Edge functions evaluated at pixel centers, so a pixel
+* is written when its center is covered, even if the
+* mesh leaves part of it open; IsOccluded makes up for
+* that by testing a pixel more on every side. The depth
+* written is the farthest the triangle's plane gets
+* over the pixel, capped at its farthest vertex, so no
+* point of a written pixel is nearer than the mesh is.
+*****************************************************/
+void OcclusionRasterizer::RasterizeTriangle(const Triangle& tri, int y_begin, int y_end)
+{
+    const glm::vec3& v0 = tri.v[0];
+    const glm::vec3& v1 = tri.v[1];
+    const glm::vec3& v2 = tri.v[2];
+
+    // E(x, y) = a * x + b * y + c, positive inside a counter-clockwise triangle
+    float a[3] = { v0.y - v1.y, v1.y - v2.y, v2.y - v0.y };
+    float b[3] = { v1.x - v0.x, v2.x - v1.x, v0.x - v2.x };
+    float c[3] = { v0.x * v1.y - v0.y * v1.x, v1.x * v2.y - v1.y * v2.x, v2.x * v0.y - v2.y * v0.x };
+    float area = c[0] + c[1] + c[2];
+
+    // top-left rule: a pixel center on an edge shared by two triangles belongs to exactly one of them
+    bool inclusive[3];
+    for (int i = 0; i < 3; i++)
+    {
+        inclusive[i] = a[i] > 0.0f || (a[i] == 0.0f && b[i] < 0.0f);
+    }
+
+    // depth plane z = za * x + zb * y + zc, from the barycentric weights E12, E20, E01
+    float za = (a[1] * v0.z + a[2] * v1.z + a[0] * v2.z) / area;
+    float zb = (b[1] * v0.z + b[2] * v1.z + b[0] * v2.z) / area;
+    float zc = (c[1] * v0.z + c[2] * v1.z + c[0] * v2.z) / area;
+    // from the center to the farthest corner of the pixel
+    zc += 0.5f * (std::abs(za) + std::abs(zb));
+    float z_far = std::max({ v0.z, v1.z, v2.z });
+
+    int min_x = std::max(0, (int)std::floor(std::min({ v0.x, v1.x, v2.x }))) & ~3;
+    int max_x = std::min(width - 1, (int)std::ceil(std::max({ v0.x, v1.x, v2.x })));
+    int min_y = std::max(y_begin, tri.min_y);
+    int max_y = std::min(y_end - 1, tri.max_y);
+
+    for (int y = min_y; y <= max_y; y++)
+    {
+        float py = y + 0.5f;
+        float row_e[3] = { b[0] * py + c[0], b[1] * py + c[1], b[2] * py + c[2] };
+        float row_z = zb * py + zc;
+        float* row = &depth[y * width];
+
+#ifdef OCCLUSION_USE_SSE2
+        // width is a multiple of 4 and min_x is aligned to it, so the last group never overruns
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        for (int x = min_x; x <= max_x; x += 4)
+        {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[0]), px), _mm_set1_ps(row_e[0]));
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[1]), px), _mm_set1_ps(row_e[1]));
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[2]), px), _mm_set1_ps(row_e[2]));
+            __m128 in0 = inclusive[0] ? _mm_cmpge_ps(e0, zero) : _mm_cmpgt_ps(e0, zero);
+            __m128 in1 = inclusive[1] ? _mm_cmpge_ps(e1, zero) : _mm_cmpgt_ps(e1, zero);
+            __m128 in2 = inclusive[2] ? _mm_cmpge_ps(e2, zero) : _mm_cmpgt_ps(e2, zero);
+            __m128 mask = _mm_and_ps(_mm_and_ps(in0, in1), in2);
+            if (_mm_movemask_ps(mask) == 0)
+            {
+                continue;
+            }
+            __m128 z = _mm_min_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(za), px), _mm_set1_ps(row_z)), _mm_set1_ps(z_far));
+            __m128 old = _mm_loadu_ps(row + x);
+            __m128 nearer = _mm_min_ps(old, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(mask, nearer), _mm_andnot_ps(mask, old)));
+        }
+#else
+        for (int x = min_x; x <= max_x; x++)
+        {
+            float px = x + 0.5f;
+            bool inside = true;
+            for (int i = 0; i < 3; i++)
+            {
+                float e = a[i] * px + row_e[i];
+                inside = inside && (inclusive[i] ? e >= 0.0f : e > 0.0f);
+            }
+            if (inside)
+            {
+                row[x] = std::min(row[x], std::min(za * px + row_z, z_far));
+            }
+        }
+#endif
+    }
+}
+
+bool OcclusionRasterizer::IsOccluded(const AABB& bounds) const
+{
+    if (!ready || !bounds.IsValid())
+    {
+        return false;
+    }
+
+    glm::vec3 ndc_min(FLT_MAX), ndc_max(-FLT_MAX);
+    for (int c = 0; c < 8; c++)
+    {
+        glm::vec3 corner((c & 1) ? bounds.max.x : bounds.min.x, (c & 2) ? bounds.max.y : bounds.min.y, (c & 4) ? bounds.max.z : bounds.min.z);
+        glm::vec4 clip = view_projection * glm::vec4(corner, 1.0f);
+        if (clip.w <= 0.0f)
+        {
+            return false;
+        }
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndc_min = glm::min(ndc_min, ndc);
+        ndc_max = glm::max(ndc_max, ndc);
+    }
+    if (ndc_max.x < -1.0f || ndc_min.x > 1.0f || ndc_max.y < -1.0f || ndc_min.y > 1.0f)
+    {
+        return false;
+    }
+    float nearest = ndc_min.z * 0.5f + 0.5f;
+
+    // a pixel more on every side: a covered center does not mean the whole pixel is, see RasterizeTriangle
+    int x0 = glm::clamp((int)std::floor((ndc_min.x * 0.5f + 0.5f) * width) - 1, 0, width - 1);
+    int x1 = glm::clamp((int)std::floor((ndc_max.x * 0.5f + 0.5f) * width) + 1, 0, width - 1);
+    int y0 = glm::clamp((int)std::floor((ndc_min.y * 0.5f + 0.5f) * height) - 1, 0, height - 1);
+    int y1 = glm::clamp((int)std::floor((ndc_max.y * 0.5f + 0.5f) * height) + 1, 0, height - 1);
+
+    for (int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ty++)
+    {
+        for (int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; tx++)
+        {
+            if (tile_max[ty * tiles_x + tx] < nearest)
+            {
+                continue;
+            }
+            // the tile's farthest pixel may lie outside the rectangle, look closer
+            int px0 = std::max(x0, tx * TILE_SIZE), px1 = std::min(x1, tx * TILE_SIZE + TILE_SIZE - 1);
+            int py0 = std::max(y0, ty * TILE_SIZE), py1 = std::min(y1, ty * TILE_SIZE + TILE_SIZE - 1);
+            bool fully_covered = px0 == tx * TILE_SIZE && px1 == tx * TILE_SIZE + TILE_SIZE - 1 &&
+                                 py0 == ty * TILE_SIZE && py1 == ty * TILE_SIZE + TILE_SIZE - 1;
+            if (fully_covered)
+            {
+                return false;
+            }
+            for (int y = py0; y <= py1; y++)
+            {
+                for (int x = px0; x <= px1; x++)
+                {
+                    if (depth[y * width + x] >= nearest)
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/*****************************************************
+* A city of box buildings, the occluders, with props
+* scattered over its streets and some peeking out from
+* behind building edges by a fraction of a pixel, seen
+* from a crossing at eye height. The props culled are
+* checked by brute force: rays from the eye to a grid
+* of points on each face, its edges and corners
+* included, against every building. A prop is hidden
+* when none of them reaches a point in view, and a
+* culled prop that one reaches is a false positive.
+*****************************************************/
+void OcclusionRasterizer::Benchmark()
+{
+    const int blocks = 24;
+    const int props_per_block = 4;
+    const int face_samples = 8;
+    const float pitch = 20.0f;
+    const float street = 6.0f;
+
+    // a unit cube, every building is one scaled into place
+    glm::vec3 cube[8];
+    for (int c = 0; c < 8; c++)
+    {
+        cube[c] = glm::vec3(c & 1 ? 1.0f : 0.0f, c & 2 ? 1.0f : 0.0f, c & 4 ? 1.0f : 0.0f);
+    }
+    const unsigned int cube_indices[36] = { 0, 2, 6, 0, 6, 4,  1, 5, 7, 1, 7, 3,  0, 4, 5, 0, 5, 1,
+                                            2, 3, 7, 2, 7, 6,  0, 1, 3, 0, 3, 2,  4, 6, 7, 4, 7, 5 };
+
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<AABB> buildings, props;
+    for (int bz = 0; bz < blocks; bz++)
+    {
+        for (int bx = 0; bx < blocks; bx++)
+        {
+            glm::vec3 corner(bx * pitch, 0.0f, bz * pitch);
+            buildings.push_back(AABB(corner, corner + glm::vec3(pitch - street, 6.0f + unit(random) * 34.0f, pitch - street)));
+        }
+    }
+    for (int i = 0; i < blocks * blocks * props_per_block; i++)
+    {
+        // anywhere along the street east or north of a random block, never inside a building
+        glm::vec3 size(1.0f + unit(random) * 1.5f, 1.0f + unit(random), 1.0f + unit(random) * 1.5f);
+        glm::vec3 cell(pitch * (int)(unit(random) * blocks), 0.0f, pitch * (int)(unit(random) * blocks));
+        float across = pitch - street + 0.5f + unit(random) * (street - 1.0f - 2.5f);
+        float along = unit(random) * (pitch - 2.5f);
+        glm::vec3 corner = cell + (unit(random) < 0.5f ? glm::vec3(across, 0.0f, along) : glm::vec3(along, 0.0f, across));
+        props.push_back(AABB(corner, corner + size));
+    }
+
+    glm::vec3 eye(2.0f * pitch + pitch - street * 0.5f, 1.7f, 2.0f * pitch + pitch - street * 0.5f);
+    glm::mat4 view_projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f) *
+                                glm::lookAt(eye, glm::vec3(blocks * pitch, 10.0f, blocks * pitch * 0.7f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum(view_projection);
+
+    // props just behind the vertical silhouette edges of buildings in view, reaching past them by a fraction of a pixel
+    unsigned int edge_props = 0;
+    for (const AABB& building : buildings)
+    {
+        if (edge_props >= 400 || !frustum.Intersects(building))
+        {
+            continue;
+        }
+        for (int c = 0; c < 4; c++)
+        {
+            glm::vec3 corner(c & 1 ? building.max.x : building.min.x, 0.0f, c & 2 ? building.max.z : building.min.z);
+            glm::vec3 to_corner = corner - glm::vec3(eye.x, 0.0f, eye.z);
+            float distance = glm::length(to_corner);
+            glm::vec3 forward = to_corner / distance;
+            glm::vec3 side(-forward.z, 0.0f, forward.x);
+            // on a silhouette edge the whole building lies on one side of the line of sight
+            float low = 0.0f, high = 0.0f;
+            for (int o = 0; o < 4; o++)
+            {
+                glm::vec3 other(o & 1 ? building.max.x : building.min.x, 0.0f, o & 2 ? building.max.z : building.min.z);
+                low = std::min(low, glm::dot(other - corner, side));
+                high = std::max(high, glm::dot(other - corner, side));
+            }
+            if (low < -1e-3f && high > 1e-3f)
+            {
+                continue;
+            }
+            glm::vec3 half_size(0.5f, 0.75f, 0.5f);
+            float half_width = half_size.x * std::abs(side.x) + half_size.z * std::abs(side.z);
+            float sliver = 0.002f * (distance + 4.0f);
+            glm::vec3 center = corner + forward * 4.0f + side * (high > 1e-3f ? 1.0f : -1.0f) * (half_width - sliver);
+            center.y = half_size.y;
+            props.push_back(AABB(center - half_size, center + half_size));
+            edge_props++;
+        }
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<unsigned int> in_view;
+    std::vector<bool> hidden(props.size(), true);
+    unsigned int hidden_count = 0;
+    for (unsigned int i = 0; i < props.size(); i++)
+    {
+        if (!frustum.Intersects(props[i]))
+        {
+            continue;
+        }
+        in_view.push_back(i);
+        const AABB& prop = props[i];
+        for (int sample = 0; sample < 6 * face_samples * face_samples && hidden[i]; sample++)
+        {
+            int axis = sample / (2 * face_samples * face_samples);
+            int side = sample / (face_samples * face_samples) % 2;
+            float u = (float)(sample % face_samples) / (face_samples - 1);
+            float v = (float)(sample / face_samples % face_samples) / (face_samples - 1);
+            glm::vec3 point;
+            point[axis] = side ? prop.max[axis] : prop.min[axis];
+            point[(axis + 1) % 3] = glm::mix(prop.min[(axis + 1) % 3], prop.max[(axis + 1) % 3], u);
+            point[(axis + 2) % 3] = glm::mix(prop.min[(axis + 2) % 3], prop.max[(axis + 2) % 3], v);
+
+            glm::vec4 clip = view_projection * glm::vec4(point, 1.0f);
+            if (clip.w <= 0.0f || std::abs(clip.x) > clip.w || std::abs(clip.y) > clip.w || std::abs(clip.z) > clip.w)
+            {
+                continue;
+            }
+            Ray ray(eye, point - eye);
+            bool blocked = false;
+            for (unsigned int b = 0; b < buildings.size() && !blocked; b++)
+            {
+                blocked = Bvh::IntersectBox(ray, buildings[b].min, buildings[b].max, 1.0f) != FLT_MAX;
+            }
+            hidden[i] = blocked;
+        }
+        hidden_count += hidden[i];
+    }
+    float brute_force_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    RendererConsole::GetInstance()->AddNote("Occlusion rasterizer, %zu buildings, %zu props (%u at silhouettes, %zu in view), %u threads",
+        buildings.size(), props.size(), edge_props, in_view.size(), JobPool::GetInstance()->ThreadCount());
+    RendererConsole::GetInstance()->AddNote("  brute force: %u hidden to %d rays each in %.1f ms",
+        hidden_count, 6 * face_samples * face_samples, brute_force_ms);
+
+    const int widths[] = { DEFAULT_WIDTH / 2, DEFAULT_WIDTH, DEFAULT_WIDTH * 2 };
+    for (int width : widths)
+    {
+        OcclusionRasterizer rasterizer(width, width * 9 / 16);
+        rasterizer.Begin(view_projection);
+        for (const AABB& building : buildings)
+        {
+            glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), building.min), building.max - building.min);
+            rasterizer.AddOccluder(cube, sizeof(glm::vec3), cube_indices, 36, model);
+        }
+
+        float raster_ms = 1e30f;
+        for (int run = 0; run < 3; run++)
+        {
+            rasterizer.Rasterize();
+            raster_ms = std::min(raster_ms, rasterizer.raster_ms);
+        }
+
+        start = std::chrono::high_resolution_clock::now();
+        unsigned int culled = 0, false_positives = 0;
+        for (unsigned int i : in_view)
+        {
+            if (rasterizer.IsOccluded(props[i]))
+            {
+                culled++;
+                false_positives += !hidden[i];
+            }
+        }
+        float test_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        RendererConsole::GetInstance()->AddNote("  %4dx%-4d %5u tris: %7.3f ms, %6.0f tris/ms, tests %.3f ms, culled %u (%.1f%% of the hidden), %u false positives",
+            rasterizer.Width(), rasterizer.Height(), rasterizer.triangle_count, raster_ms, rasterizer.triangle_count / std::max(raster_ms, 1e-3f),
+            test_ms, culled, hidden_count > 0 ? 100.0f * culled / hidden_count : 0.0f, false_positives);
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "bounds.h"
+
+/*****************************************************
+* CPU occlusion culling with no GPU round trip. The
+* meshes flagged as occluders are drawn depth-only into
+* a small float depth buffer for this frame's camera,
+* then every TILE_SIZE x TILE_SIZE tile keeps its
+* farthest depth. A box is occluded when its nearest
+* depth is behind everything under its screen
+* rectangle grown by a pixel each way, for the pixels
+* the mesh only partly hides: tiles it covers fully are
+* tested by their maximum, partly covered ones pixel by
+* pixel.
+*
+* Rows are split into bands drawn as JobPool jobs,
+* each filling 4 pixels at a time with SSE2 when the
+* target has it. Nothing here touches GL, so it runs
+* and can be checked without a context.
+*****************************************************/
+class OcclusionRasterizer
+{
+public:
+    static const int TILE_SIZE = 8;
+    static const int DEFAULT_WIDTH = 256;
+    // occluders should be simple, bigger meshes cost more than they hide
+    static const unsigned int MAX_OCCLUDER_TRIANGLES = 4096;
+
+    OcclusionRasterizer(int _width = DEFAULT_WIDTH, int _height = DEFAULT_WIDTH * 9 / 16);
+    // sizes are rounded up to whole tiles
+    void Resize(int _width, int _height);
+    // start a frame seen through view_projection, the depth is cleared by Rasterize
+    void Begin(const glm::mat4& _view_projection);
+    // queue an indexed triangle list, positions are read every `stride` bytes
+    void AddOccluder(const glm::vec3* positions, size_t stride, const unsigned int* indices, size_t index_count, const glm::mat4& model);
+    // draw every queued triangle and build the tile maxima
+    void Rasterize();
+    bool IsReady() const { return ready; }
+    bool IsOccluded(const AABB& bounds) const;
+    // time a generated city of box occluders at three sizes, check what it culls against ray casts, log to the console
+    static void Benchmark();
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+    float DepthAt(int x, int y) const { return depth[y * width + x]; }
+
+    // stats of the last Rasterize
+    unsigned int triangle_count = 0;
+    float raster_ms = 0;
+
+private:
+    // screen space triangle: x, y in pixels, z window depth, counter-clockwise
+    struct Triangle
+    {
+        glm::vec3   v[3];
+        int         min_y, max_y;
+    };
+
+    int width = 0, height = 0;
+    int tiles_x = 0, tiles_y = 0;
+    bool ready = false;
+    glm::mat4 view_projection;
+    std::vector<Triangle> triangles;
+    std::vector<float> depth;       // window depth, 1 where nothing was drawn
+    std::vector<float> tile_max;    // farthest depth of each tile
+
+    void ClipAndPush(const glm::vec4* clip);
+    void PushTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+    void RasterizeBand(int tile_row_begin, int tile_row_end);
+    void RasterizeTriangle(const Triangle& tri, int y_begin, int y_end);
+};
@@ -2,9 +2,10 @@
 #include "render_texture.h"
 #include "renderer_window.h"
 #include "renderer_console.h"
+#include "gl_state.h"
 
 
-PostProcessManager::PostProcessManager(int screen_width, int screen_height, DepthTexture* _depthTexture) : depthTexture(_depthTexture)
+PostProcessManager::PostProcessManager(int screen_width, int screen_height)
 {
     is_editor = true;
     name = "post process manager";
@@ -31,7 +32,7 @@ void PostProcessManager::InitPostProcess()
     // Screen quad VAO
     glGenVertexArrays(1, &quadVAO);
     glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
+    GLState::GetInstance()->BindVertexArray(quadVAO);
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -100,7 +101,7 @@ void PostProcessManager::MoveDownPostProcessOnIndex(int index)
 
 void PostProcessManager::ExecutePostProcessList()
 {
-    glDisable(GL_CULL_FACE);
+    GLState::GetInstance()->Disable(GL_CULL_FACE);
     for (auto postprocess : postprocess_list)
     {
         if (postprocess->enabled)
@@ -111,17 +112,16 @@ void PostProcessManager::ExecutePostProcessList()
     }
     
     // Draw to default buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, 0);
     // clear all relevant buffers
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f); // set clear color to white (not really necessary actually, since we won't be able to see behind the quad anyways)
     glClear(GL_COLOR_BUFFER_BIT);
 
     default_framebuffer_shader->use();
-    glBindVertexArray(quadVAO);
-    glDisable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
-    glBindTexture(GL_TEXTURE_2D, read_rt->color_buffer);	// use the color attachment texture as the texture of the quad plane
+    GLState::GetInstance()->BindVertexArray(quadVAO);
+    GLState::GetInstance()->Disable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
+    GLState::GetInstance()->BindTexture(0, GL_TEXTURE_2D, read_rt->color_buffer);	// use the color attachment texture as the texture of the quad plane
     glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
 
 }
 
@@ -162,11 +162,10 @@ void PostProcess::Execute(unsigned int quad)
     BeiginRender();
 
     shader->use();
-    glBindVertexArray(quad);
-    glDisable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
-    glBindTexture(GL_TEXTURE_2D, read_rt->color_buffer);	// use the color attachment texture as the texture of the quad plane
+    GLState::GetInstance()->BindVertexArray(quad);
+    GLState::GetInstance()->Disable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
+    GLState::GetInstance()->BindTexture(0, GL_TEXTURE_2D, read_rt->color_buffer);	// use the color attachment texture as the texture of the quad plane
     glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
 
     EndRender();
 }
@@ -187,8 +186,8 @@ BloomProcess::BloomProcess(RenderTexture *_rrt, RenderTexture *_wrt, Shader *_sh
     filter_shader->LoadShader();
     gaussblur_shader->LoadShader();
     shader->use();
-    glUniform1i(glGetUniformLocation(shader->ID, "screenTexture"), 0);
-    glUniform1i(glGetUniformLocation(shader->ID, "brightFilterTexture"), 1);
+    shader->setInt("screenTexture", 0);
+    shader->setInt("brightFilterTexture", 1);
 }
 
 BloomProcess::~BloomProcess()
@@ -227,11 +226,10 @@ void BloomProcess::Execute(unsigned int quad)
 
     filter_shader->use();
     filter_shader->setFloat("threshold", threshold);
-    glBindVertexArray(quad);
-    glDisable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
-    glBindTexture(GL_TEXTURE_2D, read_rt->color_buffer);	// use the color attachment texture as the texture of the quad plane
+    GLState::GetInstance()->BindVertexArray(quad);
+    GLState::GetInstance()->Disable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
+    GLState::GetInstance()->BindTexture(0, GL_TEXTURE_2D, read_rt->color_buffer);	// use the color attachment texture as the texture of the quad plane
     glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
 
     // Blur the bright buffer
     GLboolean horizontal = true, first_iteration = true;
@@ -241,35 +239,31 @@ void BloomProcess::Execute(unsigned int quad)
     {
         pingpong_buffer[horizontal]->BindFrameBuffer(); 
         gaussblur_shader->setBool("horizontal", horizontal);
-        glBindTexture(
-            GL_TEXTURE_2D, first_iteration ? bloom_buffer->bright_buffer : pingpong_buffer[!horizontal]->color_buffer
+        GLState::GetInstance()->BindTexture(
+            0, GL_TEXTURE_2D, first_iteration ? bloom_buffer->bright_buffer : pingpong_buffer[!horizontal]->color_buffer
         ); 
         
-        glBindVertexArray(quad);
-        glDisable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
+        GLState::GetInstance()->BindVertexArray(quad);
+        GLState::GetInstance()->Disable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
         glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
 
         horizontal = !horizontal;
         if (first_iteration)
             first_iteration = false;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // Merge blur result and screen texture
     BeiginRender();
     shader->use();
     shader->setFloat("exposure", exposure);
-    glBindVertexArray(quad);
-    glDisable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
+    GLState::GetInstance()->BindVertexArray(quad);
+    GLState::GetInstance()->Disable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
     
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, read_rt->color_buffer);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, pingpong_buffer[!horizontal]->color_buffer);
+    GLState::GetInstance()->BindTexture(0, GL_TEXTURE_2D, read_rt->color_buffer);
+    GLState::GetInstance()->BindTexture(1, GL_TEXTURE_2D, pingpong_buffer[!horizontal]->color_buffer);
 
     glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
 
     EndRender();
 }
\ No newline at end of file
@@ -10,7 +10,6 @@ class RenderTexture;
 class BloomRenderBuffer;
 class RendererWindow;
 class Shader;
-class DepthTexture;
 
 /************************************************************
 * To call PostProcessMankmager::CreatePostProcess correctly,
@@ -88,7 +87,7 @@ private:
 public:
     friend class ATR_PostProcessManager;
     
-    PostProcessManager(int screen_width, int screen_height,  DepthTexture* _depthTexture);
+    PostProcessManager(int screen_width, int screen_height);
     ~PostProcessManager();
 
     template<class T>
@@ -116,6 +115,4 @@ public:
     
     RenderTexture   *read_rt;
     RenderTexture   *write_rt;
-
-    DepthTexture* depthTexture;
 };
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include <glm/gtx/matrix_decompose.hpp>
 #include <iostream>
 #include <string>
+#include <algorithm>
+#include <cmath>
 
 #include "camera.h"
 #include "shader.h"
@@ -14,6 +16,14 @@
 #include "render_pipeline.h"
 #include "scene_object.h"
 #include "gizmos.h"
+#include "uniform_buffer.h"
+#include "gl_state.h"
+#include "instance_buffer.h"
+#include "indirect_draw.h"
+#include "hiz_buffer.h"
+#include "occlusion_rasterizer.h"
+#include "scene_store.h"
+#include "transform_kernels.h"
 
 
 unsigned int cubeVAO, cubeVBO;
@@ -21,15 +31,24 @@ unsigned int quadVAO, quadVBO;
 void renderCube();
 void renderQuad();
 
-void RenderPipeline::EnqueueRenderQueue(SceneModel *model)     { ModelQueueForRender.insert({model->id, model});   }
+// NONE once the render queue is full, the model is not queued
+Handle RenderPipeline::EnqueueRenderQueue(SceneModel *model)
+{
+    Handle entry = registered_models.Insert(model);
+    if (entry == HandleTable::NONE)
+    {
+        RendererConsole::GetInstance()->AddError("[error] Render queue is full, %s is not rendered!", model->name.c_str());
+        return entry;
+    }
+    shadow_version++;
+    return entry;
+}
 
-void RenderPipeline::RemoveFromRenderQueue(unsigned int id)    { ModelQueueForRender.erase(id);                    }
+void RenderPipeline::RemoveFromRenderQueue(Handle entry)        { if (registered_models.Remove(entry)) shadow_version++;        }
 
 RenderPipeline::RenderPipeline(RendererWindow* _window) : window(_window) 
 {
-    depth_texture = new DepthTexture(window->Width(), window->Height());
-    z_buffer = new DepthTexture(window->Width(), window->Height());
-    shadow_map = new DepthTexture(shadow_map_setting.shadow_map_size, shadow_map_setting.shadow_map_size);
+    shadow_map = new DepthTextureArray(shadow_map_setting.shadow_map_size, shadow_map_setting.shadow_map_size, shadow_map_setting.cascade_count);
     /*shadow_cubemap = new DepthCubeTexture(shadow_map_setting.shadow_map_size, shadow_map_setting.shadow_map_size);*/
     depth_shader = new Shader(  FileSystem::GetContentPath() / "Shader/depth.vs",
                                 FileSystem::GetContentPath() / "Shader/depth.fs",
@@ -60,6 +79,12 @@ RenderPipeline::RenderPipeline(RendererWindow* _window) : window(_window)
                                 FileSystem::GetContentPath() / "Shader/custom/brdf.fs",
                                 true);
 
+    pass_ubo = new UniformBuffer(PASS_DATA_BINDING, sizeof(PassData));
+    light_ubo = new UniformBuffer(LIGHT_DATA_BINDING, sizeof(LightData));
+    IndirectDraw::GetInstance()->Init();
+    hiz_buffer = new HiZBuffer();
+    occlusion_rasterizer = new OcclusionRasterizer();
+
     depth_shader->LoadShader();
     grid_shader->LoadShader();
     //depth_cubemap_shader->LoadShader();
@@ -79,72 +104,525 @@ RenderPipeline::RenderPipeline(RendererWindow* _window) : window(_window)
 
 RenderPipeline::~RenderPipeline()
 {
-    delete depth_texture;
     delete shadow_map;
     //delete shadow_cubemap;
+    delete hiz_buffer;
+    delete occlusion_rasterizer;
     delete depth_shader;
     delete grid_shader;
+    delete pass_ubo;
+    delete light_ubo;
+}
+
+SceneModel *RenderPipeline::GetRenderModel(Handle entry)
+{
+    SceneModel **model = registered_models.Get(entry);
+    return model != nullptr ? *model : nullptr;
 }
 
-SceneModel *RenderPipeline::GetRenderModel(unsigned int id)
+void RenderPipeline::OnWindowSizeChanged(int width, int height)
+{
+    postprocess_manager->ResizeRenderArea(width, height);
+}
+
+/****************************************************
+* Refresh world bounds of every renderer and reset
+* culling statistics, called once per frame.
+*****************************************************/
+void RenderPipeline::UpdateWorldBounds()
 {
-    if (ModelQueueForRender.find(id) != ModelQueueForRender.end())
+    for (int i = 0; i < RENDER_PASS_COUNT; i++)
     {
-        return ModelQueueForRender[id];
+        culling_stats[i] = CullingStats();
     }
-    else
+    if (SceneStore::GetInstance()->UpdateWorldBounds())
     {
-        return nullptr;
+        shadow_version++;
     }
 }
 
-void RenderPipeline::OnWindowSizeChanged(int width, int height)
+// either occlusion test may hide a box, each answers false until it has depth
+bool RenderPipeline::IsOccluded(const AABB& bounds)
 {
-    postprocess_manager->ResizeRenderArea(width, height);
+    if (EditorSettings::UseSoftwareOcclusion && occlusion_rasterizer->IsOccluded(bounds))
+    {
+        return true;
+    }
+    return EditorSettings::UseOcclusionCulling && hiz_buffer->IsOccluded(bounds);
+}
+
+bool RenderPipeline::IsVisible(MeshRenderer* mr, const Frustum& frustum, bool occlusion, CullingStats& stats)
+{
+    if (mr->mesh == nullptr)
+    {
+        return false;
+    }
+    // the sphere rejects most of what is outside for less, the box is tighter on what is left
+    if (EditorSettings::UseFrustumCulling && (!frustum.Intersects(mr->world_sphere) || !frustum.Intersects(mr->world_bounds)))
+    {
+        stats.culled++;
+        return false;
+    }
+    if (occlusion && IsOccluded(mr->world_bounds))
+    {
+        stats.occluded++;
+        return false;
+    }
+    stats.visible++;
+    return true;
+}
 
-    // Resize depth texture as well
-    delete depth_texture;
-    depth_texture = new DepthTexture(width, height);
+// Polygon mode and broken or removed shaders fall back to the default shader
+static Shader* GetColorShader(Material* mat)
+{
+    Shader* shader = mat->GetShader();
+    if (EditorSettings::UsePolygonMode || shader == nullptr || !shader->IsValid())
+    {
+        return Shader::LoadedShaders["default.fs"];
+    }
+    return shader;
+}
+
+/*****************************************************
+* Cull every model for a pass and push the surviving
+* renderers into that pass's queue, then radix sort it.
+* Models are tested as a whole first, straight down the
+* SceneStore's bounds array, then the renderers array
+* is walked once, each renderer going by its model's
+* verdict, and counted in the stats only if the pass
+* would have drawn it. eye/forward/near/far give the
+* depth used for the front-to-back part of the key,
+* taken for all the survivors in one ViewDepths call.
+*****************************************************/
+void RenderPipeline::BuildRenderQueue(ERenderPass pass, const glm::mat4& view_projection, const glm::vec3& eye, const glm::vec3& forward, float near_plane, float far_plane)
+{
+    Frustum frustum(view_projection);
+    RenderQueue& queue = render_queues[pass];
+    CullingStats& stats = culling_stats[pass];
+    queue.Clear();
+    float overdraw = 0;
+    // the pyramid holds camera depth, a caster hidden from the camera can still shadow what it sees
+    bool occlusion = pass != SHADOW_PASS && (EditorSettings::UseOcclusionCulling || EditorSettings::UseSoftwareOcclusion);
+
+    SceneStore* store = SceneStore::GetInstance();
+    unsigned int entity_count = store->EntityCount();
+    model_visible.resize(entity_count);
+    queued_renderers.clear();
+    queued_bounds.clear();
+    for (unsigned int i = 0; i < entity_count; i++)
+    {
+        model_visible[i] = MODEL_CULLED;
+        if (store->renderer_count[i] == 0)
+        {
+            continue;
+        }
+        const AABB& bounds = store->world_bounds[i];
+        if (EditorSettings::UseFrustumCulling && !frustum.Intersects(bounds))
+        {
+            continue;
+        }
+        if (occlusion && IsOccluded(bounds))
+        {
+            model_visible[i] = MODEL_OCCLUDED;
+            continue;
+        }
+        model_visible[i] = MODEL_VISIBLE;
+    }
+
+    for (MeshRenderer& renderer : store->renderers)
+    {
+        MeshRenderer* mr = &renderer;
+        if (pass == SHADOW_PASS && !mr->cast_shadow)
+        {
+            continue;
+        }
+        // the prepass only takes what the color pass will draw over it
+        if (mr->mesh == nullptr || mr->mesh->allocation.page < 0 || (pass != SHADOW_PASS && mr->material == nullptr))
+        {
+            continue;
+        }
+        unsigned char model = model_visible[store->Index(mr->entity)];
+        if (model != MODEL_VISIBLE)
+        {
+            (model == MODEL_OCCLUDED ? stats.occluded : stats.culled)++;
+            continue;
+        }
+        if (!IsVisible(mr, frustum, occlusion, stats))
+        {
+            continue;
+        }
+
+        if (pass == COLOR_PASS && EditorSettings::ZPrePassMode == ZPREPASS_AUTO)
+        {
+            overdraw += mr->world_bounds.ScreenCoverage(view_projection);
+        }
+        queued_renderers.push_back(mr);
+        queued_bounds.push_back(mr->world_bounds);
+    }
+
+    queued_depths.resize(queued_bounds.size());
+    TransformKernels::ViewDepths(queued_bounds.size(), queued_bounds.data(), eye, forward, queued_depths.data());
+    for (size_t k = 0; k < queued_renderers.size(); k++)
+    {
+        MeshRenderer* mr = queued_renderers[k];
+        float depth01 = (queued_depths[k] - near_plane) / (far_plane - near_plane);
+        int lod = pass == SHADOW_PASS ? mr->shadow_lod : mr->lod;
+        if (pass == COLOR_PASS)
+        {
+            Shader* shader = GetColorShader(mr->material);
+            queue.Push(RenderQueue::MakeColorKey(pass, shader->ID, mr->material->BatchKey(), mr->mesh->SortKey(), lod, depth01), mr, lod);
+        }
+        else
+        {
+            unsigned int cull = pass == Z_PRE_PASS ? (unsigned int)mr->material->cullface : 0;
+            queue.Push(RenderQueue::MakeDepthKey(pass, cull, mr->mesh->SortKey(), lod, depth01), mr, lod);
+        }
+    }
+
+    if (pass == COLOR_PASS)
+    {
+        estimated_overdraw = overdraw;
+    }
+    queue.Sort();
+    BuildBatches(pass);
+}
+
+// the color pass draws with the material, the prepass with its cull mode, the shadow pass with neither
+static bool SameDrawState(ERenderPass pass, MeshRenderer* a, MeshRenderer* b)
+{
+    switch (pass)
+    {
+    case COLOR_PASS:
+        return a->material->IsBatchCompatible(b->material);
+    case Z_PRE_PASS:
+        return a->material->cullface == b->material->cullface;
+    default:
+        return true;
+    }
+}
+
+/*****************************************************
+* Merge neighbouring items of a sorted queue into
+* instanced draws. Items batch when they share a mesh,
+* and in the color pass also an equivalent material
+* (the key only holds a hash of it, so compare fully),
+* in the Z-prepass a cull mode.
+*****************************************************/
+void RenderPipeline::BuildBatches(ERenderPass pass)
+{
+    RenderQueue& queue = render_queues[pass];
+    queue.instance_matrices.reserve(queue.items.size());
+    for (unsigned int i = 0; i < queue.items.size(); i++)
+    {
+        const DrawItem& item = queue.items[i];
+        MeshRenderer* mr = item.renderer;
+        // quantized positions are dequantized by the instance matrix
+        queue.instance_matrices.push_back(mr->mesh->layout.position16 ? mr->model_matrix * mr->mesh->vertex_transform : mr->model_matrix);
+        culling_stats[pass].triangles += mr->mesh->lods[item.lod].index_count / 3;
+
+        if (EditorSettings::UseInstancing && !queue.batches.empty())
+        {
+            const DrawItem& head_item = queue.items[queue.batches.back().first];
+            MeshRenderer* head = head_item.renderer;
+            bool same_mesh = head->mesh == mr->mesh && head_item.lod == item.lod;
+            if (same_mesh && SameDrawState(pass, head, mr))
+            {
+                queue.batches.back().count++;
+                continue;
+            }
+        }
+        queue.batches.push_back({ i, 1 });
+    }
+    BuildRuns(pass);
+}
+
+static bool UseMultiDrawIndirect()
+{
+    return EditorSettings::UseMultiDrawIndirect && IndirectDraw::GetInstance()->IsSupported();
+}
+
+/*****************************************************
+* Group batches into runs, each submitted with one API
+* call. With multi-draw indirect a run spans every
+* batch on the same arena page (and, in the color
+* pass, with an equivalent material), otherwise each
+* batch is a run of its own.
+*****************************************************/
+void RenderPipeline::BuildRuns(ERenderPass pass)
+{
+    RenderQueue& queue = render_queues[pass];
+    bool multi_draw = UseMultiDrawIndirect();
+    for (unsigned int i = 0; i < queue.batches.size(); i++)
+    {
+        MeshRenderer* mr = queue.items[queue.batches[i].first].renderer;
+        if (multi_draw && !queue.runs.empty())
+        {
+            MeshRenderer* head = queue.items[queue.batches[queue.runs.back().first_batch].first].renderer;
+            bool same_page = head->mesh->allocation.page == mr->mesh->allocation.page;
+            if (same_page && SameDrawState(pass, head, mr))
+            {
+                queue.runs.back().batch_count++;
+                continue;
+            }
+        }
+        queue.runs.push_back({ i, 1 });
+    }
+    culling_stats[pass].draw_calls += queue.runs.size();
+}
+
+// Upload the instance matrices of a pass, and one indirect command per batch when runs are multi-draws
+void RenderPipeline::UploadQueue(const RenderQueue& queue)
+{
+    InstanceBuffer::GetInstance()->Upload(queue.instance_matrices);
+    if (!UseMultiDrawIndirect())
+    {
+        return;
+    }
+    indirect_commands.clear();
+    for (const DrawBatch& batch : queue.batches)
+    {
+        const DrawItem& item = queue.items[batch.first];
+        indirect_commands.push_back(item.renderer->mesh->IndirectCommand(batch.first, batch.count, item.lod));
+    }
+    IndirectDraw::GetInstance()->Upload(indirect_commands);
+}
+
+// Draw a run with the current program and material state, depth_only binds the page's position-only VAO
+void RenderPipeline::SubmitRun(const RenderQueue& queue, const DrawRun& run, bool depth_only)
+{
+    const DrawBatch& batch = queue.batches[run.first_batch];
+    const DrawItem& item = queue.items[batch.first];
+    Mesh* mesh = item.renderer->mesh;
+    if (!UseMultiDrawIndirect())
+    {
+        mesh->Draw(batch.first, batch.count, item.lod, depth_only);
+        return;
+    }
+    MeshArena* arena = MeshArena::GetInstance();
+    int page = mesh->allocation.page;
+    GLState::GetInstance()->BindVertexArray(depth_only ? arena->GetDepthVertexArray(page) : arena->GetVertexArray(page));
+    // base_instance of each command picks its matrices, the attributes start at 0
+    InstanceBuffer::GetInstance()->BindRange(0);
+    IndirectDraw::GetInstance()->MultiDraw(run.first_batch, run.batch_count, arena->GetIndexType(page));
+}
+
+/*****************************************************
+* Choose each mesh renderer's level of detail for this
+* frame from its projected size: the camera passes
+* share one level (the Z-prepass must match the color
+* pass exactly), the shadow pass goes ShadowLodBias
+* levels coarser. A caster changing its shadow level
+* invalidates the cached shadow cascades.
+*****************************************************/
+void RenderPipeline::SelectLods()
+{
+    Camera* camera = window->render_camera;
+    // pixels covered by one world unit at distance 1
+    float pixel_scale = (float)window->Height() / (2.0f * std::tan(glm::radians(camera->Zoom) * 0.5f));
+    for (MeshRenderer& renderer : SceneStore::GetInstance()->renderers)
+    {
+        MeshRenderer* mr = &renderer;
+        if (mr->mesh == nullptr || !EditorSettings::UseLod)
+        {
+            mr->lod = 0;
+        }
+        else
+        {
+            const BoundingSphere& sphere = mr->world_sphere;
+            float scale = mr->mesh->bounding_sphere.radius > 0 ? sphere.radius / mr->mesh->bounding_sphere.radius : 1.0f;
+            float distance = std::max(glm::length(sphere.center - camera->Position) - sphere.radius, 0.1f);
+            mr->UpdateLod(pixel_scale * scale / distance, EditorSettings::LodErrorPixels);
+        }
+
+        int last = mr->mesh != nullptr ? (int)mr->mesh->lods.size() - 1 : 0;
+        int shadow_lod = std::min(mr->lod + std::max(EditorSettings::ShadowLodBias, 0), last);
+        if (mr->cast_shadow && shadow_lod != mr->shadow_lod)
+        {
+            shadow_version++;
+        }
+        mr->shadow_lod = shadow_lod;
+    }
+}
+
+/*****************************************************
+* Split the camera frustum up to shadow_distance into
+* cascades (practical split scheme: split_lambda blends
+* logarithmic and uniform splits) and fit an ortho box
+* around each slice's bounding sphere. The sphere keeps
+* the box size constant while the camera turns, and the
+* box is snapped to whole shadow map texels, so shadow
+* edges don't shimmer while the camera moves.
+* The box is pulled back toward the light to keep
+* casters outside the slice.
+*****************************************************/
+void RenderPipeline::UpdateShadowCascades(const glm::vec3& light_front)
+{
+    Camera* camera = window->render_camera;
+    float aspect = (float)window->Width() / (float)window->Height();
+    float near_plane = 0.1f;
+    float far_plane = std::max(shadow_map_setting.shadow_distance, near_plane + 1.0f);
+    float caster_margin = shadow_map_setting.shadow_distance;
+    float texels = shadow_map_setting.shadow_map_size;
+    int count = shadow_map_setting.cascade_count;
+    glm::mat4 camera_view = camera->GetViewMatrix();
+    glm::vec3 up = std::abs(light_front.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+    glm::mat4 light_rotation = glm::lookAt(glm::vec3(0), light_front, up);
+    glm::mat4 light_rotation_inv = glm::transpose(light_rotation);
+
+    float split_near = near_plane;
+    for (int i = 0; i < count; i++)
+    {
+        float t = (float)(i + 1) / (float)count;
+        float log_split = near_plane * std::pow(far_plane / near_plane, t);
+        float uniform_split = near_plane + (far_plane - near_plane) * t;
+        float split_far = glm::mix(uniform_split, log_split, shadow_map_setting.split_lambda);
+
+        // slice corners in world space
+        glm::mat4 slice_projection = glm::perspective(glm::radians(camera->Zoom), aspect, split_near, split_far);
+        glm::mat4 inv = glm::inverse(slice_projection * camera_view);
+        glm::vec3 corners[8];
+        glm::vec3 center(0);
+        for (int c = 0; c < 8; c++)
+        {
+            glm::vec4 p = inv * glm::vec4((c & 1) ? 1 : -1, (c & 2) ? 1 : -1, (c & 4) ? 1 : -1, 1);
+            corners[c] = glm::vec3(p) / p.w;
+            center += corners[c] / 8.0f;
+        }
+        float radius = 0;
+        for (int c = 0; c < 8; c++)
+        {
+            radius = std::max(radius, glm::length(corners[c] - center));
+        }
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        // snap the center to whole texels in light space, the box then moves in texel steps
+        // and its matrices stay bit-identical until it does, which the shadow cache relies on
+        float texel = 2.0f * radius / texels;
+        glm::vec3 light_center = glm::vec3(light_rotation * glm::vec4(center, 1));
+        light_center = glm::floor(light_center / texel) * texel;
+        center = glm::vec3(light_rotation_inv * glm::vec4(light_center, 1));
+
+        ShadowCascade& cascade = shadow_cascades[i];
+        cascade.eye = center - light_front * (radius + caster_margin);
+        cascade.depth_range = 2.0f * radius + caster_margin;
+        cascade.view = glm::lookAt(cascade.eye, center, up);
+        cascade.projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, cascade.depth_range);
+        cascade.split_far = split_far;
+
+        split_near = split_far;
+    }
+}
+
+/*****************************************************
+* Light matrices and light parameters are the same for
+* every pass, upload them once per frame.
+*****************************************************/
+void RenderPipeline::UpdateLightData()
+{
+    LightData data;
+
+    if (global_light != nullptr)
+    {
+        glm::vec3 front = global_light->transform.GetFront();
+        UpdateShadowCascades(front);
+
+        data.light_pos = global_light->transform.WorldPosition();
+        data.light_dir = -front;
+        data.light_color = global_light->GetLightColor();
+        data.light_intensity = global_light->GetLightIntensity();
+        data.point_light = (global_light->GetLightType() == LightType::POINT);
+    }
+    else
+    {
+        data.light_pos = glm::vec3(0);
+        data.light_dir = glm::vec3(1, 1, 1);
+        data.light_color = glm::vec3(1, 0, 0);
+        data.light_intensity = 1;
+        data.point_light = false;
+    }
+    data.skybox_enabled = EditorSettings::SkyboxEnabled;
+    data.cascade_count = shadow_map_setting.cascade_count;
+    for (int i = 0; i < shadow_map_setting.cascade_count; i++)
+    {
+        data.cascade_matrices[i] = shadow_cascades[i].projection * shadow_cascades[i].view;
+        data.cascade_splits[i] = shadow_cascades[i].split_far;
+    }
+    light_ubo->Upload(&data);
+}
+
+void RenderPipeline::UploadPassData(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& view_pos)
+{
+    PassData data;
+    data.view = view;
+    data.projection = projection;
+    data.view_pos = view_pos;
+    data._pad0 = 0;
+    pass_ubo->Upload(&data);
 }
 
 /*********************
 * Shadow Pass
 **********************/
+/*****************************************************
+* A cascade layer is only re-rendered when its light
+* matrix changed (the light turned, or the camera
+* moved the texel-snapped box) or shadow_version moved
+* on (a caster changed). In a static scene the whole
+* pass is skipped.
+*****************************************************/
 void RenderPipeline::ProcessShadowPass()
 {
-    GLfloat near_plane = 1.0f, far_plane = 10000.0f;
-    Transform* light_transform = global_light->atr_transform->transform;
-    glm::vec3 lightPos = light_transform->Position();
+    int size = shadow_map_setting.shadow_map_size;
+    if (shadow_map->width != size || shadow_map->layers != shadow_map_setting.cascade_count)
+    {
+        delete shadow_map;
+        shadow_map = new DepthTextureArray(size, size, shadow_map_setting.cascade_count);
+        shadow_version++;
+    }
+    // only directional light casts shadow now
+    bool light_casting = global_light->GetLightType() == LightType::DIRECTIONAL;
+    if (light_casting != shadow_light_casting)
+    {
+        shadow_light_casting = light_casting;
+        shadow_version++;
+    }
 
-    glViewport(0, 0, shadow_map_setting.shadow_map_size, shadow_map_setting.shadow_map_size);
-    shadow_map->BindFrameBuffer();
-    glEnable(GL_DEPTH_TEST);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    depth_shader->use();
-    
-    float sdm_size = shadow_map_setting.shadow_distance;
-    glm::mat4 light_projection = glm::ortho(-sdm_size, sdm_size, -sdm_size, sdm_size, near_plane, far_plane);
-    auto camera_pos = window->render_camera->Position;
-    glm::mat4 light_view = glm::lookAt(-light_transform->GetFront() * glm::vec3(50) + camera_pos, glm::vec3(0,0,0) + camera_pos, glm::vec3(0,1,0));
-
-    for (std::map<unsigned int, SceneModel *>::iterator it = ModelQueueForRender.begin(); it != ModelQueueForRender.end(); it++)
-    {
-        SceneModel *sm = it->second;
-        depth_shader->use();
-        Transform *transform = sm->atr_transform->transform;
-        glm::mat4 m = glm::mat4(1.0f);
-        m = transform->GetTransformMatrix();
-        depth_shader->setMat4("model", m);                      // M
-        depth_shader->setMat4("view", light_view);              // V    
-        depth_shader->setMat4("projection", light_projection);  // P
-
-        for (int i = 0; i < sm->meshRenderers.size(); i++)
+    RenderQueue& queue = render_queues[SHADOW_PASS];
+    queue.Clear();
+    shadow_cascades_rendered = 0;
+    for (int i = 0; i < shadow_map_setting.cascade_count; i++)
+    {
+        ShadowCascade& cascade = shadow_cascades[i];
+        glm::mat4 light_matrix = cascade.projection * cascade.view;
+        if (EditorSettings::CacheShadowMaps && cascade.cached_version == shadow_version && cascade.cached_matrix == light_matrix)
         {
-            if (sm->meshRenderers[i]->cast_shadow && global_light->light_type == LightType::DIRECTIONAL)
-            {
-                // Draw without any material
-                sm->meshRenderers[i]->PureDraw();
-            }
+            continue;
+        }
+        cascade.cached_version = shadow_version;
+        cascade.cached_matrix = light_matrix;
+
+        if (shadow_cascades_rendered++ == 0)
+        {
+            GLState::GetInstance()->Viewport(0, 0, size, size);
+            GLState::GetInstance()->Enable(GL_DEPTH_TEST);
+            depth_shader->use();
+        }
+        shadow_map->BindLayer(i);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        if (!light_casting)
+        {
+            continue;
+        }
+
+        // casters are culled against the cascade's ortho box
+        BuildRenderQueue(SHADOW_PASS, light_matrix, cascade.eye, global_light->transform.GetFront(), 0.0f, cascade.depth_range);
+
+        UploadPassData(cascade.view, cascade.projection, cascade.eye);
+        UploadQueue(queue);
+        for (const DrawRun& run : queue.runs)
+        {
+            // Draw without any material, from the position stream
+            SubmitRun(queue, run, true);
         }
     }
 }
@@ -175,7 +653,7 @@ void RenderPipeline::ProcessShadowPass()
 //    depth_cubemap_shader->setFloat("far_plane", far_plane);
 //    depth_cubemap_shader->setVec3("lightPos", lightPos);
 //
-//    for (std::map<unsigned int, SceneModel*>::iterator it = ModelQueueForRender.begin(); it != ModelQueueForRender.end(); it++)
+//    for (std::map<unsigned int, SceneModel*>::iterator it = RegisteredModels.begin(); it != RegisteredModels.end(); it++)
 //    {
 //        SceneModel* sm = it->second;
 //        depth_cubemap_shader->use();
@@ -194,150 +672,205 @@ void RenderPipeline::ProcessShadowPass()
 //    }
 //}
 
+/*****************************************************
+* The prepass only pays when the fragments it saves
+* cost more than drawing the geometry twice. Auto
+* turns it on when the visible bounds of the last
+* color pass covered the screen more than
+* ZPrePassOverdrawThreshold times. Wireframe never
+* uses it, filled depth would hide the back lines.
+*****************************************************/
+bool RenderPipeline::UseZPrePass()
+{
+    if (EditorSettings::UsePolygonMode)
+    {
+        return false;
+    }
+    switch (EditorSettings::ZPrePassMode)
+    {
+    case ZPREPASS_ON:   return true;
+    case ZPREPASS_AUTO: return estimated_overdraw >= EditorSettings::ZPrePassOverdrawThreshold;
+    default:            return false;
+    }
+}
+
+/*****************************************************
+* Draw the flagged occluders inside the view into the
+* software occlusion buffer, before any camera queue
+* is built. The buffer keeps the window's aspect.
+*****************************************************/
+void RenderPipeline::UpdateOcclusionRasterizer()
+{
+    if (!EditorSettings::UseSoftwareOcclusion)
+    {
+        return;
+    }
+    Camera* camera = window->render_camera;
+    glm::mat4 projection = glm::perspective(glm::radians(camera->Zoom), (float)window->Width() / (float)window->Height(), 0.1f, 10000.0f);
+    glm::mat4 view_projection = projection * camera->GetViewMatrix();
+    Frustum frustum(view_projection);
+
+    int width = OcclusionRasterizer::DEFAULT_WIDTH;
+    occlusion_rasterizer->Resize(width, width * window->Height() / window->Width());
+    occlusion_rasterizer->Begin(view_projection);
+    for (const MeshRenderer& mr : SceneStore::GetInstance()->renderers)
+    {
+        Mesh* mesh = mr.mesh;
+        if (!mr.occluder || mesh == nullptr || mesh->indices.empty() ||
+            mesh->indices.size() / 3 > OcclusionRasterizer::MAX_OCCLUDER_TRIANGLES ||
+            !frustum.Intersects(mr.world_bounds))
+        {
+            continue;
+        }
+        occlusion_rasterizer->AddOccluder(&mesh->vertices[0].Position, sizeof(Vertex), mesh->indices.data(), mesh->indices.size(), mr.model_matrix);
+    }
+    occlusion_rasterizer->Rasterize();
+}
+
+/*****************************************************
+* Reduce the opaque depth just drawn into the Hi-Z
+* buffer and adopt whichever earlier pyramid finished
+* reading back, for the next frame's culling. The
+* color target is bound again for what follows.
+* Wireframe depth is full of holes, so it is dropped.
+*****************************************************/
+void RenderPipeline::UpdateHiZBuffer()
+{
+    if (!EditorSettings::UseOcclusionCulling || EditorSettings::UsePolygonMode)
+    {
+        hiz_buffer->Invalidate();
+        return;
+    }
+
+    bool offscreen = EditorSettings::UsePostProcess && postprocess_manager != nullptr;
+    if (offscreen)
+    {
+        postprocess_manager->read_rt->SetAsReadTarget();
+    }
+    else
+    {
+        GLState::GetInstance()->BindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    }
+    Camera* camera = window->render_camera;
+    glm::mat4 projection = glm::perspective(glm::radians(camera->Zoom), (float)window->Width() / (float)window->Height(), 0.1f, 10000.0f);
+    glm::mat4 view_projection = projection * camera->GetViewMatrix();
+    hiz_buffer->Build(window->Width(), window->Height(), view_projection);
+    hiz_buffer->Update();
+
+    if (offscreen)
+    {
+        postprocess_manager->read_rt->BindFrameBuffer();
+    }
+    else
+    {
+        GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    GLState::GetInstance()->Viewport(0, 0, window->Width(), window->Height());
+}
+
 /*********************
 * Z-Pre Pass
+* Depth only, into the color pass target, which then
+* shades each pixel once with an equal depth test.
 **********************/
 void RenderPipeline::ProcessZPrePass()
 {
-    glViewport(0, 0, window->Width(), window->Height());
-    glEnable(GL_DEPTH_TEST);
-    depth_texture->BindFrameBuffer();
+    GLState::GetInstance()->Viewport(0, 0, window->Width(), window->Height());
+    GLState::GetInstance()->Enable(GL_DEPTH_TEST);
+    GLState::GetInstance()->DepthFunc(GL_LESS);
+    GLState::GetInstance()->DepthMask(true);
+    GLState::GetInstance()->ColorMask(false);
     glClear(GL_DEPTH_BUFFER_BIT);
     // view/projection transformations
     Camera* camera = window->render_camera;
     glm::mat4 projection = glm::perspective(glm::radians(camera->Zoom), (float)window->Width() / (float)window->Height(), 0.1f, 10000.0f);
     glm::mat4 view = camera->GetViewMatrix();
+    BuildRenderQueue(Z_PRE_PASS, projection * view, camera->Position, camera->Front, 0.1f, 10000.0f);
 
-    for (std::map<unsigned int, SceneModel *>::iterator it = ModelQueueForRender.begin(); it != ModelQueueForRender.end(); it++)
-    {
-        SceneModel *sm = it->second;
-        depth_shader->use();
-        Transform *transform = sm->atr_transform->transform;
-        glm::mat4 m = glm::mat4(1.0f);
-        m = transform->GetTransformMatrix();
-        depth_shader->setMat4("model", m);                // M
-        depth_shader->setMat4("view", view);              // V    
-        depth_shader->setMat4("projection", projection);  // P
-        
-        for (int i = 0; i < sm->meshRenderers.size(); i++)
-        {
-            // Draw without any material
-            sm->meshRenderers[i]->PureDraw();
-        }
+    UploadPassData(view, projection, camera->Position);
+    depth_shader->use();
+    RenderQueue& queue = render_queues[Z_PRE_PASS];
+    UploadQueue(queue);
+    for (const DrawRun& run : queue.runs)
+    {
+        // Draw without any material, from the position stream, culled as the color pass will
+        queue.items[queue.batches[run.first_batch].first].renderer->SetCullState();
+        SubmitRun(queue, run, true);
     }
-
-    depth_texture->SetAsReadTarget();
-    z_buffer->SetAsRenderTarget();
-    glBlitFramebuffer(0, 0, window->Width(), window->Height(), 0, 0, window->Width(), window->Height(), GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    GLState::GetInstance()->ColorMask(true);
 }
 
 /*********************
 * Color Pass
 **********************/
-void RenderPipeline::ProcessColorPass()
+void RenderPipeline::ProcessColorPass(bool depth_prepassed)
 {
     glClearColor(clear_color[0], clear_color[1], clear_color[2], 1);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_DEPTH_TEST);
+    GLState::GetInstance()->Enable(GL_DEPTH_TEST);
+    if (depth_prepassed)
+    {
+        // depth is final, only the nearest surface of each pixel passes
+        glClear(GL_COLOR_BUFFER_BIT);
+        GLState::GetInstance()->DepthFunc(GL_LEQUAL);
+        GLState::GetInstance()->DepthMask(false);
+    }
+    else
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
 
     if (EditorSettings::UsePolygonMode)
     {
         glLineWidth(0.05);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        GLState::GetInstance()->PolygonMode(GL_LINE);
     }
     else
     {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        GLState::GetInstance()->PolygonMode(GL_FILL);
     }
 
-    glViewport(0, 0, window->Width(), window->Height());
+    GLState::GetInstance()->Viewport(0, 0, window->Width(), window->Height());
     // view/projection transformations
     Camera* camera = window->render_camera;
     glm::mat4 projection = glm::perspective(glm::radians(camera->Zoom), (float)window->Width() / (float)window->Height(), 0.1f, 10000.0f);
     glm::mat4 view = camera->GetViewMatrix();
+    BuildRenderQueue(COLOR_PASS, projection * view, camera->Position, camera->Front, 0.1f, 10000.0f);
+    UploadPassData(view, projection, camera->Position);
 
-    GLfloat near_plane = 1.0f, far_plane = 10000.0f;
-    float sdm_size = shadow_map_setting.shadow_distance;
-    glm::mat4 light_projection = glm::ortho(-sdm_size, sdm_size, -sdm_size, sdm_size, near_plane, far_plane);
-    auto camera_pos = window->render_camera->Position;
-
-    Transform* light_transform = global_light->atr_transform->transform;
-    glm::vec3 lightPos = light_transform->Position();
-    glm::mat4 light_view;
-	bool pointLight = (global_light->light_type == LightType::POINT);
-    light_view = glm::lookAt(-light_transform->GetFront() * glm::vec3(50) + camera_pos, glm::vec3(0,0,0) + camera_pos, glm::vec3(0,1,0));
+    // Textures shared by every lit shader are bound once for the whole pass
+    GLState::GetInstance()->BindTexture(0, GL_TEXTURE_2D_ARRAY, shadow_map->color_buffer);
+    GLState::GetInstance()->BindTexture(13, GL_TEXTURE_CUBE_MAP, irradianceMap);
+    GLState::GetInstance()->BindTexture(14, GL_TEXTURE_CUBE_MAP, prefilterMap);
+    GLState::GetInstance()->BindTexture(15, GL_TEXTURE_2D, brdfLUTTexture);
   
     // Render Scene (Color Pass)
-    for (std::map<unsigned int, SceneModel *>::iterator it = ModelQueueForRender.begin(); it != ModelQueueForRender.end(); it++)
+    // Camera and light data come from the uniform buffers, only the
+    // sampler units are set when the program changes.
+    RenderQueue& queue = render_queues[COLOR_PASS];
+    UploadQueue(queue);
+    Shader* cur_shader = nullptr;
+    for (const DrawRun& run : queue.runs)
     {
-        SceneModel *sm = it->second;
-
-        Material* prev_mat = nullptr;
-        for (auto mr : sm->meshRenderers)
+        MeshRenderer* mr = queue.items[queue.batches[run.first_batch].first].renderer;
+        Shader* shader = GetColorShader(mr->material);
+        if (shader != cur_shader)
         {
-            Material* mat = mr->material;
-            if (mat == prev_mat)
-            {
-                continue;
-            }
-            prev_mat = mat;
-            Shader* shader;
-            if (EditorSettings::UsePolygonMode || !mat->shader->IsValid())
-            {
-                shader = Shader::LoadedShaders["default.fs"];
-            }
-            else
-            {
-                shader = mat->shader;
-            }
+            cur_shader = shader;
             shader->use();
-            // Render the loaded model
-            Transform *transform = sm->atr_transform->transform;
-            glm::mat4 m = glm::mat4(1.0f);
-            m = transform->GetTransformMatrix();
-            shader->setMat4("model", m);                // M
-            shader->setMat4("view", view);              // V    
-            shader->setMat4("projection", projection);  // P
-            shader->setVec3("viewPos", camera->Position);
-            shader->setMat4("light_view", light_view);
-            shader->setMat4("light_projection", light_projection);
-            shader->setInt("z_buffer", z_buffer->color_buffer);
-
-            glActiveTexture(GL_TEXTURE0);
-            glUniform1i(glGetUniformLocation(shader->ID, "shadowMap"), 0);
-            glBindTexture(GL_TEXTURE_2D, shadow_map->color_buffer);
-            glActiveTexture(GL_TEXTURE13);
+            shader->setInt("shadowMap", 0);
             shader->setInt("irradianceMap", 13);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-            glActiveTexture(GL_TEXTURE14);
             shader->setInt("prefilterMap", 14);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
-            glActiveTexture(GL_TEXTURE15);
             shader->setInt("brdfLUTTexture", 15);
-            glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-
-            shader->setBool("skybox_enabled", EditorSettings::SkyboxEnabled);
-
-            if (global_light != nullptr)
-            {
-                shader->setBool("pointLight", (global_light->light_type == LightType::POINT));
-                shader->setVec3("lightPos", lightPos);
-                glm::vec3 front = global_light->atr_transform->transform->GetFront();
-                shader->setVec3("lightDir", -front);
-                glm::vec3 lightColor = global_light->GetLightColor();
-                float lightIntensity = global_light->GetLightIntensity();
-                shader->setVec3("lightColor", lightColor);
-                shader->setFloat("lightIntensity",  lightIntensity);
-            }
-            else
-            {
-                shader->setVec3("lightDir", glm::vec3(1, 1, 1));
-                shader->setVec3("lightColor", glm::vec3(1, 0, 0));
-            }
         }
-        sm->DrawSceneModel();
+        // Render the loaded model, model matrices come from the instance buffer
+        if (mr->Setup())
+        {
+            SubmitRun(queue, run, false);
+        }
     }
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    GLState::GetInstance()->PolygonMode(GL_FILL);
+    GLState::GetInstance()->DepthFunc(GL_LESS);
+    GLState::GetInstance()->DepthMask(true);
 }
 
 //void RenderPipeline::ProcessPointColorPass()
@@ -374,7 +907,7 @@ void RenderPipeline::ProcessColorPass()
 //    light_view = glm::lookAt(-light_transform->GetFront() * glm::vec3(50) + camera_pos, glm::vec3(0, 0, 0) + camera_pos, glm::vec3(0, 1, 0));
 //
 //    // Render Scene (Color Pass)
-//    for (std::map<unsigned int, SceneModel*>::iterator it = ModelQueueForRender.begin(); it != ModelQueueForRender.end(); it++)
+//    for (std::map<unsigned int, SceneModel*>::iterator it = RegisteredModels.begin(); it != RegisteredModels.end(); it++)
 //    {
 //        SceneModel* sm = it->second;
 //
@@ -438,7 +971,7 @@ void RenderPipeline::ProcessColorPass()
 **********************/
 void RenderPipeline::RenderGizmos()
 {
-    glDisable(GL_DEPTH_TEST);
+    GLState::GetInstance()->Disable(GL_DEPTH_TEST);
     Camera* camera = window->render_camera;
     glm::mat4 model = glm::mat4(1.0f);
     glm::mat4 view = camera->GetViewMatrix();
@@ -450,20 +983,20 @@ void RenderPipeline::RenderGizmos()
 
     // Draw coordinate axis
     glLineWidth(4);
-    for (std::map<unsigned int, SceneModel *>::iterator it = ModelQueueForRender.begin(); it != ModelQueueForRender.end(); it++)
+    for (SceneModel *sm : registered_models)
     {
-        SceneModel *sm = it->second;
         if (sm->is_selected)
         {
             
-            Transform* transform = sm->atr_transform->transform; 
-            GLine front(transform->Position(), transform->Position() + transform->GetFront());
+            const EntityTransform& transform = sm->transform;
+            glm::vec3 origin = transform.WorldPosition();
+            GLine front(origin, origin + transform.GetFront());
             front.color = glm::vec3(0,0,1);
             front.DrawInGlobal();
-            GLine right(transform->Position(), transform->Position() + transform->GetRight());
+            GLine right(origin, origin + transform.GetRight());
             right.color = glm::vec3(1,0,0);
             right.DrawInGlobal();
-            GLine up(transform->Position(), transform->Position() + transform->GetUp());
+            GLine up(origin, origin + transform.GetUp());
             up.color = glm::vec3(0,1,0);
             up.DrawInGlobal();
         }
@@ -476,34 +1009,30 @@ void RenderPipeline::RenderGizmos()
         float r = 0.2;
         GCube light_cube(0.2);
         light_cube.color = global_light->GetLightColor();
-        light_cube.transform = *global_light->atr_transform->transform;
+        // the cube's own transform stays identity, placed by the light's world matrix
+        light_cube.transform.SetParentMatrix(global_light->transform.GetTransformMatrix(), global_light->transform.Version());
         light_cube.Draw();
 
-        if (global_light->light->light_type != global_light->light_type)
-        {
-            global_light->light_type = global_light->light->light_type;
-        }
-
-        if (global_light->light_type == LightType::DIRECTIONAL)
+        if (global_light->GetLightType() == LightType::DIRECTIONAL)
         {
             // GLine front(glm::vec3(0), glm::vec3(0,0,2));
-            GLine front(light_cube.transform.Position(), (light_cube.transform.Position() + glm::vec3(2) * light_cube.transform.GetFront()));
+            GLine front(light_cube.transform.WorldPosition(), (light_cube.transform.WorldPosition() + glm::vec3(2) * light_cube.transform.GetFront()));
             front.color = global_light->GetLightColor();
             front.DrawInGlobal();
         }
     }
 
     // Draw a grid
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GLState::GetInstance()->Enable(GL_DEPTH_TEST);
+    GLState::GetInstance()->Enable(GL_BLEND);
+    GLState::GetInstance()->BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     GGrid grid;
     Shader::LoadedShaders["grid.fs"]->use();
     Shader::LoadedShaders["grid.fs"]->setMat4("view", view);
     Shader::LoadedShaders["grid.fs"]->setMat4("projection", projection);
     Shader::LoadedShaders["grid.fs"]->setVec3("cameraPos", camera->Position);
     grid.Draw();
-    glDisable(GL_BLEND);
+    GLState::GetInstance()->Disable(GL_BLEND);
 }
 
 
@@ -512,7 +1041,7 @@ void RenderPipeline::RenderGizmos()
 **********************/
 void RenderPipeline::RenderSkybox()
 {
-    glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+    GLState::GetInstance()->DepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
     skybox_shader->use();
     skybox_shader->setInt("skybox", 0);
     Camera* camera = window->render_camera;
@@ -522,17 +1051,16 @@ void RenderPipeline::RenderSkybox()
     glm::mat4 projection = glm::perspective(glm::radians(camera->Zoom), (float)width / (float)height, 0.1f, 100.0f);
     skybox_shader->setMat4("view", view);
     skybox_shader->setMat4("projection", projection);
-    glBindVertexArray(skyboxVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
+    GLState::GetInstance()->BindVertexArray(skyboxVAO);
+    GLState::GetInstance()->BindTexture(0, GL_TEXTURE_CUBE_MAP, skyboxTexture);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-    glDepthFunc(GL_LESS);
+    GLState::GetInstance()->BindVertexArray(0);
+    GLState::GetInstance()->DepthFunc(GL_LESS);
 }
 
 void RenderPipeline::RenderHdrBackground()
 {
-    glDepthFunc(GL_LEQUAL);
+    GLState::GetInstance()->DepthFunc(GL_LEQUAL);
     Camera* camera = window->render_camera;
     glm::mat4 view = camera->GetViewMatrix();
     float width = window->cur_window_size.width;
@@ -542,21 +1070,32 @@ void RenderPipeline::RenderHdrBackground()
     hdr_background_shader->setMat4("view", view);
     hdr_background_shader->setMat4("projection", projection);
     hdr_background_shader->setInt("environmentMap", 0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    GLState::GetInstance()->BindTexture(0, GL_TEXTURE_CUBE_MAP, envCubemap);
 	renderCube();
-	glDepthFunc(GL_LESS);
+	GLState::GetInstance()->DepthFunc(GL_LESS);
 }
 
 
 /****************************************************************
-* Render order is decide by create order by now.
-* If there's a requirement to render model with alpha
-* we need to sort models by distance to camera. 
-* All models is rendered without alpha clip or alpha blend now.
+* Each pass builds its own draw list and sorts it by a 64-bit key,
+* see render_queue.h. Opaque draws are grouped by program and
+* material, then front to back. Models with alpha would need a
+* separate back-to-front queue, all models are opaque now.
 *****************************************************************/
 void RenderPipeline::Render()
 {
+    // Forget GL state changed outside the pipeline (ui, resource loading)
+    GLState::GetInstance()->BeginFrame();
+
+    // Bounds for culling
+    UpdateWorldBounds();
+
+    // Level of detail of every mesh renderer, for all passes
+    SelectLods();
+
+    // Frame constant light data
+    UpdateLightData();
+
     // Draw shadow pass
     //if (global_light->light_type == LightType::POINT)
     //{
@@ -568,8 +1107,8 @@ void RenderPipeline::Render()
     //}
     ProcessShadowPass();
 
-    // Z-PrePass
-    ProcessZPrePass();
+    // Occluders drawn on the CPU for this frame's camera passes
+    UpdateOcclusionRasterizer();
 
     // Pre Render Setting
     if (EditorSettings::UsePostProcess && !EditorSettings::UsePolygonMode && postprocess_manager != nullptr)
@@ -578,7 +1117,14 @@ void RenderPipeline::Render()
     }
     else
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // Z-PrePass, straight into the color target's depth buffer
+    z_prepass_active = UseZPrePass();
+    if (z_prepass_active)
+    {
+        ProcessZPrePass();
     }
 
     // Draw color pass
@@ -590,7 +1136,10 @@ void RenderPipeline::Render()
     //{
     //    ProcessColorPass();
     //}
-    ProcessColorPass();
+    ProcessColorPass(z_prepass_active);
+
+    // Depth pyramid for next frames' occlusion culling, before gizmos add to the depth
+    UpdateHiZBuffer();
 
     // Draw Gizmos
     if (EditorSettings::DrawGizmos)
@@ -673,7 +1222,7 @@ void RenderPipeline::InitSkyboxTex()
     };
 
     glGenTextures(1, &skyboxTexture);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
 
     int width, height, nrChannels;
     for (unsigned int i = 0; i < faces.size(); i++)
@@ -699,7 +1248,7 @@ void RenderPipeline::InitSkyboxTex()
     // skybox VAO
     glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
+    GLState::GetInstance()->BindVertexArray(skyboxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -713,7 +1262,7 @@ void RenderPipeline::InitHdrTex()
     glGenFramebuffers(1, &captureFBO);
     glGenRenderbuffers(1, &captureRBO);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
@@ -726,7 +1275,7 @@ void RenderPipeline::InitHdrTex()
     if (data)
     {
         glGenTextures(1, &hdrTexture);
-        glBindTexture(GL_TEXTURE_2D, hdrTexture);
+        GLState::GetInstance()->BindTexture(GL_TEXTURE_2D, hdrTexture);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data); // note how we specify the texture's data value to be float
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -744,7 +1293,7 @@ void RenderPipeline::InitHdrTex()
     // pbr: setup cubemap to render to and attach to framebuffer
     // ---------------------------------------------------------
     glGenTextures(1, &envCubemap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
     for (unsigned int i = 0; i < 6; ++i)
     {
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 512, 512, 0, GL_RGB, GL_FLOAT, nullptr);
@@ -760,11 +1309,10 @@ void RenderPipeline::InitHdrTex()
 	equirectangular2cubemap_shader->use();
 	equirectangular2cubemap_shader->setInt("equirectangularMap", 0);
 	equirectangular2cubemap_shader->setMat4("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, hdrTexture);
+    GLState::GetInstance()->BindTexture(0, GL_TEXTURE_2D, hdrTexture);
 
-    glViewport(0, 0, 512, 512); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    GLState::GetInstance()->Viewport(0, 0, 512, 512); // don't forget to configure the viewport to the capture dimensions.
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     for (unsigned int i = 0; i < 6; ++i)
     {
         equirectangular2cubemap_shader->setMat4("view", captureViews[i]);
@@ -774,7 +1322,7 @@ void RenderPipeline::InitHdrTex()
         // render cube
         renderCube();
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 
@@ -784,7 +1332,7 @@ void RenderPipeline::IrradianceConvolution()
     // pbr: create an irradiance cubemap, and re - scale capture FBO to irradiance scale.
     // --------------------------------------------------------------------------------
     glGenTextures(1, &irradianceMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
     for (unsigned int i = 0; i < 6; ++i)
     {
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0, GL_RGB, GL_FLOAT, nullptr);
@@ -795,7 +1343,7 @@ void RenderPipeline::IrradianceConvolution()
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
 
@@ -804,11 +1352,10 @@ void RenderPipeline::IrradianceConvolution()
     irradiance_convolution_shader->use();
     irradiance_convolution_shader->setInt("environmentMap", 0);
     irradiance_convolution_shader->setMat4("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    GLState::GetInstance()->BindTexture(0, GL_TEXTURE_CUBE_MAP, envCubemap);
 
-    glViewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    GLState::GetInstance()->Viewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     for (unsigned int i = 0; i < 6; ++i)
     {
         irradiance_convolution_shader->setMat4("view", captureViews[i]);
@@ -817,13 +1364,13 @@ void RenderPipeline::IrradianceConvolution()
 
         renderCube();
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void RenderPipeline::PrefilterSpecularIBL()
 {
     glGenTextures(1, &prefilterMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
     for (unsigned int i = 0; i < 6; ++i)
     {
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 128, 128, 0, GL_RGB, GL_FLOAT, nullptr);
@@ -841,10 +1388,9 @@ void RenderPipeline::PrefilterSpecularIBL()
     prefilter_shader->use();
     prefilter_shader->setInt("environmentMap", 0);
     prefilter_shader->setMat4("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    GLState::GetInstance()->BindTexture(0, GL_TEXTURE_CUBE_MAP, envCubemap);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     unsigned int maxMipLevels = 5;
     for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
     {
@@ -853,7 +1399,7 @@ void RenderPipeline::PrefilterSpecularIBL()
         unsigned int mipHeight = static_cast<unsigned int>(128 * std::pow(0.5, mip));
         glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
         glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
-        glViewport(0, 0, mipWidth, mipHeight);
+        GLState::GetInstance()->Viewport(0, 0, mipWidth, mipHeight);
 
         float roughness = (float)mip / (float)(maxMipLevels - 1);
         prefilter_shader->setFloat("roughness", roughness);
@@ -866,14 +1412,14 @@ void RenderPipeline::PrefilterSpecularIBL()
             renderCube();
         }
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // pbr: generate a 2D LUT from the BRDF equations used.
     // ----------------------------------------------------
     glGenTextures(1, &brdfLUTTexture);
 
     // pre-allocate enough memory for the LUT texture.
-    glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_2D, brdfLUTTexture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, 512, 512, 0, GL_RG, GL_FLOAT, 0);
     // be sure to set wrapping mode to GL_CLAMP_TO_EDGE
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -882,17 +1428,17 @@ void RenderPipeline::PrefilterSpecularIBL()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     // then re-configure capture framebuffer object and render screen-space quad with BRDF shader.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture, 0);
 
-    glViewport(0, 0, 512, 512);
+    GLState::GetInstance()->Viewport(0, 0, 512, 512);
     brdf_shader->use();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     renderQuad();
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 
@@ -953,7 +1499,7 @@ void renderCube()
         glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
         // link vertex attributes
-        glBindVertexArray(cubeVAO);
+        GLState::GetInstance()->BindVertexArray(cubeVAO);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(1);
@@ -961,12 +1507,12 @@ void renderCube()
         glEnableVertexAttribArray(2);
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        GLState::GetInstance()->BindVertexArray(0);
     }
     // render Cube
-    glBindVertexArray(cubeVAO);
+    GLState::GetInstance()->BindVertexArray(cubeVAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
+    GLState::GetInstance()->BindVertexArray(0);
 }
 
 void renderQuad()
@@ -983,7 +1529,7 @@ void renderQuad()
         // setup plane VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
+        GLState::GetInstance()->BindVertexArray(quadVAO);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -991,7 +1537,7 @@ void renderQuad()
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     }
-    glBindVertexArray(quadVAO);
+    GLState::GetInstance()->BindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
+    GLState::GetInstance()->BindVertexArray(0);
 }
\ No newline at end of file
@@ -4,42 +4,85 @@
 #include <stb_image.h>
 
 #include "renderer_window.h"
+#include "bounds.h"
+#include "render_queue.h"
+#include "indirect_draw.h"
+#include "uniform_buffer.h"
+#include "slot_map.h"
 
 class SceneModel;
+class MeshRenderer;
 class SceneLight;
 class Camera;
 class Shader;
-class DepthTexture;
+class DepthTextureArray;
 class DepthCubeTexture;
 class RendererWindow;
 class PostProcessManager;
+class HiZBuffer;
+class OcclusionRasterizer;
+
+enum ERenderPass
+{
+    SHADOW_PASS = 0,
+    Z_PRE_PASS,
+    COLOR_PASS,
+    RENDER_PASS_COUNT
+};
+
+// what BuildRenderQueue made of a model as a whole
+enum EModelVerdict
+{
+    MODEL_CULLED = 0,
+    MODEL_OCCLUDED,
+    MODEL_VISIBLE
+};
+
+// mesh renderers that survived/failed culling in a pass and the
+// instanced draws they were merged into, reset every frame
+struct CullingStats
+{
+    unsigned int visible = 0;
+    unsigned int culled = 0;
+    unsigned int occluded = 0;  // inside the frustum but behind the Hi-Z depth
+    unsigned int draw_calls = 0;
+    unsigned int triangles = 0;
+};
 
 class RenderPipeline : public IOnWindowSizeChanged
 {
 public:
 	RenderPipeline(RendererWindow* _window);
     ~RenderPipeline();
-	void EnqueueRenderQueue(SceneModel* model);
-	//void RemoveFromRenderQueue(SceneModel* model);
-	void RemoveFromRenderQueue(unsigned int id);
-	SceneModel* GetRenderModel(unsigned int id);
+	// the handle goes in SceneModel::render_entry
+	Handle EnqueueRenderQueue(SceneModel* model);
+	// a stale handle is ignored
+	void RemoveFromRenderQueue(Handle entry);
+	// nullptr for a stale handle
+	SceneModel* GetRenderModel(Handle entry);
 	void Render();
 	void OnWindowSizeChanged(int width, int height) override;
 
     struct ShadowMapSetting
     {
-        float shadow_map_size = 4096;
-        float shadow_distance = 50;
+        float shadow_map_size = 1024;   // per cascade
+        float shadow_distance = 100;    // view depth covered by the cascades
+        int   cascade_count = 4;        // 1 to MAX_SHADOW_CASCADES
+        float split_lambda = 0.75f;     // 0 uniform splits, 1 logarithmic splits
 	} shadow_map_setting;
 
     float *clear_color;
     SceneLight* global_light;
+    CullingStats culling_stats[RENDER_PASS_COUNT];
+    int shadow_cascades_rendered = 0;   // cascades re-rendered this frame, the others were cached
+    bool z_prepass_active = false;      // whether this frame ran the Z-prepass
+    float estimated_overdraw = 0;       // summed screen coverage of the visible color pass bounds
     PostProcessManager *postprocess_manager = nullptr;
 
-    DepthTexture* depth_texture;
-    DepthTexture* z_buffer;
-    DepthTexture* shadow_map;
+    DepthTextureArray* shadow_map;  // one layer per cascade
     //DepthCubeTexture* shadow_cubemap;
+    HiZBuffer* hiz_buffer;          // depth pyramid of the previous frames for occlusion culling
+    OcclusionRasterizer* occlusion_rasterizer;  // occluder depth of this frame, drawn on the CPU
 
 	unsigned int skyboxTexture;
     unsigned int skyboxVAO, skyboxVBO;
@@ -50,7 +93,28 @@ public:
     unsigned int brdfLUTTexture;
 
 private:
-    std::map<unsigned int, SceneModel *> ModelQueueForRender;
+    SlotMap<SceneModel *> registered_models;                // lookup only, draw order comes from render_queues
+    RenderQueue render_queues[RENDER_PASS_COUNT];           // rebuilt and sorted every frame
+    std::vector<unsigned char> model_visible;               // scratch for BuildRenderQueue, EModelVerdict by SceneStore entity index
+    std::vector<MeshRenderer*> queued_renderers;            // and the renderers it keeps
+    std::vector<AABB> queued_bounds;                        // with their world bounds
+    std::vector<float> queued_depths;                       // and view depths
+    UniformBuffer* pass_ubo;    // camera data, re-uploaded for each pass
+    UniformBuffer* light_ubo;   // light data, uploaded once per frame
+    // light space of one cascade, fitted to a slice of the camera frustum
+    struct ShadowCascade
+    {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec3 eye;
+        float     depth_range;      // far plane of the ortho projection
+        float     split_far;        // camera view depth where the cascade ends
+        glm::mat4 cached_matrix;    // projection * view the layer was last rendered with
+        unsigned int cached_version = 0xFFFFFFFF;
+    } shadow_cascades[MAX_SHADOW_CASCADES];
+    unsigned int shadow_version = 0;    // bumped whenever a shadow caster or the light changes
+    bool shadow_light_casting = false;  // whether the light cast shadows in the last shadow pass
+    std::vector<DrawElementsIndirectCommand> indirect_commands;  // scratch for UploadQueue
     RendererWindow *window;
     // Shaders
     Shader* depth_shader;   // for shadow map
@@ -64,10 +128,25 @@ private:
     Shader* brdf_shader; // for brdf convolution  Split-Sum Part.2
 
 
+    void UpdateWorldBounds      ();
+    void SelectLods             ();
+    void UpdateLightData        ();
+    void UpdateShadowCascades   (const glm::vec3& light_front);
+    void UploadPassData         (const glm::mat4& view, const glm::mat4& projection, const glm::vec3& view_pos);
+    bool IsOccluded             (const AABB& bounds);
+    bool IsVisible              (MeshRenderer* mr, const Frustum& frustum, bool occlusion, CullingStats& stats);
+    void BuildRenderQueue       (ERenderPass pass, const glm::mat4& view_projection, const glm::vec3& eye, const glm::vec3& forward, float near_plane, float far_plane);
+    void BuildBatches           (ERenderPass pass);
+    void BuildRuns              (ERenderPass pass);
+    void UploadQueue            (const RenderQueue& queue);
+    void SubmitRun              (const RenderQueue& queue, const DrawRun& run, bool depth_only);
+    bool UseZPrePass            ();
     void ProcessZPrePass        ();
     void ProcessShadowPass      ();
     //void ProcessPointShadowPass ();
-    void ProcessColorPass       ();
+    void ProcessColorPass       (bool depth_prepassed);
+    void UpdateHiZBuffer        ();
+    void UpdateOcclusionRasterizer();
     //void ProcessPointColorPass  ();
     void RenderGizmos           ();
     void RenderSkybox           ();
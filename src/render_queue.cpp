@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <cstring>
+
+#include "render_queue.h"
+
+static uint64_t QuantizeDepth(float depth01, int bits)
+{
+    uint64_t max = (1ull << bits) - 1;
+    depth01 = std::min(std::max(depth01, 0.0f), 1.0f);
+    return (uint64_t)(depth01 * (float)max) & max;
+}
+
+uint64_t RenderQueue::MakeColorKey(unsigned int pass, unsigned int program, unsigned int material, unsigned int mesh, unsigned int lod, float depth01)
+{
+    return  ((uint64_t)(pass     & 0x3)    << 62) |
+            ((uint64_t)(program  & 0x3FF)  << 52) |
+            ((uint64_t)(material & 0xFFFF) << 36) |
+            ((uint64_t)(mesh     & 0xFFF)  << 24) |
+            ((uint64_t)(lod      & 0x7)    << 21) |
+            QuantizeDepth(depth01, 21);
+}
+
+uint64_t RenderQueue::MakeDepthKey(unsigned int pass, unsigned int cull, unsigned int mesh, unsigned int lod, float depth01)
+{
+    return  ((uint64_t)(pass & 0x3)   << 62) |
+            ((uint64_t)(cull & 0x3)   << 60) |
+            ((uint64_t)(mesh & 0xFFF) << 48) |
+            ((uint64_t)(lod  & 0x7)   << 45) |
+            (QuantizeDepth(depth01, 24) << 21);
+}
+
+/*****************************************************
+* LSD radix sort on the 64-bit key, 8 bits per pass.
+* All 8 histograms are built in one sweep, and a byte
+* shared by every key (e.g. the unused low bits of a
+* depth key) is skipped, so a frame usually needs far
+* fewer than 8 scatter passes. Stable, O(n).
+*****************************************************/
+void RenderQueue::Sort()
+{
+    const size_t count = items.size();
+    if (count < 2)
+    {
+        return;
+    }
+
+    size_t histogram[8][256];
+    memset(histogram, 0, sizeof(histogram));
+    for (const DrawItem& item : items)
+    {
+        for (int b = 0; b < 8; b++)
+        {
+            histogram[b][(item.key >> (b * 8)) & 0xFF]++;
+        }
+    }
+
+    scratch.resize(count);
+    std::vector<DrawItem>* src = &items;
+    std::vector<DrawItem>* dst = &scratch;
+    for (int b = 0; b < 8; b++)
+    {
+        size_t* h = histogram[b];
+        if (h[(items[0].key >> (b * 8)) & 0xFF] == count)
+        {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (int i = 0; i < 256; i++)
+        {
+            size_t c = h[i];
+            h[i] = offset;
+            offset += c;
+        }
+        for (const DrawItem& item : *src)
+        {
+            (*dst)[h[(item.key >> (b * 8)) & 0xFF]++] = item;
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != &items)
+    {
+        items.swap(scratch);
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+class MeshRenderer;
+
+/*****************************************************
+* One draw of a mesh renderer in a pass. The key packs
+* every state the pass cares about, most significant
+* first, so sorting the keys groups draws by state:
+*
+*   color pass : pass(2) program(10) material(16) mesh(12) lod(3) depth(21)
+*   depth pass : pass(2) cull(2) mesh(12) lod(3) depth(24)
+*
+* Depth is the quantized view depth of the bounds
+* center, smaller is nearer, giving front-to-back order
+* within each state group. Material is the material's
+* BatchKey, cull the material's E_CULL_FACE in the
+* Z-prepass (0 in the shadow pass), which has to match
+* the color pass, and mesh is Mesh::SortKey, so identical
+* materials and copies of a mesh end up adjacent, and
+* copies drawing the same level of detail next to each
+* other.
+*****************************************************/
+struct DrawItem
+{
+    uint64_t        key;
+    MeshRenderer*   renderer;
+    int             lod;        // level of the mesh this pass draws
+};
+
+// a run of sorted items drawn with one instanced call,
+// instance i of the batch is item first + i
+struct DrawBatch
+{
+    unsigned int    first;
+    unsigned int    count;
+};
+
+// consecutive batches sharing VAO and draw state, one glMultiDrawElementsIndirect
+struct DrawRun
+{
+    unsigned int    first_batch;
+    unsigned int    batch_count;
+};
+
+class RenderQueue
+{
+public:
+    static uint64_t MakeColorKey(unsigned int pass, unsigned int program, unsigned int material, unsigned int mesh, unsigned int lod, float depth01);
+    static uint64_t MakeDepthKey(unsigned int pass, unsigned int cull, unsigned int mesh, unsigned int lod, float depth01);
+
+    void Clear()                                        { items.clear(); batches.clear(); runs.clear(); instance_matrices.clear(); }
+    void Push(uint64_t key, MeshRenderer* renderer, int lod)    { items.push_back({ key, renderer, lod }); }
+    bool Empty() const                                  { return items.empty();             }
+    void Sort();
+
+    std::vector<DrawItem>   items;
+    std::vector<DrawBatch>  batches;            // filled after Sort
+    std::vector<DrawRun>    runs;               // filled after batches when multi-draw indirect is used
+    std::vector<glm::mat4>  instance_matrices;  // model matrix of each item, in item order
+
+private:
+    std::vector<DrawItem> scratch;
+};
@@ -4,29 +4,30 @@
 
 #include "render_texture.h"
 #include "renderer_console.h"
+#include "gl_state.h"
 
 FrameBufferTexture::FrameBufferTexture(int _width, int _height) : width(_width), height(_height) {}
 FrameBufferTexture::~FrameBufferTexture() {}
 
 void FrameBufferTexture::SetAsRenderTarget()
 {
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    GLState::GetInstance()->BindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
 }
 
 void FrameBufferTexture::SetAsReadTarget()
 {
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    GLState::GetInstance()->BindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
 }
 
 void FrameBufferTexture::BindFrameBuffer()
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 }
 
 RenderTexture::RenderTexture(int _width, int _height) : FrameBufferTexture(_width, _height)
 {
     glGenTextures(1, &color_buffer);
-    glBindTexture(GL_TEXTURE_2D, color_buffer);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_2D, color_buffer);
     // HDR
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, _width, _height, 0, GL_RGB, GL_FLOAT, NULL);
     // LDR
@@ -35,7 +36,7 @@ RenderTexture::RenderTexture(int _width, int _height) : FrameBufferTexture(_widt
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_2D, 0);
 
     CreateFrameBuffer(_width, _height);
     RendererConsole::GetInstance()->AddLog("Create Render Texture: %dx%d", _width, _height); 
@@ -44,9 +45,9 @@ RenderTexture::RenderTexture(int _width, int _height) : FrameBufferTexture(_widt
 RenderTexture::~RenderTexture()
 {   
     RendererConsole::GetInstance()->AddLog("Delete RenderTexture"); 
-    glDeleteTextures(1, &color_buffer);
+    GLState::GetInstance()->DeleteTexture(color_buffer);
     glDeleteRenderbuffers(1, &renderbuffer);
-    glDeleteFramebuffers(1, &framebuffer);
+    GLState::GetInstance()->DeleteFramebuffer(framebuffer);
 }
 
 /*******************************************************************
@@ -56,7 +57,7 @@ void RenderTexture::CreateFrameBuffer(int _width, int _height)
 {
     // Create frame buffer
     glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 
     // Bind color attatchment
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_buffer, 0);
@@ -70,20 +71,20 @@ void RenderTexture::CreateFrameBuffer(int _width, int _height)
 
     if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         RendererConsole::GetInstance()->AddError("[error] FRAMEBUFFER: Framebuffer is not complete!"); 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 BloomRenderBuffer::BloomRenderBuffer(int _width, int _height) : RenderTexture(_width, _height)
 {
     glGenTextures(1, &bright_buffer);
-    glBindTexture(GL_TEXTURE_2D, bright_buffer);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_2D, bright_buffer);
     // HDR
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, _width, _height, 0, GL_RGB, GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_2D, 0);
 
     CreateFrameBuffer(_width, _height);
     RendererConsole::GetInstance()->AddLog("Create Bloom Buffer: %dx%d", _width, _height); 
@@ -96,7 +97,7 @@ void BloomRenderBuffer::CreateFrameBuffer(int _width, int _height)
 {
     // Create frame buffer
     glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 
     // Bind color attatchment
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_buffer, 0);
@@ -114,22 +115,22 @@ void BloomRenderBuffer::CreateFrameBuffer(int _width, int _height)
 
     if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         RendererConsole::GetInstance()->AddError("[error] FRAMEBUFFER: Framebuffer is not complete!"); 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 BloomRenderBuffer::~BloomRenderBuffer()
 {
     RendererConsole::GetInstance()->AddLog("Delete RenderTexture"); 
-    glDeleteTextures(1, &color_buffer);
-    glDeleteTextures(1, &bright_buffer);
+    GLState::GetInstance()->DeleteTexture(color_buffer);
+    GLState::GetInstance()->DeleteTexture(bright_buffer);
     glDeleteRenderbuffers(1, &renderbuffer);
-    glDeleteFramebuffers(1, &framebuffer);
+    GLState::GetInstance()->DeleteFramebuffer(framebuffer);
 }
 
 DepthTexture::DepthTexture(int _width, int _height) : FrameBufferTexture(_width, _height)
 {
     glGenTextures(1, &color_buffer);
-    glBindTexture(GL_TEXTURE_2D, color_buffer);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_2D, color_buffer);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, _width, _height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -137,7 +138,7 @@ DepthTexture::DepthTexture(int _width, int _height) : FrameBufferTexture(_width,
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
     GLfloat borderColor[] = { 1.0, 1.0, 1.0, 1.0 };
     glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_2D, 0);
 
     CreateFrameBuffer(_width, _height);
     RendererConsole::GetInstance()->AddLog("Create Depth Texture: %dx%d", _width, _height); 
@@ -146,8 +147,8 @@ DepthTexture::DepthTexture(int _width, int _height) : FrameBufferTexture(_width,
 DepthTexture::~DepthTexture()
 {   
     RendererConsole::GetInstance()->AddLog("Delete Depth Texture"); 
-    glDeleteTextures(1, &color_buffer);
-    glDeleteFramebuffers(1, &framebuffer);
+    GLState::GetInstance()->DeleteTexture(color_buffer);
+    GLState::GetInstance()->DeleteFramebuffer(framebuffer);
 }
 
 /*******************************************************************
@@ -157,13 +158,57 @@ void DepthTexture::CreateFrameBuffer(int _width, int _height)
 {
     // Create frame buffer
     glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 
     // Bind depth attatchment
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, color_buffer, 0);
     glDrawBuffer(GL_NONE);
     glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+DepthTextureArray::DepthTextureArray(int _width, int _height, int _layers) : FrameBufferTexture(_width, _height), layers(_layers)
+{
+    glGenTextures(1, &color_buffer);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_2D_ARRAY, color_buffer);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, _width, _height, _layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    GLfloat borderColor[] = { 1.0, 1.0, 1.0, 1.0 };
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    CreateFrameBuffer(_width, _height);
+    RendererConsole::GetInstance()->AddLog("Create Depth Texture Array: %dx%dx%d", _width, _height, _layers);
+}
+
+DepthTextureArray::~DepthTextureArray()
+{
+    RendererConsole::GetInstance()->AddLog("Delete Depth Texture Array");
+    GLState::GetInstance()->DeleteTexture(color_buffer);
+    GLState::GetInstance()->DeleteFramebuffer(framebuffer);
+}
+
+/*******************************************************************
+* Bind the frame buffer with one layer as its depth attachment.
+********************************************************************/
+void DepthTextureArray::BindLayer(int layer)
+{
+    BindFrameBuffer();
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, color_buffer, 0, layer);
+}
+
+void DepthTextureArray::CreateFrameBuffer(int _width, int _height)
+{
+    // Create frame buffer, the depth layer is attached by BindLayer
+    glGenFramebuffers(1, &framebuffer);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, color_buffer, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 DepthCubeTexture::DepthCubeTexture(int _width, int _height)
@@ -171,7 +216,7 @@ DepthCubeTexture::DepthCubeTexture(int _width, int _height)
 {
     glGenTextures(1, &color_buffer);
     //const unsigned int width, height;
-    glBindTexture(GL_TEXTURE_CUBE_MAP, color_buffer);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_CUBE_MAP, color_buffer);
     for (unsigned int i = 0; i < 6; ++i)
     {
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, _width, _height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
@@ -189,19 +234,19 @@ DepthCubeTexture::DepthCubeTexture(int _width, int _height)
 DepthCubeTexture::~DepthCubeTexture()
 {
     RendererConsole::GetInstance()->AddLog("Delete Depth Cubemap Texture");
-    glDeleteTextures(1, &color_buffer);
-    glDeleteFramebuffers(1, &framebuffer);
+    GLState::GetInstance()->DeleteTexture(color_buffer);
+    GLState::GetInstance()->DeleteFramebuffer(framebuffer);
 }
 
 void DepthCubeTexture::CreateFrameBuffer(int _width, int _height)
 {
     // Create frame buffer
     glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 
     // Bind cubemap depth attatchment
     glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, color_buffer, 0);
     glDrawBuffer(GL_NONE);
     glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::GetInstance()->BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
@@ -53,6 +53,20 @@ private:
     void CreateFrameBuffer(int _width, int _height) override;
 };
 
+// One depth layer per shadow cascade, rendered a layer at a time
+class DepthTextureArray : public FrameBufferTexture
+{
+public:
+    int             layers;
+
+    DepthTextureArray(int _width, int _height, int _layers);
+    ~DepthTextureArray();
+    void BindLayer(int layer);
+
+private:
+    void CreateFrameBuffer(int _width, int _height) override;
+};
+
 class DepthCubeTexture : public FrameBufferTexture
 {
 public:
@@ -7,6 +7,13 @@
 #include "scene.h"
 #include "scene_object.h"
 #include "editor_settings.h"
+#include "gl_state.h"
+#include "mesh_arena.h"
+#include "indirect_draw.h"
+#include "hiz_buffer.h"
+#include "occlusion_rasterizer.h"
+#include "transform_kernels.h"
+#include "scene_store.h"
 
 const char *glsl_version = "#version 150";
 renderer_ui::renderer_ui()
@@ -428,6 +435,105 @@ void renderer_ui::mainUI(RendererWindow *window, Scene* scene)
             ImGui::Checkbox("Enable Skybox", &EditorSettings::SkyboxEnabled);
             ImGui::SetNextItemWidth(150);
             ImGui::DragFloat("shadow distance", &scene->render_pipeline.shadow_map_setting.shadow_distance);
+            ImGui::SetNextItemWidth(150);
+            ImGui::SliderInt("shadow cascades", &scene->render_pipeline.shadow_map_setting.cascade_count, 1, MAX_SHADOW_CASCADES);
+            ImGui::SetNextItemWidth(150);
+            ImGui::SliderFloat("cascade split lambda", &scene->render_pipeline.shadow_map_setting.split_lambda, 0.0f, 1.0f);
+            ImGui::Checkbox("Cache Shadow Maps", &EditorSettings::CacheShadowMaps);
+            ImGui::SameLine();
+            ImGui::Text("%d / %d cascades redrawn", scene->render_pipeline.shadow_cascades_rendered, scene->render_pipeline.shadow_map_setting.cascade_count);
+            ImGui::SetNextItemWidth(150);
+            ImGui::Combo("Z-PrePass", &EditorSettings::ZPrePassMode, "Off\0On\0Auto\0");
+            if (EditorSettings::ZPrePassMode == ZPREPASS_AUTO)
+            {
+                ImGui::SetNextItemWidth(150);
+                ImGui::DragFloat("overdraw threshold", &EditorSettings::ZPrePassOverdrawThreshold, 0.05f, 0.0f, 16.0f);
+            }
+            ImGui::Text("overdraw %.2f, prepass %s", scene->render_pipeline.estimated_overdraw, scene->render_pipeline.z_prepass_active ? "on" : "off");
+            ImGui::Checkbox("Frustum Culling", &EditorSettings::UseFrustumCulling);
+            ImGui::Checkbox("Occlusion Culling (Hi-Z)", &EditorSettings::UseOcclusionCulling);
+            if (EditorSettings::UseOcclusionCulling)
+            {
+                HiZBuffer* hiz = scene->render_pipeline.hiz_buffer;
+                ImGui::SameLine();
+                if (hiz->IsReady())
+                    ImGui::Text("%dx%d, %d levels", hiz->Width(), hiz->Height(), hiz->LevelCount());
+                else
+                    ImGui::TextDisabled("waiting for depth");
+            }
+            ImGui::Checkbox("Software Occlusion", &EditorSettings::UseSoftwareOcclusion);
+            if (EditorSettings::UseSoftwareOcclusion)
+            {
+                OcclusionRasterizer* rasterizer = scene->render_pipeline.occlusion_rasterizer;
+                const CullingStats& color = scene->render_pipeline.culling_stats[COLOR_PASS];
+                unsigned int tested = color.visible + color.occluded;
+                ImGui::Text("%u occluder tris in %.3f ms (%.0f tris/ms), %.1f%% occluded", rasterizer->triangle_count, rasterizer->raster_ms,
+                    rasterizer->raster_ms > 0 ? rasterizer->triangle_count / rasterizer->raster_ms : 0.0f,
+                    tested > 0 ? 100.0f * color.occluded / tested : 0.0f);
+                if (ImGui::Button("Benchmark Occlusion Rasterizer"))
+                {
+                    OcclusionRasterizer::Benchmark();
+                }
+                ImGui::SameLine();
+                ImGui::TextDisabled("results in the console");
+            }
+            ImGui::Checkbox("Level of Detail", &EditorSettings::UseLod);
+            if (EditorSettings::UseLod)
+            {
+                ImGui::SetNextItemWidth(150);
+                ImGui::DragFloat("lod error (px)", &EditorSettings::LodErrorPixels, 0.05f, 0.1f, 32.0f);
+                ImGui::SetNextItemWidth(150);
+                ImGui::SliderInt("shadow lod bias", &EditorSettings::ShadowLodBias, 0, MAX_MESH_LODS - 1);
+            }
+            ImGui::Checkbox("16-bit Positions (new imports)", &EditorSettings::QuantizePositions);
+            ImGui::Checkbox("Mesh Cache", &EditorSettings::UseMeshCache);
+            ImGui::Checkbox("Instancing", &EditorSettings::UseInstancing);
+            if (IndirectDraw::GetInstance()->IsSupported())
+            {
+                ImGui::Checkbox("Multi-Draw Indirect", &EditorSettings::UseMultiDrawIndirect);
+            }
+            else
+            {
+                ImGui::TextDisabled("Multi-Draw Indirect (unsupported)");
+            }
+            const char* pass_names[RENDER_PASS_COUNT] = { "shadow", "z-prepass", "color" };
+            for (int i = 0; i < RENDER_PASS_COUNT; i++)
+            {
+                const CullingStats& stats = scene->render_pipeline.culling_stats[i];
+                ImGui::Text("%s: %u visible / %u culled / %u occluded, %u draws, %u tris", pass_names[i], stats.visible, stats.culled, stats.occluded, stats.draw_calls, stats.triangles);
+            }
+            ImGui::Text("gl state: %u issued / %u filtered", GLState::GetInstance()->last_issued, GLState::GetInstance()->last_filtered);
+            MeshArena* arena = MeshArena::GetInstance();
+            ImGui::Text("mesh arena: %u pages (%u 16-bit), %u vertices, %u indices", arena->PageCount(), arena->ShortIndexPageCount(), arena->UsedVertices(), arena->UsedIndices());
+            ImGui::Text("vertex memory: %.2f MB packed, %.2f MB as Vertex", arena->UsedVertexBytes() / 1048576.0f, (float)arena->UsedVertices() * sizeof(Vertex) / 1048576.0f);
+            SceneBvh& bvh = scene->scene_bvh;
+            ImGui::Text("scene bvh: %u objects (%u pending), %u nodes, cost %.1f / %.1f built", bvh.ObjectCount(), bvh.PendingCount(), bvh.NodeCount(), bvh.cost, bvh.built_cost);
+            ImGui::Text("%u rebuilds, last %.2f ms%s, pick %.3f ms", bvh.rebuild_count, bvh.build_ms, bvh.IsRebuilding() ? ", rebuilding" : "", scene->pick_ms);
+            if (ImGui::Button("Benchmark BVH"))
+            {
+                Bvh::Benchmark();
+                bvh.Benchmark();
+            }
+            ImGui::SameLine();
+            ImGui::TextDisabled("synthetic trees, then the scene's, results in the console");
+            if (ImGui::Button("Benchmark Scene Store"))
+            {
+                SceneStore::Benchmark();
+            }
+            ImGui::SameLine();
+            ImGui::TextDisabled("hierarchy updates, results in the console");
+            if (ImGui::Button("Benchmark Handles"))
+            {
+                HandleTable::Benchmark();
+            }
+            ImGui::SameLine();
+            ImGui::TextDisabled("SlotMap and EditorResource, results in the console");
+            if (ImGui::Button("Benchmark Transform Kernels"))
+            {
+                TransformKernels::Benchmark();
+            }
+            ImGui::SameLine();
+            ImGui::TextDisabled("%s, results in the console", TransformKernels::InstructionSet());
         }
 
         ImGui::End();
@@ -452,18 +558,59 @@ void renderer_ui::sceneUI(RendererWindow *window, Scene *scene)
     ImGui::SetNextWindowSize(ImVec2(width, height), ImGuiCond_Always);
     {
         ImGui::Begin("Scene");
-        static int selected_obj = -1;
-        std::vector<int> GC_Cache;
-        if (selected_obj >= 0)
-            selected = scene->scene_object_list[selected_obj];
-        for (int n = 0; n < scene->scene_object_list.size(); n++)
+        // a handle, so a removed object can't stay selected
+        static Handle selected_obj = HandleTable::NONE;
+        std::vector<Handle> GC_Cache;
+        // a left click outside every panel picks the model under the cursor, or clears the selection
+        if (ImGui::IsMouseClicked(ImGuiMouseButton_Left) && !isFocusOnUI())
+        {
+            selected_obj = scene->Pick(ImGui::GetIO().MousePos.x, ImGui::GetIO().MousePos.y);
+        }
+        selected = scene->GetSceneObject(selected_obj);
+        // children listed under their parent, indented by depth
+        std::vector<std::pair<SceneObject*, int>> rows;  // object, depth
+        std::vector<std::pair<SceneObject*, int>> stack;
+        for (int n = scene->scene_objects.Size() - 1; n >= 0; n--)
+        {
+            if (scene->scene_objects[n]->parent == nullptr)
+                stack.push_back({ scene->scene_objects[n], 0 });
+        }
+        while (!stack.empty())
+        {
+            auto top = stack.back();
+            stack.pop_back();
+            rows.push_back(top);
+            for (auto child = top.first->children.rbegin(); child != top.first->children.rend(); child++)
+                stack.push_back({ *child, top.second + 1 });
+        }
+        SceneObject* new_parent = nullptr;
+        SceneObject* new_child = nullptr;
+        for (auto row : rows)
         {
-            std::string item_name = scene->scene_object_list[n]->name + "##" + std::to_string(scene->scene_object_list[n]->id);
+            SceneObject* object = row.first;
+            Handle n = object->id;
+            std::string item_name = std::string(row.second * 2, ' ') + object->name + "##" + std::to_string(n);
             const char *item = item_name.c_str();
             if (ImGui::Selectable(item, selected_obj == n))
             {
                 selected_obj = n;
             }
+            // drag an object onto another to make it a child there
+            if (ImGui::BeginDragDropSource())
+            {
+                ImGui::SetDragDropPayload("SCENE_OBJECT", &n, sizeof(Handle));
+                ImGui::Text(object->name.c_str());
+                ImGui::EndDragDropSource();
+            }
+            if (ImGui::BeginDragDropTarget())
+            {
+                if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload("SCENE_OBJECT"))
+                {
+                    new_child = scene->GetSceneObject(*(const Handle*)payload->Data);
+                    new_parent = object;
+                }
+                ImGui::EndDragDropTarget();
+            }
             if (ImGui::BeginPopupContextItem()) // <-- use last item id as popup id
             {
                 selected_obj = n;
@@ -473,17 +620,23 @@ void renderer_ui::sceneUI(RendererWindow *window, Scene *scene)
                 ImGui::SameLine();
                 if (ImGui::Button("Rename"))
                 {
-                    scene->scene_object_list[n]->name = new_name;
+                    object->name = new_name;
                     strcpy_s(new_name, "new name");
                     ImGui::CloseCurrentPopup();
                 }
 
+                if (object->parent != nullptr && ImGui::Button("Unparent"))
+                {
+                    object->SetParent(nullptr);
+                    ImGui::CloseCurrentPopup();
+                }
+
                 if (ImGui::Button("Remove"))
                 {
-                    if (!scene->scene_object_list[n]->IsEditor())
+                    if (!object->IsEditor())
                     {
                         selected = nullptr;
-                        selected_obj = -1;
+                        selected_obj = HandleTable::NONE;
                         GC_Cache.push_back(n);
                         ImGui::CloseCurrentPopup();
                     }
@@ -496,13 +649,17 @@ void renderer_ui::sceneUI(RendererWindow *window, Scene *scene)
             }
             else
             {
-                scene->scene_object_list[n]->is_selected = (selected_obj == n);
+                object->is_selected = (selected_obj == n);
             }
             ImGui::SetItemTooltip("Right-click to open popup");
         }
-        for (int i = 0; i < GC_Cache.size(); i++)
+        if (new_child != nullptr && !new_child->SetParent(new_parent))
+        {
+            RendererConsole::GetInstance()->AddWarn("%s can't be parented to itself or its children", new_child->name.c_str());
+        }
+        for (size_t i = 0; i < GC_Cache.size(); i++)
         {
-            scene->RemoveSceneObjectAtIndex(GC_Cache[i]);
+            scene->RemoveSceneObject(GC_Cache[i]);
         }
         ImGui::End();
     }
@@ -569,14 +726,16 @@ void renderer_ui::resourceUI(RendererWindow *window, Scene *scene)
             {
                 ImGuiWindowFlags window_flags = ImGuiWindowFlags_HorizontalScrollbar;
                 ImGui::BeginChild("ModelList", ImVec2(ImGui::GetContentRegionAvail().x - preview_width, preview_height - 20), ImGuiChildFlags_None, window_flags);
-                static int selected_model = -1;
+                // a handle, a removed model reads as no selection
+                static Handle selected_model = HandleTable::NONE;
                 for (int n = 0; n < model_names.size(); n++)
                 {
-                    if (ImGui::Selectable(model_names[n].c_str(), selected_model == n))
-                        selected_model = n;
+                    Handle model_handle = mmp[model_names[n]]->handle;
+                    if (ImGui::Selectable(model_names[n].c_str(), selected_model == model_handle))
+                        selected_model = model_handle;
                     if (ImGui::BeginPopupContextItem()) // <-- use last item id as popup id
                     {
-                        selected_model = n;
+                        selected_model = model_handle;
                         ImGui::Text("This a popup for \"%s\"!", model_names[n].c_str());
                         if (ImGui::Button("Create Instance"))
                         {
@@ -586,7 +745,7 @@ void renderer_ui::resourceUI(RendererWindow *window, Scene *scene)
                         }
                         if (ImGui::Button("Remove"))
                         {
-                            selected_model = -1;
+                            selected_model = HandleTable::NONE;
                             std::string name = model_names[n];
                             Model *tmp = Model::LoadedModel[name];
                             delete tmp;
@@ -601,13 +760,13 @@ void renderer_ui::resourceUI(RendererWindow *window, Scene *scene)
 
                 ImGui::SameLine();
 
-                if (selected_model >= 0)
+                Model *cur_model = Model::Get(selected_model);
+                if (cur_model != nullptr)
                 {
                     window_flags = ImGuiWindowFlags_None;
                     ImGui::PushStyleVar(ImGuiStyleVar_ChildRounding, 5.0f);
                     ImGui::BeginChild("ModelPreviewPanel", ImVec2(preview_width - 10, preview_height - 20), ImGuiChildFlags_Border, window_flags);
                     ImGui::BeginChild("ModelInfo", ImVec2(preview_width - 20, preview_height - 40), ImGuiChildFlags_Border);
-                    Model *cur_model = Model::LoadedModel[model_names[selected_model]];
                     ImGui::Text(("name:" + cur_model->name).c_str());
                     ImGui::Text(("mesh count:" + std::to_string(cur_model->meshes.size())).c_str());
                     ImGui::Text(("ref count:" + std::to_string(cur_model->refSceneModels.references.size())).c_str());
@@ -660,25 +819,26 @@ void renderer_ui::resourceUI(RendererWindow *window, Scene *scene)
 
             if (ImGui::BeginTabItem("Loaded Textures"))
             {
-                static int selected_tex = -1;
+                static Handle selected_tex = HandleTable::NONE;
                 {
                     ImGuiWindowFlags window_flags = ImGuiWindowFlags_HorizontalScrollbar;
                     ImGui::BeginChild("TextureList", ImVec2(ImGui::GetContentRegionAvail().x - preview_width, preview_height - 20), ImGuiChildFlags_None, window_flags);
                     for (int n = 0; n < tex_names.size(); n++)
                     {
-                        if (ImGui::Selectable(tex_names[n].c_str(), selected_tex == n))
-                            selected_tex = n;
+                        Handle tex_handle = tmp[tex_names[n]]->handle;
+                        if (ImGui::Selectable(tex_names[n].c_str(), selected_tex == tex_handle))
+                            selected_tex = tex_handle;
                         if (ImGui::BeginPopupContextItem()) // <-- use last item id as popup id
                         {
-                            selected_tex = n;
+                            selected_tex = tex_handle;
                             ImGui::Text("This a popup for \"%s\"!", tex_names[n].c_str());
                             if (ImGui::Button("Remove"))
                             {
-                                Texture2D *tmp = Texture2D::LoadedTextures[tex_names[n]];
-                                if (!tmp->is_editor)
+                                Texture2D *tex = Texture2D::LoadedTextures[tex_names[n]];
+                                if (!tex->is_editor)
                                 {
-                                    selected_tex = -1;
-                                    delete tmp;
+                                    selected_tex = HandleTable::NONE;
+                                    delete tex;
                                 }
                                 else
                                 {
@@ -696,12 +856,12 @@ void renderer_ui::resourceUI(RendererWindow *window, Scene *scene)
 
                 ImGui::SameLine();
                 {
-                    if (selected_tex >= 0)
+                    Texture2D *tex = Texture2D::Get(selected_tex);
+                    if (tex != nullptr)
                     {
                         ImGuiWindowFlags window_flags = ImGuiWindowFlags_None;
                         ImGui::PushStyleVar(ImGuiStyleVar_ChildRounding, 5.0f);
                         ImGui::BeginChild("TexturePreviewPanel", ImVec2(preview_width - 10, preview_height - 20), ImGuiChildFlags_Border, window_flags);
-                        Texture2D *tex = Texture2D::LoadedTextures[tex_names[selected_tex]];
                         ImGui::BeginChild("TextureInfo", ImVec2(preview_width - preview_height, preview_height - 40), ImGuiChildFlags_Border);
                         ImGui::Text(("name:" + tex->name).c_str());
                         ImGui::Text(("ref count:" + std::to_string(tex->textureRefs.references.size())).c_str());
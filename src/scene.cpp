@@ -1,9 +1,13 @@
+#include <chrono>
+
 #include "scene.h"
 #include "renderer_window.h"
 #include "scene_object.h"
 #include "camera.h"
 #include "model.h"
 #include "shader.h"
+#include "scene_store.h"
+#include "renderer_console.h"
 
 Scene::Scene(RendererWindow *_window)
     : window(_window), render_pipeline(RenderPipeline(_window))
@@ -13,31 +17,92 @@ Scene::Scene(RendererWindow *_window)
 }
 
 Scene::~Scene() {}
-void Scene::RegisterSceneObject(SceneObject *object)            { scene_object_list.push_back(object);     }
-void Scene::RenderScene()                                       { render_pipeline.Render();   }
+// false once scene_objects is full, the object is left unregistered
+bool Scene::RegisterSceneObject(SceneObject *object)
+{
+    object->id = scene_objects.Insert(object);
+    if (object->id == HandleTable::NONE)
+    {
+        RendererConsole::GetInstance()->AddError("[error] Too many scene objects, %s is not added!", object->name.c_str());
+        return false;
+    }
+    return true;
+}
 
 void Scene::RegisterGlobalLight( SceneLight *light)
 {
-    RegisterSceneObject(light);
-    render_pipeline.global_light = light;
+    if (RegisterSceneObject(light))
+    {
+        render_pipeline.global_light = light;
+    }
 }
 
 void Scene::InstanceFromModel(Model *model, std::string name)
 {
     SceneModel *scene_model = new SceneModel(model, name);
-    RegisterSceneObject(scene_model);
-    render_pipeline.EnqueueRenderQueue(scene_model);
+    if (!RegisterSceneObject(scene_model))
+    {
+        delete scene_model;
+        return;
+    }
+    scene_model->render_entry = render_pipeline.EnqueueRenderQueue(scene_model);
+    if (scene_model->render_entry == HandleTable::NONE)
+    {
+        scene_objects.Remove(scene_model->id);
+        delete scene_model;
+        return;
+    }
+    scene_bvh.Insert(scene_model);
 }
 
-void Scene::RemoveSceneObjectAtIndex(int index)
+// the pipeline updates the world bounds, the BVH follows them
+void Scene::RenderScene()
 {
-    if (index >= scene_object_list.size())
+    SceneStore::GetInstance()->UpdateTransforms();
+    render_pipeline.Render();
+    scene_bvh.Update();
+}
+
+SceneObject *Scene::GetSceneObject(Handle handle)
+{
+    SceneObject **object = scene_objects.Get(handle);
+    return object != nullptr ? *object : nullptr;
+}
+
+// the last object takes the removed one's place in scene_objects
+void Scene::RemoveSceneObject(Handle handle)
+{
+    SceneObject* target_so = GetSceneObject(handle);
+    if (target_so == nullptr)
     {
         return;
     }
-    auto it = scene_object_list.begin() + index;
-    SceneObject* target_so = *it;
-    render_pipeline.RemoveFromRenderQueue(target_so->id);
-    scene_object_list.erase(it);
+    render_pipeline.RemoveFromRenderQueue(target_so->render_entry);
+    if (target_so->render_entry != HandleTable::NONE)
+    {
+        scene_bvh.Remove(static_cast<SceneModel*>(target_so));
+    }
+    scene_objects.Remove(handle);
     delete target_so;
+}
+
+// a ray from the camera through the pixel, against the triangles of every SceneModel it reaches
+Handle Scene::Pick(float x, float y)
+{
+    if (window->Width() == 0 || window->Height() == 0)
+    {
+        return HandleTable::NONE;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    Camera* camera = window->render_camera;
+    float aspect = (float)window->Width() / (float)window->Height();
+    float tan_half_fov = glm::tan(glm::radians(camera->Zoom) * 0.5f);
+    float ndc_x = 2.0f * x / window->Width() - 1.0f;
+    float ndc_y = 1.0f - 2.0f * y / window->Height();
+    glm::vec3 direction = camera->Front + camera->Right * (ndc_x * tan_half_fov * aspect) + camera->Up * (ndc_y * tan_half_fov);
+
+    SceneRayHit hit;
+    scene_bvh.Raycast(Ray(camera->Position, glm::normalize(direction)), hit);
+    pick_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return hit.object;
 }
\ No newline at end of file
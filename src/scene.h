@@ -3,6 +3,8 @@
 #include <string>
 
 #include "render_pipeline.h"
+#include "scene_bvh.h"
+#include "slot_map.h"
 class SceneLight;
 class SceneObject;
 class RendererWindow;
@@ -12,17 +14,23 @@ class Model;
 class Scene
 {
 public:
-    std::vector<SceneObject *>  scene_object_list;
+    SlotMap<SceneObject *>      scene_objects;      // SceneObject::id is the handle
     RenderPipeline              render_pipeline;
+    SceneBvh                    scene_bvh;          // every SceneModel, for picking and spatial queries
+    float                       pick_ms = 0;        // the last Pick
 
 public:
     Scene(RendererWindow *window);
     ~Scene();
-	void RegisterSceneObject(SceneObject* object);
+	bool RegisterSceneObject(SceneObject* object);
 	void RegisterGlobalLight(SceneLight* light);
 	void InstanceFromModel(Model* model, std::string name);
-	void RemoveSceneObjectAtIndex(int index);
+	// nullptr for a stale handle
+	SceneObject* GetSceneObject(Handle handle);
+	void RemoveSceneObject(Handle handle);
 	void RenderScene();
+	// the SceneModel under a window position in pixels (top left origin), NONE if none
+	Handle Pick(float x, float y);
 
     RendererWindow *window;
 };
\ No newline at end of file
@@ -0,0 +1,465 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "scene_bvh.h"
+#include "scene_object.h"
+#include "scene_store.h"
+#include "renderer_console.h"
+
+const unsigned int SceneBvh::MAX_LEAF_OBJECTS;
+
+SceneBvh::~SceneBvh()
+{
+    if (builder.joinable())
+    {
+        builder.join();
+    }
+}
+
+unsigned int SceneBvh::Find(Handle object) const
+{
+    unsigned int slot = object & HandleTable::INDEX_MASK;
+    if (object == HandleTable::NONE || slot >= slot_primitive.size())
+    {
+        return HandleTable::NONE;
+    }
+    unsigned int i = slot_primitive[slot];
+    return i != HandleTable::NONE && primitives[i].object == object ? i : HandleTable::NONE;
+}
+
+void SceneBvh::Insert(SceneModel* model)
+{
+    if (model->id == HandleTable::NONE || Find(model->id) != HandleTable::NONE)
+    {
+        return;
+    }
+    unsigned int slot = model->id & HandleTable::INDEX_MASK;
+    if (slot >= slot_primitive.size())
+    {
+        slot_primitive.resize(slot + 1, HandleTable::NONE);
+    }
+    slot_primitive[slot] = (unsigned int)primitives.size();
+    primitives.push_back({ model, model->id, model->entity });
+    // Update fills it in, the world bounds may not be built yet
+    boxes.push_back(AABB());
+}
+
+void SceneBvh::Remove(SceneModel* model)
+{
+    unsigned int i = Find(model->id);
+    if (i == HandleTable::NONE)
+    {
+        return;
+    }
+    slot_primitive[model->id & HandleTable::INDEX_MASK] = HandleTable::NONE;
+    primitives[i].model = nullptr;
+    boxes[i] = AABB();
+    removed_count++;
+}
+
+void SceneBvh::Update()
+{
+    bool refit = false;
+    if (building && build_done)
+    {
+        AdoptRebuild();
+        refit = true;
+    }
+
+    SceneStore* store = SceneStore::GetInstance();
+    for (unsigned int i = 0; i < primitives.size(); i++)
+    {
+        if (primitives[i].model == nullptr)
+        {
+            continue;
+        }
+        const AABB& bounds = store->world_bounds[store->Index(primitives[i].entity)];
+        if (memcmp(&boxes[i], &bounds, sizeof(AABB)) != 0)
+        {
+            boxes[i] = bounds;
+            refit |= i < tree_count;
+        }
+    }
+    if (refit)
+    {
+        Bvh::Refit(nodes, order, boxes.data());
+        cost = Bvh::Cost(nodes);
+    }
+
+    if (!building && (PendingCount() > 0 || removed_count > 0 || (built_cost > 0 && cost > built_cost * REBUILD_COST_RATIO)))
+    {
+        StartRebuild();
+    }
+}
+
+void SceneBvh::StartRebuild()
+{
+    if (builder.joinable())
+    {
+        builder.join();
+    }
+    next_primitives.clear();
+    next_source.clear();
+    next_boxes.clear();
+    for (unsigned int i = 0; i < primitives.size(); i++)
+    {
+        if (primitives[i].model != nullptr)
+        {
+            next_primitives.push_back(primitives[i]);
+            next_source.push_back(i);
+            next_boxes.push_back(boxes[i]);
+        }
+    }
+    snapshot_count = (unsigned int)primitives.size();
+    building = true;
+    build_done = false;
+    // only the next_* arrays, the main thread leaves them alone until build_done
+    builder = std::thread([this]()
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        Bvh::Build(next_boxes.data(), (unsigned int)next_boxes.size(), MAX_LEAF_OBJECTS, next_nodes, next_order);
+        next_cost = Bvh::Cost(next_nodes);
+        next_build_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        build_done = true;
+    });
+}
+
+// the new tree over the snapshot, minus what was removed since, plus what was added since as pending
+void SceneBvh::AdoptRebuild()
+{
+    builder.join();
+    building = false;
+    removed_count = 0;
+    for (unsigned int k = 0; k < next_primitives.size(); k++)
+    {
+        if (primitives[next_source[k]].model == nullptr)
+        {
+            next_primitives[k].model = nullptr;
+            next_boxes[k] = AABB();
+            removed_count++;
+        }
+    }
+    tree_count = (unsigned int)next_primitives.size();
+    for (unsigned int i = snapshot_count; i < primitives.size(); i++)
+    {
+        if (primitives[i].model != nullptr)
+        {
+            next_primitives.push_back(primitives[i]);
+            next_boxes.push_back(boxes[i]);
+        }
+    }
+    primitives.swap(next_primitives);
+    boxes.swap(next_boxes);
+    nodes.swap(next_nodes);
+    order.swap(next_order);
+
+    std::fill(slot_primitive.begin(), slot_primitive.end(), HandleTable::NONE);
+    for (unsigned int i = 0; i < primitives.size(); i++)
+    {
+        if (primitives[i].model != nullptr)
+        {
+            slot_primitive[primitives[i].object & HandleTable::INDEX_MASK] = i;
+        }
+    }
+    built_cost = cost = next_cost;
+    build_ms = next_build_ms;
+    rebuild_count++;
+}
+
+void SceneBvh::RaycastPrimitive(unsigned int i, const Ray& ray, float& t, unsigned int& hit)
+{
+    SceneModel* model = primitives[i].model;
+    if (model == nullptr || Bvh::IntersectBox(ray, boxes[i].min, boxes[i].max, t) == FLT_MAX)
+    {
+        return;
+    }
+    SceneStore* store = SceneStore::GetInstance();
+    for (Handle renderer : model->renderers)
+    {
+        MeshRenderer* mr = store->GetRenderer(renderer);
+        if (mr == nullptr || mr->mesh == nullptr || mr->mesh->vertices.empty())
+        {
+            continue;
+        }
+        const Mesh* mesh = mr->mesh;
+        float t_mesh = t;
+        if (!mesh->bvh.IsBuilt())
+        {
+            // nothing to refine with, the renderer's box is as close as it gets
+            t_mesh = Bvh::IntersectBox(ray, mr->world_bounds.min, mr->world_bounds.max, t);
+        }
+        else if (!mesh->bvh.Raycast(ray.Transformed(glm::inverse(mr->model_matrix)), &mesh->vertices[0].Position, sizeof(Vertex), mesh->indices.data(), t_mesh))
+        {
+            continue;
+        }
+        if (t_mesh < t)
+        {
+            t = t_mesh;
+            hit = i;
+        }
+    }
+}
+
+bool SceneBvh::Raycast(const Ray& ray, SceneRayHit& hit)
+{
+    float t = FLT_MAX;
+    unsigned int nearest = HandleTable::NONE;
+    unsigned int stack[Bvh::MAX_STACK];
+    int top = 0;
+    if (!nodes.empty() && Bvh::IntersectBox(ray, nodes[0].min, nodes[0].max, t) != FLT_MAX)
+    {
+        stack[top++] = 0;
+    }
+    while (top > 0)
+    {
+        const BvhNode& node = nodes[stack[--top]];
+        if (node.IsLeaf())
+        {
+            for (unsigned int slot = node.first; slot < node.first + node.count; slot++)
+            {
+                RaycastPrimitive(order[slot], ray, t, nearest);
+            }
+            continue;
+        }
+        // an earlier hit may have moved t, entry distances are against the current one
+        float t_left = Bvh::IntersectBox(ray, nodes[node.first].min, nodes[node.first].max, t);
+        float t_right = Bvh::IntersectBox(ray, nodes[node.first + 1].min, nodes[node.first + 1].max, t);
+        unsigned int near_child = t_left <= t_right ? node.first : node.first + 1;
+        if (glm::max(t_left, t_right) != FLT_MAX)
+        {
+            stack[top++] = near_child == node.first ? node.first + 1 : node.first;
+        }
+        if (glm::min(t_left, t_right) != FLT_MAX)
+        {
+            stack[top++] = near_child;
+        }
+    }
+    for (unsigned int i = tree_count; i < primitives.size(); i++)
+    {
+        RaycastPrimitive(i, ray, t, nearest);
+    }
+
+    if (nearest == HandleTable::NONE)
+    {
+        return false;
+    }
+    hit.object = primitives[nearest].object;
+    hit.distance = t;
+    hit.point = ray.At(t);
+    return true;
+}
+
+void SceneBvh::QueryFrustum(const Frustum& frustum, std::vector<Handle>& objects)
+{
+    unsigned int stack[Bvh::MAX_STACK];
+    int top = 0;
+    if (!nodes.empty())
+    {
+        stack[top++] = 0;
+    }
+    while (top > 0)
+    {
+        const BvhNode& node = nodes[stack[--top]];
+        if (!frustum.Intersects(node.Bounds()))
+        {
+            continue;
+        }
+        if (!node.IsLeaf())
+        {
+            stack[top++] = node.first + 1;
+            stack[top++] = node.first;
+            continue;
+        }
+        for (unsigned int slot = node.first; slot < node.first + node.count; slot++)
+        {
+            unsigned int i = order[slot];
+            if (primitives[i].model != nullptr && frustum.Intersects(boxes[i]))
+            {
+                objects.push_back(primitives[i].object);
+            }
+        }
+    }
+    for (unsigned int i = tree_count; i < primitives.size(); i++)
+    {
+        if (primitives[i].model != nullptr && frustum.Intersects(boxes[i]))
+        {
+            objects.push_back(primitives[i].object);
+        }
+    }
+}
+
+Handle SceneBvh::Nearest(const glm::vec3& point, float max_distance, float* distance)
+{
+    float best = max_distance < FLT_MAX ? max_distance * max_distance : FLT_MAX;
+    unsigned int nearest = HandleTable::NONE;
+    // max_distance itself counts, a model without bounds yet never does
+    auto closer = [&](unsigned int i, float d)
+    {
+        return primitives[i].model != nullptr && d != FLT_MAX && (d < best || (d == best && nearest == HandleTable::NONE));
+    };
+    unsigned int stack[Bvh::MAX_STACK];
+    int top = 0;
+    if (!nodes.empty() && Bvh::DistanceSquared(point, nodes[0].min, nodes[0].max) <= best)
+    {
+        stack[top++] = 0;
+    }
+    while (top > 0)
+    {
+        const BvhNode& node = nodes[stack[--top]];
+        // best may have shrunk since the node was pushed
+        if (Bvh::DistanceSquared(point, node.min, node.max) > best)
+        {
+            continue;
+        }
+        if (node.IsLeaf())
+        {
+            for (unsigned int slot = node.first; slot < node.first + node.count; slot++)
+            {
+                unsigned int i = order[slot];
+                float d = Bvh::DistanceSquared(point, boxes[i].min, boxes[i].max);
+                if (closer(i, d))
+                {
+                    best = d;
+                    nearest = i;
+                }
+            }
+            continue;
+        }
+        float d_left = Bvh::DistanceSquared(point, nodes[node.first].min, nodes[node.first].max);
+        float d_right = Bvh::DistanceSquared(point, nodes[node.first + 1].min, nodes[node.first + 1].max);
+        unsigned int near_child = d_left <= d_right ? node.first : node.first + 1;
+        if (glm::max(d_left, d_right) <= best)
+        {
+            stack[top++] = near_child == node.first ? node.first + 1 : node.first;
+        }
+        if (glm::min(d_left, d_right) <= best)
+        {
+            stack[top++] = near_child;
+        }
+    }
+    for (unsigned int i = tree_count; i < primitives.size(); i++)
+    {
+        float d = Bvh::DistanceSquared(point, boxes[i].min, boxes[i].max);
+        if (closer(i, d))
+        {
+            best = d;
+            nearest = i;
+        }
+    }
+
+    if (nearest == HandleTable::NONE)
+    {
+        return HandleTable::NONE;
+    }
+    if (distance != nullptr)
+    {
+        *distance = glm::sqrt(best);
+    }
+    return primitives[nearest].object;
+}
+
+/*****************************************************
+* The live tree against testing every model: rays from
+* around the scene at random models and points, frustums
+* looking into it and random points for Nearest. A ray
+* mismatches when the distances differ, two models hit
+* at the same distance may come back in either order.
+*****************************************************/
+void SceneBvh::Benchmark()
+{
+    AABB scene_bounds;
+    std::vector<unsigned int> live;
+    for (unsigned int i = 0; i < primitives.size(); i++)
+    {
+        if (primitives[i].model != nullptr && boxes[i].IsValid())
+        {
+            scene_bounds.Expand(boxes[i]);
+            live.push_back(i);
+        }
+    }
+    if (live.empty())
+    {
+        RendererConsole::GetInstance()->AddNote("Scene bvh: nothing to test, the scene has no models");
+        return;
+    }
+    glm::vec3 center = scene_bounds.Center();
+    float radius = std::max(glm::length(scene_bounds.max - scene_bounds.min) * 0.5f, 1.0f);
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    auto around = [&]()
+    {
+        glm::vec3 direction(unit(random), unit(random), unit(random));
+        return center + glm::normalize(direction + glm::vec3(0.0f, 0.0f, 1e-3f)) * radius * 1.5f;
+    };
+
+    const int rays = 200;
+    int hits = 0, ray_mismatches = 0;
+    float pick_ms = 0, pick_max_ms = 0, brute_force_ms = 0;
+    for (int r = 0; r < rays; r++)
+    {
+        glm::vec3 origin = around();
+        glm::vec3 target = r % 2 == 0 ? boxes[live[random() % live.size()]].Center() : center + glm::vec3(unit(random), unit(random), unit(random)) * radius * 0.5f;
+        Ray ray(origin, glm::normalize(target - origin));
+        SceneRayHit hit;
+        auto start = std::chrono::high_resolution_clock::now();
+        bool found = Raycast(ray, hit);
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        pick_ms += ms;
+        pick_max_ms = std::max(pick_max_ms, ms);
+
+        float t = FLT_MAX;
+        unsigned int nearest = HandleTable::NONE;
+        start = std::chrono::high_resolution_clock::now();
+        for (unsigned int i = 0; i < primitives.size(); i++)
+        {
+            RaycastPrimitive(i, ray, t, nearest);
+        }
+        brute_force_ms += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        hits += found;
+        ray_mismatches += found != (nearest != HandleTable::NONE) || (found && std::abs(hit.distance - t) > 1e-4f * std::max(1.0f, t));
+    }
+
+    int frustum_mismatches = 0;
+    std::vector<Handle> objects, brute_force_objects;
+    for (int f = 0; f < 20; f++)
+    {
+        glm::vec3 eye = around();
+        Frustum frustum(glm::perspective(glm::radians(20.0f + f * 4.0f), 16.0f / 9.0f, 0.1f, radius * 3.0f) *
+                        glm::lookAt(eye, center + glm::vec3(unit(random), unit(random), unit(random)) * radius * 0.5f, glm::vec3(0.0f, 1.0f, 0.0f)));
+        objects.clear();
+        brute_force_objects.clear();
+        QueryFrustum(frustum, objects);
+        for (unsigned int i : live)
+        {
+            if (frustum.Intersects(boxes[i]))
+            {
+                brute_force_objects.push_back(primitives[i].object);
+            }
+        }
+        std::sort(objects.begin(), objects.end());
+        std::sort(brute_force_objects.begin(), brute_force_objects.end());
+        frustum_mismatches += objects != brute_force_objects;
+    }
+
+    int nearest_mismatches = 0;
+    for (int p = 0; p < 100; p++)
+    {
+        glm::vec3 point = center + glm::vec3(unit(random), unit(random), unit(random)) * radius;
+        float distance = FLT_MAX;
+        Handle object = Nearest(point, FLT_MAX, &distance);
+        float best = FLT_MAX;
+        for (unsigned int i : live)
+        {
+            best = std::min(best, Bvh::DistanceSquared(point, boxes[i].min, boxes[i].max));
+        }
+        nearest_mismatches += object == HandleTable::NONE || std::abs(distance - glm::sqrt(best)) > 1e-4f * std::max(1.0f, distance);
+    }
+
+    RendererConsole::GetInstance()->AddNote("Scene bvh, %u objects (%u pending), %u nodes", ObjectCount(), PendingCount(), NodeCount());
+    RendererConsole::GetInstance()->AddNote("  pick: %.4f ms average, %.4f ms max, brute force %.3f ms, %d/%d hits, %d mismatches",
+        pick_ms / rays, pick_max_ms, brute_force_ms / rays, hits, rays, ray_mismatches);
+    RendererConsole::GetInstance()->AddNote("  frustum: %d/20 mismatches, nearest: %d/100 mismatches", frustum_mismatches, nearest_mismatches);
+}
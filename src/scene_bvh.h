@@ -0,0 +1,102 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "bvh.h"
+#include "slot_map.h"
+
+class SceneModel;
+
+struct SceneRayHit
+{
+    Handle      object = HandleTable::NONE;     // Scene handle of the SceneModel hit
+    float       distance = FLT_MAX;             // in units of the ray direction
+    glm::vec3   point = glm::vec3(0);
+};
+
+/*****************************************************
+* Spatial queries over the SceneModels of a scene: a
+* BVH over their world bounds (see Bvh) for ray casts,
+* frustum and nearest object queries. A ray that
+* reaches a model's bounds goes on into the triangle
+* BVH of each of its meshes, so picking hits geometry,
+* not boxes.
+*
+* Update, once a frame after the world bounds, refits
+* the tree to the models that moved. Models added since
+* the last build are tested one by one, removed ones
+* are skipped. Once there are either, or refits made
+* the tree more than REBUILD_COST_RATIO times costlier
+* than it was built, a new tree is built on a thread of
+* its own from a copy of the bounds and swapped in by a
+* later Update, the old one answering meanwhile.
+*****************************************************/
+class SceneBvh
+{
+public:
+    static constexpr float      REBUILD_COST_RATIO = 1.5f;
+    static const unsigned int   MAX_LEAF_OBJECTS = 2;
+
+    ~SceneBvh();
+    // the model's SceneObject::id must be set already
+    void    Insert(SceneModel* model);
+    // before the model is deleted
+    void    Remove(SceneModel* model);
+    void    Update();
+
+    // nearest model triangle along the ray, false if none
+    bool    Raycast(const Ray& ray, SceneRayHit& hit);
+    // models whose bounds intersect the frustum
+    void    QueryFrustum(const Frustum& frustum, std::vector<Handle>& objects);
+    // model with the nearest bounds within max_distance, NONE if none, distance 0 inside them
+    Handle  Nearest(const glm::vec3& point, float max_distance = FLT_MAX, float* distance = nullptr);
+    // time picks in the live tree and check every query against testing each model, log to the console
+    void    Benchmark();
+
+    unsigned int    ObjectCount() const     { return (unsigned int)primitives.size() - removed_count; }
+    unsigned int    PendingCount() const    { return (unsigned int)primitives.size() - tree_count; }
+    unsigned int    NodeCount() const       { return (unsigned int)nodes.size(); }
+    bool            IsRebuilding() const    { return building; }
+
+    // stats
+    float           cost = 0;               // Bvh::Cost now
+    float           built_cost = 0;         // and right after the last build
+    float           build_ms = 0;           // of the last build, on the builder thread
+    unsigned int    rebuild_count = 0;
+
+private:
+    struct Primitive
+    {
+        SceneModel*     model;              // nullptr once removed
+        Handle          object;
+        Handle          entity;
+    };
+
+    // primitive index of a live object, NONE if it has none
+    unsigned int    Find(Handle object) const;
+    void            StartRebuild();
+    void            AdoptRebuild();
+    // distance of the model's nearest triangle along the ray if below t
+    void            RaycastPrimitive(unsigned int i, const Ray& ray, float& t, unsigned int& hit);
+
+    std::vector<Primitive>      primitives;
+    std::vector<AABB>           boxes;          // world bounds by primitive, empty once removed
+    std::vector<unsigned int>   slot_primitive; // primitive by object handle slot
+    std::vector<BvhNode>        nodes;
+    std::vector<unsigned int>   order;          // primitive of every leaf slot
+    unsigned int                tree_count = 0; // primitives [0, tree_count) are in the tree
+    unsigned int                removed_count = 0;
+
+    // the background build, main thread only touches next_* while building is false
+    std::thread                 builder;
+    std::atomic<bool>           build_done { false };
+    bool                        building = false;
+    unsigned int                snapshot_count = 0;     // primitives when the build started
+    std::vector<Primitive>      next_primitives;        // the live ones of those
+    std::vector<unsigned int>   next_source;            // and where they were in primitives
+    std::vector<AABB>           next_boxes;
+    std::vector<BvhNode>        next_nodes;
+    std::vector<unsigned int>   next_order;
+    float                       next_cost = 0;
+    float                       next_build_ms = 0;
+};
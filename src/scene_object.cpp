@@ -1,22 +1,61 @@
 #include "scene_object.h"
 #include "model.h"
 
-unsigned int SceneObject::cur_id = 0;
-
 SceneObject::SceneObject()
 {
-    id = cur_id++;
     this->name = "object";
-    atr_transform = new ATR_Transform();
+    entity = SceneStore::GetInstance()->CreateEntity();
+    transform = EntityTransform(entity);
+    atr_transform = new ATR_Transform(transform);
 }
 
 SceneObject::SceneObject(std::string _name, bool _is_editor) : name(_name), is_editor(_is_editor)
 { 
-    id = cur_id++; 
-    atr_transform = new ATR_Transform();
+    entity = SceneStore::GetInstance()->CreateEntity();
+    transform = EntityTransform(entity);
+    atr_transform = new ATR_Transform(transform);
 }
 
-SceneObject::~SceneObject() {}
+// children stay in the scene as roots
+SceneObject::~SceneObject()
+{
+    while (!children.empty())
+    {
+        children.back()->SetParent(nullptr);
+    }
+    if (parent != nullptr)
+    {
+        parent->children.erase(std::remove(parent->children.begin(), parent->children.end(), this), parent->children.end());
+    }
+    delete atr_transform;
+    SceneStore::GetInstance()->DestroyEntity(entity);
+}
+
+bool SceneObject::SetParent(SceneObject* new_parent)
+{
+    for (SceneObject* ancestor = new_parent; ancestor != nullptr; ancestor = ancestor->parent)
+    {
+        if (ancestor == this)
+        {
+            return false;
+        }
+    }
+    if (new_parent == parent)
+    {
+        return true;
+    }
+    if (parent != nullptr)
+    {
+        parent->children.erase(std::remove(parent->children.begin(), parent->children.end(), this), parent->children.end());
+    }
+    parent = new_parent;
+    if (parent != nullptr)
+    {
+        parent->children.push_back(this);
+    }
+    SceneStore::GetInstance()->SetParent(entity, parent != nullptr ? parent->entity : SceneStore::NONE);
+    return true;
+}
 
 void SceneObject::RenderAttribute() 
 {
@@ -29,7 +68,24 @@ SceneModel::SceneModel(Model *_model, bool _is_editor) : model(_model)
     for (int i = 0; i < _model->meshes.size(); i++)
     {
         Material* material;
-        if (_model->meshes[i]->textures.size() > 0)
+        const PbrMaterialInfo& pbr = _model->meshes[i]->pbr;
+        if (pbr.valid)
+        {
+            CTPBRMaterial* ct_material = (CTPBRMaterial*)MaterialManager::CreateMaterialByType(COOK_TORRANCE);
+            if (pbr.albedo_map != nullptr)      ct_material->SetTexture(&ct_material->albedo_map, pbr.albedo_map);
+            if (pbr.normal_map != nullptr)      ct_material->SetTexture(&ct_material->normal_map, pbr.normal_map);
+            if (pbr.metallic_map != nullptr)    ct_material->SetTexture(&ct_material->metallic_map, pbr.metallic_map);
+            if (pbr.roughness_map != nullptr)   ct_material->SetTexture(&ct_material->roughness_map, pbr.roughness_map);
+            if (pbr.ao_map != nullptr)          ct_material->SetTexture(&ct_material->ao_map, pbr.ao_map);
+            ct_material->color[0] = pbr.color.r;
+            ct_material->color[1] = pbr.color.g;
+            ct_material->color[2] = pbr.color.b;
+            ct_material->metallic_strength = pbr.metallic;
+            ct_material->roughness_strength = pbr.roughness;
+            ct_material->ao_strength = pbr.ao;
+            material = ct_material;
+        }
+        else if (_model->meshes[i]->textures.size() > 0)
         {
             // material = new ModelMaterial(Shader::LoadedShaders["model.fs"], _model->meshes[i]->textures[0]);
             material = MaterialManager::CreateMaterialByType(BLINN_PHONG);
@@ -39,9 +95,9 @@ SceneModel::SceneModel(Model *_model, bool _is_editor) : model(_model)
             // material = new ModelMaterial(Shader::LoadedShaders["model.fs"]);
             material = MaterialManager::CreateMaterialByType(BLINN_PHONG);
         }
-        MeshRenderer* _meshRenderer = new MeshRenderer(material, _model->meshes[i]);
-        atr_meshRenderers.push_back(new ATR_MeshRenderer(_meshRenderer));
-        meshRenderers.push_back(_meshRenderer);
+        Handle renderer = SceneStore::GetInstance()->AddRenderer(entity, material, _model->meshes[i]);
+        atr_meshRenderers.push_back(new ATR_MeshRenderer(renderer));
+        renderers.push_back(renderer);
     }
     _model->refSceneModels.AddRef(this);
 }
@@ -51,11 +107,18 @@ SceneModel::SceneModel(Model *_model, std::string _name, bool _is_editor) : Scen
 void SceneModel::OnModelRemoved()
 {
     model = nullptr;
-    for (int i = 0; i < meshRenderers.size(); i++)
+    SceneStore* store = SceneStore::GetInstance();
+    for (Handle renderer : renderers)
     {
-        meshRenderers[i]->mesh = nullptr;
-        atr_meshRenderers[i]->meshRenderer = meshRenderers[i];
+        store->GetRenderer(renderer)->mesh = nullptr;
     }
+    store->InvalidateBounds(entity);
+}
+
+const AABB& SceneModel::WorldBounds()
+{
+    SceneStore* store = SceneStore::GetInstance();
+    return store->world_bounds[store->Index(entity)];
 }
 
 void SceneModel::RenderAttribute()
@@ -67,45 +130,41 @@ void SceneModel::RenderAttribute()
     }
 }
 
-void SceneModel::DrawSceneModel()
-{
-    for (int i = 0; i < meshRenderers.size(); i++)
-    {
-        meshRenderers[i]->Draw();
-    }
-}
-
 SceneModel::~SceneModel() 
 {
     if (model != nullptr)
     {
         model->refSceneModels.RemoveRef(this);
     }
-    for (int i = 0; i < meshRenderers.size(); i++)
+    for (size_t i = 0; i < renderers.size(); i++)
     {
         delete atr_meshRenderers[i];
-        delete meshRenderers[i];
         atr_meshRenderers[i] = nullptr;
-        meshRenderers[i] = nullptr;
+        SceneStore::GetInstance()->RemoveRenderer(renderers[i]);
     }
-    delete atr_transform;
 }
 
 SceneLight::SceneLight(std::string _name, bool _is_editor) : SceneObject(_name, _is_editor) 
 {
-    light = new ATR_Light(&light_intensity , light_color);
-	atr_transform->transform->SetPosition(0, 10, 0);
-    atr_transform->transform->SetRotation(120, 0, 0);
+    SceneStore::GetInstance()->AddLight(entity);
+    light = new ATR_Light(entity);
+	transform.SetPosition(0, 10, 0);
+    transform.SetRotation(120, 0, 0);
 }
 
 glm::vec3 SceneLight::GetLightColor()
 {
-    return glm::vec3(light_color[0], light_color[1], light_color[2]);
+    return SceneStore::GetInstance()->GetLight(entity)->color;
 }
 
 float SceneLight::GetLightIntensity()
 {
-    return light_intensity;
+    return SceneStore::GetInstance()->GetLight(entity)->intensity;
+}
+
+LightType SceneLight::GetLightType()
+{
+    return SceneStore::GetInstance()->GetLight(entity)->type;
 }
 
 void SceneLight::RenderAttribute()
@@ -114,4 +173,4 @@ void SceneLight::RenderAttribute()
     light->UI_Implement();
 }
 
-SceneLight::~SceneLight() {}
\ No newline at end of file
+SceneLight::~SceneLight() { delete light; }
\ No newline at end of file
@@ -4,14 +4,21 @@
 #include <map>
 
 #include "attributes.h"
+#include "bounds.h"
 
 class Model;
 class Shader;
 
+/*****************************************************
+* A named node of the scene hierarchy. Its components
+* (transform, bounds, renderers, light) live in the
+* SceneStore under `entity`, this keeps the editor's
+* side: name, selection, parent and children links and
+* the attribute panels.
+*****************************************************/
 class SceneObject
 {
 protected:
-    static unsigned int cur_id;
     bool is_editor = false;
 
 public:
@@ -20,12 +27,18 @@ public:
     bool IsEditor() { return is_editor; }
     virtual void RenderAttribute();
     virtual ~SceneObject();
+    // keeps the local transform, false if new_parent is this object or below it
+    bool SetParent(SceneObject* new_parent);
     bool is_selected = false;
 
     std::string                 name;
+    SceneObject*                parent = nullptr;
     std::vector<SceneObject*>   children;
+    Entity                      entity;
+    EntityTransform             transform;
     ATR_Transform*              atr_transform;
-	unsigned int                id;
+    Handle                      id = HandleTable::NONE;             // in the Scene, set when registered
+    Handle                      render_entry = HandleTable::NONE;   // in the RenderPipeline, if drawn
 };
 
 class SceneModel : public SceneObject
@@ -33,12 +46,13 @@ class SceneModel : public SceneObject
 public:
     Model                           *model;
     std::vector<ATR_MeshRenderer*>  atr_meshRenderers;
-    std::vector<MeshRenderer*>      meshRenderers;
+    std::vector<Handle>             renderers;      // in the SceneStore, one per mesh of the model
 
 public:
     SceneModel(Model *_model, bool _is_editor = false);
     SceneModel(Model *_model, std::string _name, bool _is_editor = false);
-    void DrawSceneModel();
+    // union of all mesh renderers' world bounds, as of the last SceneStore::UpdateWorldBounds
+    const AABB& WorldBounds();
     void OnModelRemoved();
     virtual void RenderAttribute();
     virtual ~SceneModel();
@@ -53,9 +67,5 @@ public:
     ~SceneLight();
     glm::vec3 GetLightColor();
     float GetLightIntensity();
-    LightType light_type = LightType::DIRECTIONAL;
-
-private:
-    float light_intensity = 10;
-    float light_color[3] = {1, 1, 1};
+    LightType GetLightType();
 };
\ No newline at end of file
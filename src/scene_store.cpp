@@ -0,0 +1,557 @@
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include "scene_store.h"
+#include "transform_kernels.h"
+#include "renderer_console.h"
+
+namespace
+{
+    // remove element i by moving the last one into its place
+    template <class T>
+    void SwapRemove(std::vector<T>& array, unsigned int i)
+    {
+        if (i + 1 < array.size())
+        {
+            array[i] = std::move(array.back());
+        }
+        array.pop_back();
+    }
+
+    glm::vec3 Direction(const glm::vec3& axis, const glm::vec3& fallback)
+    {
+        float length = glm::length(axis);
+        return length > 1e-6f ? axis / length : fallback;
+    }
+}
+
+const Handle SceneStore::NONE;
+
+Entity SceneStore::CreateEntity()
+{
+    Entity entity = entity_ids.Add();
+    if (entity == NONE)
+    {
+        return NONE;
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        position[i].push_back(0.0f);
+        scale[i].push_back(1.0f);
+    }
+    rotation[0].push_back(0.0f);
+    rotation[1].push_back(0.0f);
+    rotation[2].push_back(0.0f);
+    rotation[3].push_back(1.0f);
+    euler.push_back(glm::vec3(0));
+    local_matrix.push_back(glm::mat4(1.0f));
+    world_matrix.push_back(glm::mat4(1.0f));
+    world_version.push_back(0);
+    parent.push_back(NONE);
+    local_dirty.push_back(1);
+    world_bounds.push_back(AABB());
+    bounds_version.push_back(0);
+    renderer_count.push_back(0);
+    order_dirty = true;
+    return entity;
+}
+
+void SceneStore::DestroyEntity(Entity entity)
+{
+    if (!Alive(entity))
+    {
+        return;
+    }
+    lights.erase(std::remove_if(lights.begin(), lights.end(), [entity](const LightComponent& light) { return light.entity == entity; }), lights.end());
+
+    unsigned int i = Index(entity);
+    for (int c = 0; c < 3; c++)
+    {
+        SwapRemove(position[c], i);
+        SwapRemove(scale[c], i);
+    }
+    for (int c = 0; c < 4; c++)
+    {
+        SwapRemove(rotation[c], i);
+    }
+    SwapRemove(euler, i);
+    SwapRemove(local_matrix, i);
+    SwapRemove(world_matrix, i);
+    SwapRemove(world_version, i);
+    SwapRemove(parent, i);
+    SwapRemove(local_dirty, i);
+    SwapRemove(world_bounds, i);
+    SwapRemove(bounds_version, i);
+    SwapRemove(renderer_count, i);
+    entity_ids.Remove(entity);
+    order_dirty = true;
+}
+
+void SceneStore::SetParent(Entity entity, Entity new_parent)
+{
+    unsigned int i = Index(entity);
+    parent[i] = new_parent;
+    // a root's world matrix is its local one, a child's is rebuilt with the parent's
+    local_dirty[i] = 1;
+    order_dirty = true;
+}
+
+void SceneStore::SetPosition(Entity entity, const glm::vec3& value)
+{
+    unsigned int i = Index(entity);
+    position[0][i] = value.x;
+    position[1][i] = value.y;
+    position[2][i] = value.z;
+    local_dirty[i] = 1;
+}
+
+void SceneStore::SetRotation(Entity entity, const glm::vec3& euler_degrees)
+{
+    unsigned int i = Index(entity);
+    glm::quat q(glm::radians(euler_degrees));
+    euler[i] = euler_degrees;
+    rotation[0][i] = q.x;
+    rotation[1][i] = q.y;
+    rotation[2][i] = q.z;
+    rotation[3][i] = q.w;
+    local_dirty[i] = 1;
+}
+
+void SceneStore::SetScale(Entity entity, const glm::vec3& value)
+{
+    unsigned int i = Index(entity);
+    scale[0][i] = value.x;
+    scale[1][i] = value.y;
+    scale[2][i] = value.z;
+    local_dirty[i] = 1;
+}
+
+// every child after its parent: sorted by depth in the hierarchy
+void SceneStore::BuildUpdateOrder()
+{
+    unsigned int count = EntityCount();
+    std::vector<unsigned int> depth(count, NONE);
+    std::vector<unsigned int> chain;
+    unsigned int max_depth = 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        unsigned int k = i;
+        while (depth[k] == NONE && parent[k] != NONE)
+        {
+            chain.push_back(k);
+            k = Index(parent[k]);
+        }
+        if (depth[k] == NONE)
+        {
+            depth[k] = 0;
+        }
+        for (auto it = chain.rbegin(); it != chain.rend(); it++)
+        {
+            depth[*it] = depth[k] + 1;
+            k = *it;
+        }
+        chain.clear();
+        max_depth = std::max(max_depth, depth[i]);
+    }
+
+    update_order.clear();
+    update_parent.clear();
+    update_level_end.clear();
+    for (unsigned int level = 1; level <= max_depth; level++)
+    {
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (depth[i] == level)
+            {
+                update_order.push_back(i);
+                update_parent.push_back(Index(parent[i]));
+            }
+        }
+        update_level_end.push_back(update_order.size());
+    }
+    order_dirty = false;
+}
+
+void SceneStore::UpdateTransforms()
+{
+    unsigned int count = EntityCount();
+    for (unsigned int i = 0; i < count;)
+    {
+        if (!local_dirty[i])
+        {
+            i++;
+            continue;
+        }
+        unsigned int end = i + 1;
+        while (end < count && local_dirty[end])
+        {
+            end++;
+        }
+        TransformKernels::Streams streams = { { &position[0][i], &position[1][i], &position[2][i] },
+                                              { &rotation[0][i], &rotation[1][i], &rotation[2][i], &rotation[3][i] },
+                                              { &scale[0][i], &scale[1][i], &scale[2][i] } };
+        TransformKernels::ComposeTRS(end - i, streams, &local_matrix[i]);
+        i = end;
+    }
+
+    if (order_dirty)
+    {
+        BuildUpdateOrder();
+    }
+    changed.assign(count, 0);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (local_dirty[i] && parent[i] == NONE)
+        {
+            world_matrix[i] = local_matrix[i];
+            world_version[i]++;
+            changed[i] = 1;
+        }
+    }
+    // a level at a time: its parents are all final, so the children to rebuild go through the kernel together
+    size_t begin = 0;
+    for (size_t end : update_level_end)
+    {
+        batch_items.clear();
+        batch_matrices[0].clear();
+        batch_matrices[1].clear();
+        for (size_t k = begin; k < end; k++)
+        {
+            if (local_dirty[update_order[k]] || changed[update_parent[k]])
+            {
+                batch_items.push_back(update_order[k]);
+                batch_matrices[0].push_back(world_matrix[update_parent[k]]);
+                batch_matrices[1].push_back(local_matrix[update_order[k]]);
+            }
+        }
+        begin = end;
+        TransformKernels::MultiplyMatrices(batch_items.size(), batch_matrices[0].data(), batch_matrices[1].data(), batch_matrices[1].data());
+        for (size_t j = 0; j < batch_items.size(); j++)
+        {
+            unsigned int i = batch_items[j];
+            world_matrix[i] = batch_matrices[1][j];
+            world_version[i]++;
+            changed[i] = 1;
+        }
+    }
+    std::fill(local_dirty.begin(), local_dirty.end(), 0);
+}
+
+/*****************************************************
+* Bring mesh bounds from object space to world space
+* and cache the model matrix on each renderer, called
+* once per frame before culling. An entity is only
+* rebuilt when its world matrix or one of its renderers
+* changed. Returns true when a shadow caster moved,
+* appeared or went away since the last call.
+*****************************************************/
+bool SceneStore::UpdateWorldBounds()
+{
+    unsigned int count = EntityCount();
+    rebuild.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        rebuild[i] = world_version[i] != bounds_version[i];
+    }
+    bool shadow_changed = false;
+    for (const MeshRenderer& mr : renderers)
+    {
+        unsigned int i = Index(mr.entity);
+        Mesh* shadow_mesh = mr.cast_shadow ? mr.mesh : nullptr;
+        if (shadow_mesh != mr.shadow_mesh || (shadow_mesh != nullptr && rebuild[i]))
+        {
+            shadow_changed = true;
+            rebuild[i] = 1;
+        }
+    }
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (rebuild[i])
+        {
+            world_bounds[i] = AABB();
+            bounds_version[i] = world_version[i];
+        }
+    }
+    // the boxes of every rebuilt renderer go through the kernel in one call
+    batch_items.clear();
+    batch_matrices[0].clear();
+    batch_bounds.clear();
+    for (unsigned int r = 0; r < renderers.size(); r++)
+    {
+        MeshRenderer& mr = renderers[r];
+        unsigned int i = Index(mr.entity);
+        if (!rebuild[i])
+        {
+            continue;
+        }
+        mr.shadow_mesh = mr.cast_shadow ? mr.mesh : nullptr;
+        mr.model_matrix = world_matrix[i];
+        if (mr.mesh == nullptr)
+        {
+            mr.world_bounds = AABB();
+            mr.world_sphere = BoundingSphere();
+            continue;
+        }
+        mr.world_sphere = mr.mesh->bounding_sphere.Transformed(mr.model_matrix);
+        batch_items.push_back(r);
+        batch_matrices[0].push_back(mr.model_matrix);
+        batch_bounds.push_back(mr.mesh->bounds);
+    }
+    TransformKernels::TransformBounds(batch_items.size(), batch_matrices[0].data(), batch_bounds.data(), batch_bounds.data());
+    for (size_t j = 0; j < batch_items.size(); j++)
+    {
+        MeshRenderer& mr = renderers[batch_items[j]];
+        mr.world_bounds = batch_bounds[j];
+        world_bounds[Index(mr.entity)].Expand(mr.world_bounds);
+    }
+    return shadow_changed;
+}
+
+/*****************************************************
+* A random forest in a store of its own, created in an
+* order unrelated to the depth, every world matrix
+* checked against composing the chain of local
+* transforms with glm. Then some entities are moved,
+* some made roots and some leaves destroyed: exactly
+* the edited ones and everything below them must get a
+* new world_version, the rest keep theirs.
+*****************************************************/
+void SceneStore::Benchmark()
+{
+    RendererConsole::GetInstance()->AddNote("Scene store hierarchy, one core");
+    const unsigned int sizes[] = { 10000, 100000 };
+    for (unsigned int count : sizes)
+    {
+        SceneStore* store = new SceneStore();
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+        // by creation order
+        std::vector<Entity> entities(count);
+        std::vector<unsigned int> parent_of(count, NONE);
+        std::vector<glm::vec3> positions(count), eulers(count), scales(count);
+        for (unsigned int k = 0; k < count; k++)
+        {
+            entities[k] = store->CreateEntity();
+            positions[k] = glm::vec3(unit(random), unit(random), unit(random)) * 10.0f;
+            eulers[k] = glm::vec3(unit(random), unit(random), unit(random)) * 180.0f;
+            scales[k] = glm::vec3(1.0f) + glm::vec3(unit(random), unit(random), unit(random)) * 0.1f;
+            store->SetPosition(entities[k], positions[k]);
+            store->SetRotation(entities[k], eulers[k]);
+            store->SetScale(entities[k], scales[k]);
+        }
+        // most entities go below one ranked before them, the ranks shuffled against creation order
+        std::vector<unsigned int> rank(count);
+        std::iota(rank.begin(), rank.end(), 0);
+        std::shuffle(rank.begin(), rank.end(), random);
+        for (unsigned int r = 1; r < count; r++)
+        {
+            if (unit(random) < 0.6f)
+            {
+                parent_of[rank[r]] = rank[random() % r];
+                store->SetParent(entities[rank[r]], entities[parent_of[rank[r]]]);
+            }
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        store->UpdateTransforms();
+        float full_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        // parents first by rank, so reference[parent] is ready for its children
+        std::vector<glm::mat4> reference(count);
+        std::vector<unsigned int> depth(count, 0);
+        auto check = [&]()
+        {
+            float error = 0;
+            for (unsigned int k : rank)
+            {
+                if (!store->Alive(entities[k]))
+                {
+                    continue;
+                }
+                glm::mat4 local = glm::translate(glm::mat4(1.0f), positions[k]) * glm::mat4_cast(glm::quat(glm::radians(eulers[k]))) * glm::scale(glm::mat4(1.0f), scales[k]);
+                reference[k] = parent_of[k] == NONE ? local : reference[parent_of[k]] * local;
+                depth[k] = parent_of[k] == NONE ? 0 : depth[parent_of[k]] + 1;
+                const glm::mat4& world = store->world_matrix[store->Index(entities[k])];
+                for (int c = 0; c < 4; c++)
+                {
+                    for (int r = 0; r < 4; r++)
+                    {
+                        error = std::max(error, std::abs(world[c][r] - reference[k][c][r]) / std::max(1.0f, std::abs(reference[k][c][r])));
+                    }
+                }
+            }
+            return error;
+        };
+        float full_error = check();
+        unsigned int max_depth = *std::max_element(depth.begin(), depth.end());
+
+        std::vector<unsigned int> versions(count);
+        for (unsigned int k = 0; k < count; k++)
+        {
+            versions[k] = store->world_version[store->Index(entities[k])];
+        }
+        std::vector<unsigned char> edited(count, 0);
+        for (unsigned int e = 0; e < count / 100; e++)
+        {
+            unsigned int k = random() % count;
+            edited[k] = 1;
+            if (e % 4 == 0 && parent_of[k] != NONE)
+            {
+                parent_of[k] = NONE;
+                store->SetParent(entities[k], NONE);
+            }
+            else
+            {
+                positions[k] += glm::vec3(unit(random), unit(random), unit(random));
+                store->SetPosition(entities[k], positions[k]);
+            }
+        }
+        std::vector<unsigned int> child_count(count, 0);
+        for (unsigned int k = 0; k < count; k++)
+        {
+            if (parent_of[k] != NONE)
+            {
+                child_count[parent_of[k]]++;
+            }
+        }
+        for (unsigned int e = 0; e < count / 100; e++)
+        {
+            unsigned int k = random() % count;
+            if (!edited[k] && child_count[k] == 0 && store->Alive(entities[k]))
+            {
+                if (parent_of[k] != NONE)
+                {
+                    child_count[parent_of[k]]--;
+                }
+                store->DestroyEntity(entities[k]);
+            }
+        }
+
+        start = std::chrono::high_resolution_clock::now();
+        store->UpdateTransforms();
+        float edit_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        unsigned int rebuilt = 0, wrong = 0;
+        std::vector<unsigned char> below_edit(count, 0);
+        for (unsigned int k : rank)
+        {
+            if (!store->Alive(entities[k]))
+            {
+                continue;
+            }
+            below_edit[k] = edited[k] || (parent_of[k] != NONE && below_edit[parent_of[k]]);
+            bool bumped = store->world_version[store->Index(entities[k])] != versions[k];
+            rebuilt += bumped;
+            wrong += bumped != (below_edit[k] != 0);
+        }
+        float edit_error = check();
+
+        RendererConsole::GetInstance()->AddNote("  %6u entities, depth %2u: all %7.3f ms, 1%% edited %7.3f ms, %u rebuilt, %u wrongly, max error %.1e",
+            count, max_depth, full_ms, edit_ms, rebuilt, wrong, std::max(full_error, edit_error));
+        delete store;
+    }
+}
+
+Handle SceneStore::AddRenderer(Entity entity, Material* material, Mesh* mesh)
+{
+    Handle id = renderer_ids.Add();
+    if (id == NONE)
+    {
+        return NONE;
+    }
+    renderers.emplace_back(material, mesh);
+    renderers.back().entity = entity;
+    unsigned int i = Index(entity);
+    renderer_count[i]++;
+    bounds_version[i] = 0;
+    return id;
+}
+
+void SceneStore::RemoveRenderer(Handle id)
+{
+    if (!renderer_ids.Alive(id))
+    {
+        return;
+    }
+    unsigned int dense = renderer_ids.Dense(id);
+    unsigned int i = Index(renderers[dense].entity);
+    renderer_count[i]--;
+    bounds_version[i] = 0;
+    // the renderer moved into the gap frees its material on the way
+    SwapRemove(renderers, dense);
+    renderer_ids.Remove(id);
+}
+
+void SceneStore::AddLight(Entity entity)
+{
+    LightComponent light;
+    light.entity = entity;
+    lights.push_back(light);
+}
+
+LightComponent* SceneStore::GetLight(Entity entity)
+{
+    for (LightComponent& light : lights)
+    {
+        if (light.entity == entity)
+        {
+            return &light;
+        }
+    }
+    return nullptr;
+}
+
+glm::vec3 EntityTransform::Position() const
+{
+    SceneStore* store = SceneStore::GetInstance();
+    unsigned int i = store->Index(entity);
+    return glm::vec3(store->position[0][i], store->position[1][i], store->position[2][i]);
+}
+
+glm::vec3 EntityTransform::Rotation() const
+{
+    SceneStore* store = SceneStore::GetInstance();
+    return store->euler[store->Index(entity)];
+}
+
+glm::vec3 EntityTransform::Scale() const
+{
+    SceneStore* store = SceneStore::GetInstance();
+    unsigned int i = store->Index(entity);
+    return glm::vec3(store->scale[0][i], store->scale[1][i], store->scale[2][i]);
+}
+
+// the axes of the world matrix, a zero scale falls back to the local rotation alone
+glm::vec3 EntityTransform::GetFront() const
+{
+    glm::mat4 rot = glm::mat4_cast(glm::quat(glm::radians(Rotation())));
+    return Direction(glm::vec3(GetTransformMatrix()[2]), glm::vec3(rot[2]));
+}
+
+glm::vec3 EntityTransform::GetUp() const
+{
+    glm::mat4 rot = glm::mat4_cast(glm::quat(glm::radians(Rotation())));
+    return Direction(glm::vec3(GetTransformMatrix()[1]), glm::vec3(rot[1]));
+}
+
+glm::vec3 EntityTransform::GetRight() const
+{
+    return glm::normalize(glm::cross(GetFront(), GetUp()));
+}
+
+const glm::mat4& EntityTransform::GetTransformMatrix() const
+{
+    SceneStore* store = SceneStore::GetInstance();
+    return store->world_matrix[store->Index(entity)];
+}
+
+unsigned int EntityTransform::Version() const
+{
+    SceneStore* store = SceneStore::GetInstance();
+    return store->world_version[store->Index(entity)];
+}
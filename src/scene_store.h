@@ -0,0 +1,156 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "bounds.h"
+#include "mesh.h"
+#include "singleton_util.h"
+#include "slot_map.h"
+
+typedef Handle Entity;
+
+enum class LightType
+{
+    DIRECTIONAL = 0, POINT
+};
+
+struct LightComponent
+{
+    Entity      entity;
+    glm::vec3   color = glm::vec3(1);
+    float       intensity = 10;
+    LightType   type = LightType::DIRECTIONAL;
+};
+
+/*****************************************************
+* Components of every scene object, one contiguous
+* array per field so the per-frame loops walk memory
+* in order instead of chasing an object per entity:
+*
+*   transforms  position, rotation and scale, local
+*               and world matrices, parent, [Index(e)]
+*   bounds      world bounds of each entity's renderers
+*               together, [Index(e)]
+*   renderers   mesh, material and what the passes
+*               derive from them every frame
+*   lights      color, intensity, type
+*
+* SceneObject and the attribute panels hold handles
+* into this and nothing else. Removal fills the gap
+* with the last element, so indices and MeshRenderer
+* pointers only hold until the next add or remove,
+* handles for good and go stale with their entity or
+* renderer (see HandleTable).
+*
+* UpdateTransforms composes the local matrix of every
+* edited transform with TransformKernels, a run of
+* neighbours per call, then walks the children parents
+* first, so a world matrix is only rebuilt below an
+* edit, a hierarchy level per MultiplyMatrices call.
+* world_version counts the rebuilds, which is all
+* UpdateWorldBounds needs to skip entities at rest; the
+* boxes it does rebuild go through one TransformBounds.
+*****************************************************/
+class SceneStore : public Singleton<SceneStore>
+{
+public:
+    static const Handle NONE = HandleTable::NONE;
+
+    // entities, every one has a transform and bounds
+    Entity          CreateEntity();
+    // children must be unparented first, renderers removed
+    void            DestroyEntity(Entity entity);
+    bool            Alive(Entity entity) const { return entity_ids.Alive(entity); }
+    unsigned int    EntityCount() const { return entity_ids.Size(); }
+    // no check, for live entities
+    unsigned int    Index(Entity entity) const { return entity_ids.Dense(entity); }
+    // NONE makes it a root, the local transform is kept
+    void            SetParent(Entity entity, Entity new_parent);
+    void            SetPosition(Entity entity, const glm::vec3& value);
+    void            SetRotation(Entity entity, const glm::vec3& euler_degrees);
+    void            SetScale(Entity entity, const glm::vec3& value);
+
+    // once per frame before rendering
+    void            UpdateTransforms();
+    // renderer and entity world bounds of what moved, true if anything the shadow maps depend on changed
+    bool            UpdateWorldBounds();
+    // rebuild the entity's bounds on the next UpdateWorldBounds even if it stayed put
+    void            InvalidateBounds(Entity entity) { bounds_version[Index(entity)] = 0; }
+    // check UpdateTransforms on random hierarchies of 10k and 100k entities in a store of its own, log to the console
+    static void     Benchmark();
+
+    // renderers, the store owns them and their materials
+    Handle          AddRenderer(Entity entity, Material* material, Mesh* mesh);
+    void            RemoveRenderer(Handle renderer);
+    // nullptr for a stale handle
+    MeshRenderer*   GetRenderer(Handle renderer) { return renderer_ids.Alive(renderer) ? &renderers[renderer_ids.Dense(renderer)] : nullptr; }
+
+    // lights, at most one per entity
+    void            AddLight(Entity entity);
+    LightComponent* GetLight(Entity entity);
+
+    // transforms
+    std::vector<float>          position[3];
+    std::vector<float>          rotation[4];        // unit quaternion x, y, z, w
+    std::vector<float>          scale[3];
+    std::vector<glm::vec3>      euler;              // the rotation as edited, degrees
+    std::vector<glm::mat4>      local_matrix;
+    std::vector<glm::mat4>      world_matrix;
+    std::vector<unsigned int>   world_version;      // bumped by every new world matrix, the first is 1
+    std::vector<Entity>         parent;             // NONE for a root
+    std::vector<unsigned char>  local_dirty;
+    // bounds
+    std::vector<AABB>           world_bounds;       // union of the entity's renderers
+    std::vector<unsigned int>   bounds_version;     // world_version the bounds were built at
+    std::vector<unsigned int>   renderer_count;
+    // the rest in no particular order
+    std::vector<MeshRenderer>   renderers;
+    std::vector<LightComponent> lights;
+
+private:
+    void BuildUpdateOrder();
+
+    HandleTable                 entity_ids;
+    HandleTable                 renderer_ids;
+    std::vector<unsigned int>   update_order;       // every child's index, parents before children
+    std::vector<unsigned int>   update_parent;      // and its parent's
+    std::vector<size_t>         update_level_end;   // where each level of the hierarchy ends in update_order
+    bool                        order_dirty = false;
+    std::vector<unsigned char>  changed;            // scratch for UpdateTransforms
+    std::vector<unsigned char>  rebuild;            // scratch for UpdateWorldBounds
+    std::vector<unsigned int>   batch_items;        // scratch for both: the entities or renderers in a kernel call
+    std::vector<glm::mat4>      batch_matrices[2];  // and their matrices in
+    std::vector<AABB>           batch_bounds;       // their boxes in and out
+};
+
+/*****************************************************
+* The transform of a scene entity, read and written in
+* place in the SceneStore, with the interface of
+* Transform. Setters take effect on the world side at
+* the next SceneStore::UpdateTransforms.
+*****************************************************/
+class EntityTransform
+{
+public:
+    EntityTransform(Entity _entity = SceneStore::NONE) : entity(_entity) {}
+
+    void SetPosition(float x, float y, float z)             { SceneStore::GetInstance()->SetPosition(entity, glm::vec3(x, y, z)); }
+    void SetRotation(float pitch, float yaw, float roll)    { SceneStore::GetInstance()->SetRotation(entity, glm::vec3(pitch, yaw, roll)); }
+    void SetScale(float x, float y, float z)                { SceneStore::GetInstance()->SetScale(entity, glm::vec3(x, y, z)); }
+
+    // local values, relative to the parent
+    glm::vec3 Position() const;
+    glm::vec3 Rotation() const;
+    glm::vec3 Scale() const;
+    glm::vec3 WorldPosition() const { return glm::vec3(GetTransformMatrix()[3]); }
+
+    // world space directions
+    glm::vec3 GetFront() const;
+    glm::vec3 GetRight() const;
+    glm::vec3 GetUp() const;
+
+    // local to world
+    const glm::mat4& GetTransformMatrix() const;
+    unsigned int Version() const;
+
+    Entity entity;
+};
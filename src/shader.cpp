@@ -1,3 +1,82 @@
+#include <cstring>
+
 #include "shader.h"
 
-std::map<std::string, Shader*> Shader::LoadedShaders;
\ No newline at end of file
+std::map<std::string, Shader*> Shader::LoadedShaders;
+SlotMap<Shader*> Shader::Registry;
+unsigned int Shader::UniformVersions = 0;
+
+Shader* Shader::Get(Handle handle)
+{
+    Shader** shader = Registry.Get(handle);
+    return shader != nullptr ? *shader : nullptr;
+}
+
+/*****************************************************
+* Reflect every active uniform after link. Members of
+* uniform blocks have no location and are skipped.
+* Array elements are registered as "name[i]", element 0
+* also as the plain "name".
+*****************************************************/
+void Shader::ReflectUniforms()
+{
+    uniforms.clear();
+    uniform_table.clear();
+    uniform_version = ++UniformVersions;
+
+    int count = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    char name_buffer[256];
+    for (int i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, i, sizeof(name_buffer), &length, &size, &type, name_buffer);
+        int location = glGetUniformLocation(ID, name_buffer);
+        if (location < 0)
+        {
+            continue;
+        }
+
+        std::string name(name_buffer, length);
+        std::string base = name;
+        bool is_array = base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0;
+        if (is_array)
+        {
+            base = base.substr(0, base.size() - 3);
+        }
+        for (int e = 0; e < size; e++)
+        {
+            UniformSlot slot;
+            slot.location = (e == 0) ? location : glGetUniformLocation(ID, (base + "[" + std::to_string(e) + "]").c_str());
+            slot.type = type;
+            UniformHandle handle = (UniformHandle)uniforms.size();
+            uniforms.push_back(slot);
+            if (is_array)
+            {
+                uniform_table[base + "[" + std::to_string(e) + "]"] = handle;
+            }
+            if (e == 0)
+            {
+                uniform_table[base] = handle;
+            }
+        }
+    }
+}
+
+bool Shader::UpdateCache(UniformHandle handle, const void* data, size_t size) const
+{
+    if (handle < 0 || handle >= (int)uniforms.size())
+    {
+        return false;
+    }
+    UniformSlot& slot = uniforms[handle];
+    if (slot.cached && memcmp(slot.value, data, size) == 0)
+    {
+        return false;
+    }
+    memcpy(slot.value, data, size);
+    slot.cached = true;
+    return true;
+}
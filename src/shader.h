@@ -3,6 +3,8 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <map>
+#include <string_view>
+#include <vector>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -10,6 +12,26 @@
 #include <filesystem>
 
 #include "renderer_console.h"
+#include "uniform_buffer.h"
+#include "gl_state.h"
+#include "slot_map.h"
+
+// Index into Shader::uniforms, resolved once and reused for every set call.
+// Only valid for the program it was resolved from, -1 means "not active".
+typedef int UniformHandle;
+
+/*****************************************************
+* One active uniform reflected after link, with a
+* shadow copy of the last value sent so setting the
+* same value again skips the GL call.
+*****************************************************/
+struct UniformSlot
+{
+    int             location;
+    unsigned int    type;
+    bool            cached = false;
+    unsigned char   value[64];      // big enough for a mat4
+};
 
 class Shader
 {
@@ -19,7 +41,14 @@ public:
     std::string fragmentPath;
     std::string geometryPath;
     std::string name;
+    Handle handle;
+    // new on every link and never reused, unlike ID which GL may hand out again after a reload
+    unsigned int uniform_version = 0;
     static std::map<std::string, Shader *> LoadedShaders;
+    // every live shader by handle, materials keep handles and find out when one is removed
+    static SlotMap<Shader *> Registry;
+    // nullptr for a stale handle
+    static Shader* Get(Handle handle);
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
 	Shader(std::filesystem::path _vertexPath, std::filesystem::path _fragmentPath, bool _is_editor = false, std::filesystem::path _geometrtPath = "") : is_editor(_is_editor)
@@ -41,6 +70,7 @@ public:
         vertexPath = vert_str;
         fragmentPath = frag_str;
         geometryPath = geo_str;
+        handle = Registry.Insert(this);
     }
 
 	Shader(const char* _vertexPath, const char* _fragmentPath, bool _is_editor = false, const char* _geometryPath = nullptr) : is_editor(_is_editor)
@@ -62,12 +92,14 @@ public:
         vertexPath = vert_str;
         fragmentPath = frag_str;
         geometryPath = geo_str;
+        handle = Registry.Insert(this);
     }
 
     ~Shader()
     {
         DeleteShader();
         LoadedShaders.erase(name);
+        Registry.Remove(handle);
     }
 
     bool IsValid() { return is_valid;   }
@@ -171,6 +203,8 @@ public:
         glAttachShader(ID, fragment_shader);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        UniformBuffer::BindBlocks(ID);
+        ReflectUniforms();
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex_shader);
         glDeleteShader(fragment_shader);
@@ -189,65 +223,119 @@ public:
     // ------------------------------------------------------------------------
     void use()
     {
-        glUseProgram(ID);
+        GLState::GetInstance()->UseProgram(ID);
+    }
+    // uniform reflection
+    // ------------------------------------------------------------------------
+    UniformHandle GetUniformHandle(std::string_view name) const
+    {
+        auto it = uniform_table.find(name);
+        return it != uniform_table.end() ? it->second : -1;
+    }
+    // utility uniform functions, by handle
+    // ------------------------------------------------------------------------
+    void setBool(UniformHandle handle, bool value) const
+    {
+        setInt(handle, (int)value);
+    }
+    void setInt(UniformHandle handle, int value) const
+    {
+        if (UpdateCache(handle, &value, sizeof(value)))
+            glUniform1i(uniforms[handle].location, value);
+    }
+    void setFloat(UniformHandle handle, float value) const
+    {
+        if (UpdateCache(handle, &value, sizeof(value)))
+            glUniform1f(uniforms[handle].location, value);
     }
-    // utility uniform functions
+    void setVec2(UniformHandle handle, const glm::vec2 &value) const
+    {
+        if (UpdateCache(handle, &value[0], sizeof(value)))
+            glUniform2fv(uniforms[handle].location, 1, &value[0]);
+    }
+    void setVec3(UniformHandle handle, const glm::vec3 &value) const
+    {
+        if (UpdateCache(handle, &value[0], sizeof(value)))
+            glUniform3fv(uniforms[handle].location, 1, &value[0]);
+    }
+    void setVec4(UniformHandle handle, const glm::vec4 &value) const
+    {
+        if (UpdateCache(handle, &value[0], sizeof(value)))
+            glUniform4fv(uniforms[handle].location, 1, &value[0]);
+    }
+    void setMat2(UniformHandle handle, const glm::mat2 &mat) const
+    {
+        if (UpdateCache(handle, &mat[0][0], sizeof(mat)))
+            glUniformMatrix2fv(uniforms[handle].location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat3(UniformHandle handle, const glm::mat3 &mat) const
+    {
+        if (UpdateCache(handle, &mat[0][0], sizeof(mat)))
+            glUniformMatrix3fv(uniforms[handle].location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(UniformHandle handle, const glm::mat4 &mat) const
+    {
+        if (UpdateCache(handle, &mat[0][0], sizeof(mat)))
+            glUniformMatrix4fv(uniforms[handle].location, 1, GL_FALSE, &mat[0][0]);
+    }
+    // utility uniform functions, by name (one lookup without a string copy, no GL query),
+    // hot paths resolve a handle once and use the setters above
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(std::string_view name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        setBool(GetUniformHandle(name), value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(std::string_view name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        setInt(GetUniformHandle(name), value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(std::string_view name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        setFloat(GetUniformHandle(name), value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(std::string_view name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec2(GetUniformHandle(name), value);
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(std::string_view name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        setVec2(GetUniformHandle(name), glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(std::string_view name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec3(GetUniformHandle(name), value);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(std::string_view name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        setVec3(GetUniformHandle(name), glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(std::string_view name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec4(GetUniformHandle(name), value);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) const
+    void setVec4(std::string_view name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        setVec4(GetUniformHandle(name), glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(std::string_view name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat2(GetUniformHandle(name), mat);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(std::string_view name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(GetUniformHandle(name), mat);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(std::string_view name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(GetUniformHandle(name), mat);
     }
 
 private:
@@ -281,9 +369,18 @@ private:
     void DeleteShader()
     {
         RendererConsole::GetInstance()->AddLog("Remove Shader: [vert] %s [frag] %s", vertexPath.c_str(), fragmentPath.c_str());
-        glDeleteProgram(ID);
+        GLState::GetInstance()->DeleteProgram(ID);
     }
 
+    // fill uniform_table from the active uniforms of the linked program
+    void ReflectUniforms();
+    // compare against the shadow copy, returns true if the GL call is needed
+    bool UpdateCache(UniformHandle handle, const void* data, size_t size) const;
+
     bool is_valid = false;
     bool is_editor = false;
+    mutable std::vector<UniformSlot>                    uniforms;
+    // transparent compare, so a name is looked up without building a std::string
+    std::map<std::string, UniformHandle, std::less<>>   uniform_table;
+    static unsigned int                                 UniformVersions;
 };
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <unordered_map>
+
+#include "slot_map.h"
+#include "editor_resource.h"
+#include "renderer_console.h"
+
+const Handle HandleTable::NONE;
+const unsigned int HandleTable::INDEX_MASK;
+const unsigned int HandleTable::MAX_SLOTS;
+
+Handle HandleTable::Add()
+{
+    unsigned int index;
+    if (free_count > MIN_FREE || (free_count > 0 && slots.size() >= MAX_SLOTS))
+    {
+        index = free_head;
+        free_head = slots[index].dense;
+        if (--free_count == 0)
+        {
+            free_tail = NONE;
+        }
+    }
+    else if (slots.size() < MAX_SLOTS)
+    {
+        index = (unsigned int)slots.size();
+        slots.push_back({ NONE, 0 });
+    }
+    else
+    {
+        return NONE;
+    }
+    Handle handle = (slots[index].generation << INDEX_BITS) | index;
+    slots[index].dense = (unsigned int)handles.size();
+    handles.push_back(handle);
+    return handle;
+}
+
+void HandleTable::Remove(Handle handle)
+{
+    unsigned int index = handle & INDEX_MASK;
+    unsigned int dense = slots[index].dense;
+    handles[dense] = handles.back();
+    slots[handles[dense] & INDEX_MASK].dense = dense;
+    handles.pop_back();
+
+    // stale from here on, and queued behind the slots freed before it
+    slots[index].generation = (slots[index].generation + 1) & GENERATION_MASK;
+    slots[index].dense = NONE;
+    if (free_tail != NONE)
+    {
+        slots[free_tail].dense = index;
+    }
+    else
+    {
+        free_head = index;
+    }
+    free_tail = index;
+    free_count++;
+}
+
+bool HandleTable::Alive(Handle handle) const
+{
+    unsigned int index = handle & INDEX_MASK;
+    return handle != NONE && index < slots.size() &&
+           slots[index].generation == (handle >> INDEX_BITS) &&
+           slots[index].dense < handles.size() && handles[slots[index].dense] == handle;
+}
+
+/*****************************************************
+* Rounds of inserts, lookups and removes of random
+* live entries over one SlotMap, the same through a
+* std::unordered_map keyed by a counter to compare.
+* Every live handle must find its own value, every
+* removed one must be stale. Then the reference
+* counting of EditorResource.
+*****************************************************/
+void HandleTable::Benchmark()
+{
+    RendererConsole::GetInstance()->AddNote("Handles, one core");
+    // a quarter of each round's inserts stays, so the live set grows while slots are recycled
+    const unsigned int rounds = 200, batch = 5000, removes = batch * 3 / 4;
+    std::mt19937 random(1234);
+
+    SlotMap<unsigned int> map;
+    std::vector<std::pair<Handle, unsigned int>> live;
+    std::vector<Handle> removed;
+    unsigned int next_value = 0, wrong = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int round = 0; round < rounds; round++)
+    {
+        for (unsigned int i = 0; i < batch; i++)
+        {
+            live.push_back({ map.Insert(next_value), next_value });
+            next_value++;
+        }
+        for (unsigned int i = 0; i < batch; i++)
+        {
+            const auto& entry = live[random() % live.size()];
+            const unsigned int* value = map.Get(entry.first);
+            wrong += value == nullptr || *value != entry.second;
+        }
+        for (unsigned int i = 0; i < removes; i++)
+        {
+            std::swap(live[random() % live.size()], live.back());
+            wrong += !map.Remove(live.back().first);
+            if (removed.size() < 100000)
+            {
+                removed.push_back(live.back().first);
+            }
+            live.pop_back();
+        }
+    }
+    float map_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    for (const auto& entry : live)
+    {
+        const unsigned int* value = map.Get(entry.first);
+        wrong += value == nullptr || *value != entry.second;
+    }
+    for (unsigned int dense = 0; dense < map.Size(); dense++)
+    {
+        wrong += map.Get(map.HandleAt(dense)) != &map[dense];
+    }
+    unsigned int stale = 0;
+    for (Handle handle : removed)
+    {
+        stale += !map.Contains(handle) && !map.Remove(handle);
+    }
+
+    std::unordered_map<unsigned int, unsigned int> reference;
+    std::vector<unsigned int> reference_live;
+    next_value = 0;
+    random.seed(1234);
+    start = std::chrono::high_resolution_clock::now();
+    for (unsigned int round = 0; round < rounds; round++)
+    {
+        for (unsigned int i = 0; i < batch; i++)
+        {
+            reference[next_value] = next_value;
+            reference_live.push_back(next_value);
+            next_value++;
+        }
+        for (unsigned int i = 0; i < batch; i++)
+        {
+            unsigned int key = reference_live[random() % reference_live.size()];
+            auto it = reference.find(key);
+            wrong += it == reference.end() || it->second != key;
+        }
+        for (unsigned int i = 0; i < removes; i++)
+        {
+            std::swap(reference_live[random() % reference_live.size()], reference_live.back());
+            reference.erase(reference_live.back());
+            reference_live.pop_back();
+        }
+    }
+    float reference_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    RendererConsole::GetInstance()->AddNote("  SlotMap: %u inserts and removes, %u lookups, %.1f ms (unordered_map %.1f ms), %u live, %u/%zu removed handles stale, %u wrong",
+        rounds * (batch + removes), rounds * batch, map_ms, reference_ms, map.Size(), stale, removed.size(), wrong);
+
+    // a referrer added twice stays until removed twice, removal keeps the rest in place
+    EditorResource<int*> resource;
+    int a, b, c;
+    resource.AddRef(&a);
+    resource.AddRef(&b);
+    resource.AddRef(&a);
+    resource.AddRef(&c);
+    bool valid = resource.references.size() == 3;
+    resource.RemoveRef(&a);
+    valid &= resource.references.size() == 3;
+    resource.RemoveRef(&a);
+    valid &= resource.references.size() == 2;
+    resource.RemoveRef(&b);
+    valid &= resource.references.size() == 1 && resource.references[0] == &c;
+    resource.RemoveRef(&b);
+    resource.RemoveRef(&c);
+    valid &= resource.references.empty();
+    RendererConsole::GetInstance()->AddNote("  EditorResource reference counts: %s", valid ? "valid" : "BROKEN");
+}
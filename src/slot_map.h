@@ -0,0 +1,113 @@
+#pragma once
+#include <vector>
+#include <utility>
+
+// 20 bits of slot index under 12 bits of generation
+typedef unsigned int Handle;
+
+/*****************************************************
+* Generational handles over dense arrays. Add gives a
+* new handle whose element goes at the end of the
+* arrays, removing moves the last element into the gap
+* and Remove follows it, so insert, remove and lookup
+* are O(1) and the arrays stay packed however many
+* objects come and go.
+*
+* A handle is the slot index plus the generation the
+* slot had when it was handed out. Remove bumps the
+* generation, so a handle kept past its object's
+* removal fails Alive() instead of reaching whatever
+* took the slot. Freed slots are reused oldest first
+* and only once MIN_FREE of them wait, a slot has to
+* be freed 4096 times before one of its old handles
+* could pass for a live one again.
+*****************************************************/
+class HandleTable
+{
+public:
+    static const Handle         NONE = 0xFFFFFFFF;
+    static const unsigned int   INDEX_BITS = 20;
+    static const unsigned int   INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static const unsigned int   GENERATION_MASK = 0xFFFFFFFF >> INDEX_BITS;
+    static const unsigned int   MIN_FREE = 1024;
+    // the last index is never used, so no handle equals NONE
+    static const unsigned int   MAX_SLOTS = INDEX_MASK;
+
+    // a new handle, its dense index is Size() - 1, NONE once MAX_SLOTS are alive
+    Handle          Add();
+    // call after moving the last element of the arrays into Dense(handle) and popping it
+    void            Remove(Handle handle);
+    bool            Alive(Handle handle) const;
+    // no check, for handles known to be alive
+    unsigned int    Dense(Handle handle) const  { return slots[handle & INDEX_MASK].dense; }
+    Handle          At(unsigned int dense) const { return handles[dense]; }
+    unsigned int    Size() const                { return (unsigned int)handles.size(); }
+
+    // churn a SlotMap against std::unordered_map, check stale handles and EditorResource counts, log to the console
+    static void     Benchmark();
+
+private:
+    struct Slot
+    {
+        unsigned int dense;         // next free slot while free
+        unsigned int generation;
+    };
+    std::vector<Slot>   slots;
+    std::vector<Handle> handles;    // by dense index
+    unsigned int        free_head = NONE;
+    unsigned int        free_tail = NONE;
+    unsigned int        free_count = 0;
+};
+
+/*****************************************************
+* Values kept packed in one array and found through
+* generational handles, see HandleTable. Iterating
+* walks the values in dense order, which a removal
+* changes.
+*****************************************************/
+template <class T>
+class SlotMap
+{
+public:
+    Handle Insert(T value)
+    {
+        Handle handle = table.Add();
+        if (handle != HandleTable::NONE)
+        {
+            values.push_back(std::move(value));
+        }
+        return handle;
+    }
+
+    // false for a stale handle
+    bool Remove(Handle handle)
+    {
+        if (!table.Alive(handle))
+        {
+            return false;
+        }
+        unsigned int dense = table.Dense(handle);
+        if (dense + 1 < values.size())
+        {
+            values[dense] = std::move(values.back());
+        }
+        values.pop_back();
+        table.Remove(handle);
+        return true;
+    }
+
+    // nullptr for a stale handle
+    T* Get(Handle handle)               { return table.Alive(handle) ? &values[table.Dense(handle)] : nullptr; }
+    const T* Get(Handle handle) const   { return table.Alive(handle) ? &values[table.Dense(handle)] : nullptr; }
+    bool Contains(Handle handle) const  { return table.Alive(handle); }
+
+    unsigned int Size() const                   { return table.Size(); }
+    T& operator[](unsigned int dense)           { return values[dense]; }
+    Handle HandleAt(unsigned int dense) const   { return table.At(dense); }
+    typename std::vector<T>::iterator begin()   { return values.begin(); }
+    typename std::vector<T>::iterator end()     { return values.end(); }
+
+private:
+    HandleTable     table;
+    std::vector<T>  values;
+};
@@ -10,14 +10,23 @@
 #include "material.h"
 #include "texture.h"
 #include "renderer_console.h"
+#include "gl_state.h"
 
 std::map<std::string, Texture2D *> Texture2D::LoadedTextures;
+SlotMap<Texture2D *> Texture2D::Registry;
+
+Texture2D *Texture2D::Get(Handle handle)
+{
+    Texture2D **texture = Registry.Get(handle);
+    return texture != nullptr ? *texture : nullptr;
+}
 
 Texture2D::Texture2D(std::string _path, ETexType type,  bool _is_editor) : 
     path(_path),
     tex_type(type),
     is_editor(_is_editor)
 {
+    handle = Registry.Insert(this);
     is_valid = LoadTexture2D(path.c_str(), type);
 }
 
@@ -26,6 +35,7 @@ Texture2D::Texture2D(const char *_path, ETexType type,  bool _is_editor) :
     tex_type(type),
     is_editor(_is_editor)
 {
+    handle = Registry.Insert(this);
     is_valid = LoadTexture2D(path.c_str(), type);
 }
 
@@ -34,42 +44,110 @@ Texture2D::Texture2D(std::filesystem::path _path, ETexType type, bool _is_editor
     tex_type(type),
     is_editor(_is_editor)
 {
+    handle = Registry.Insert(this);
     is_valid = LoadTexture2D(path.c_str(), type);
 }
 
+Texture2D::Texture2D(const TextureImage& image, ETexType type, bool _is_editor) :
+    path(image.path),
+    tex_type(type),
+    is_editor(_is_editor)
+{
+    handle = Registry.Insert(this);
+    is_valid = UploadTexture2D(image, type);
+}
+
 Texture2D::~Texture2D()
 {
     DeleteTexture2D();
     LoadedTextures.erase(name);
+    Registry.Remove(handle);
 }
 
 void Texture2D::DeleteTexture2D()
 {
     RendererConsole::GetInstance()->AddLog("Delete Texture: %s", path.c_str());
-    for (auto it : textureRefs.references)
+    // each material drops its reference on the way, so walk a copy
+    vector<Material*> refs = textureRefs.references;
+    for (auto it : refs)
     {
         it->OnTextureRemoved(this);
     }
     
-    glDeleteTextures(1, &id);
+    GLState::GetInstance()->DeleteTexture(id);
+}
+
+bool Texture2D::DecodeImage(const std::string& path, TextureImage& image)
+{
+    image.path = path;
+    std::replace(image.path.begin(), image.path.end(), '\\', '/');
+    image.data = stbi_load(image.path.c_str(), &image.width, &image.height, &image.nrChannels, 0);
+    return image.data != nullptr;
+}
+
+bool Texture2D::DecodeImage(const unsigned char* bytes, size_t size, const std::string& path, TextureImage& image)
+{
+    image.path = path;
+    image.data = stbi_load_from_memory(bytes, (int)size, &image.width, &image.height, &image.nrChannels, 0);
+    return image.data != nullptr;
+}
+
+bool Texture2D::ExtractChannel(const TextureImage& image, int channel, TextureImage& result)
+{
+    result.path = image.path;
+    if (image.data == nullptr)
+    {
+        return false;
+    }
+    size_t pixel_count = (size_t)image.width * image.height;
+    // STBI_MALLOC, so FreeImage releases it like any decoded image
+    result.data = (unsigned char*)STBI_MALLOC(pixel_count);
+    if (result.data == nullptr)
+    {
+        return false;
+    }
+    result.width = image.width;
+    result.height = image.height;
+    result.nrChannels = 1;
+    for (size_t i = 0; i < pixel_count; i++)
+    {
+        result.data[i] = channel < image.nrChannels ? image.data[i * image.nrChannels + channel] : 255;
+    }
+    return true;
+}
+
+void Texture2D::FreeImage(TextureImage& image)
+{
+    stbi_image_free(image.data);
+    image.data = nullptr;
 }
 
 bool Texture2D::LoadTexture2D(const char *path, ETexType type)
 {
-    int width, height, nrComponents;
+    TextureImage image;
+    DecodeImage(path, image);
+    bool loaded = UploadTexture2D(image, type);
+    FreeImage(image);
+    return loaded;
+}
+
+bool Texture2D::UploadTexture2D(const TextureImage& image, ETexType type)
+{
+    int width = image.width, height = image.height, nrComponents = image.nrChannels;
     glGenTextures(1, &this->id);
-    glBindTexture(GL_TEXTURE_2D, this->id);
+    GLState::GetInstance()->BindTexture(GL_TEXTURE_2D, this->id);
     // 为当前绑定的纹理对象设置环绕、过滤方式
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    std::string path_s = path;
-    std::replace(path_s.begin(), path_s.end(), '\\', '/');
-    unsigned char *data = stbi_load(path_s.c_str(), &width, &height, &nrComponents, 0);
+    const std::string& path_s = image.path;
+    const unsigned char *data = image.data;
     if (data)
     {
         GLenum format;
+        // rows of single channel and RGB images aren't padded to 4 bytes
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
         this->path = path_s;
         this->width = width;
         this->height = height;
@@ -114,12 +192,10 @@ bool Texture2D::LoadTexture2D(const char *path, ETexType type)
     else
     {
         RendererConsole::GetInstance()->AddWarn("Failed to load texture at:  %s", path_s.c_str());
-        stbi_image_free(data);
         return false;
     }
-    stbi_image_free(data);
     name = path_s.substr(path_s.find_last_of('/') + 1, path_s.size());
-    RendererConsole::GetInstance()->AddNote("Load Texture From: %s", path);
+    RendererConsole::GetInstance()->AddNote("Load Texture From: %s", path_s.c_str());
     LoadedTextures.insert(std::map<std::string, Texture2D *>::value_type(name, this));
     return true;
 }
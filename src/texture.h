@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 
 #include "editor_resource.h"
+#include "slot_map.h"
 
 class Material;
 
@@ -18,6 +19,16 @@ enum ETexType
     SRGBA
 };
 
+// pixels decoded by stb_image, DecodeImage runs on any thread
+struct TextureImage
+{
+    std::string     path;
+    unsigned char*  data            = nullptr;
+    int             width           = 0;
+    int             height          = 0;
+    int             nrChannels      = 0;
+};
+
 class Texture2D
 {
 public:
@@ -32,14 +43,28 @@ public:
     bool            is_valid        = false;
 
     EditorResource<Material*>       textureRefs;
+    Handle                          handle;
 
 public:
     Texture2D(std::string _path,            ETexType type = ETexType::SRGBA, bool _is_editor = false);
     Texture2D(const char* _path,            ETexType type = ETexType::SRGBA, bool _is_editor = false);
     Texture2D(std::filesystem::path _path,  ETexType type = ETexType::SRGBA, bool _is_editor = false);
+    // upload an image decoded beforehand, its pixels stay with the caller
+    Texture2D(const TextureImage& image,    ETexType type = ETexType::SRGBA, bool _is_editor = false);
     ~Texture2D();
     void DeleteTexture2D();
     bool LoadTexture2D(const char *path, ETexType type = ETexType::RGBA);
+    bool UploadTexture2D(const TextureImage& image, ETexType type = ETexType::RGBA);
+    // no GL in here, safe to call from JobPool jobs
+    static bool DecodeImage(const std::string& path, TextureImage& image);
+    // an encoded file already in memory (an image embedded in a glTF buffer), path only names it
+    static bool DecodeImage(const unsigned char* bytes, size_t size, const std::string& path, TextureImage& image);
+    // one channel of image as a single channel image, channels past the last read as 255
+    static bool ExtractChannel(const TextureImage& image, int channel, TextureImage& result);
+    static void FreeImage(TextureImage& image);
     void ResetTextureType(ETexType type);
     static std::map<std::string, Texture2D*> LoadedTextures;
+    static SlotMap<Texture2D*> Registry;
+    // nullptr for a stale handle
+    static Texture2D* Get(Handle handle);
 };
\ No newline at end of file
@@ -4,22 +4,35 @@
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+/*****************************************************
+* Position, Euler rotation and scale of a standalone
+* object such as a gizmo, scene objects keep theirs in
+* the SceneStore (see EntityTransform). The local
+* matrix and the world matrix (the parent matrix times
+* the local one) are cached and rebuilt only after a
+* setter or a new parent matrix made them dirty.
+* Without a parent matrix a transform is its own world.
+* Version() changes with every new world matrix, so
+* dependents can skip work while an object is still.
+*****************************************************/
 class Transform
 {
 public:
     Transform(glm::vec3 pos = glm::vec3(0,0,0), glm::vec3 rot = glm::vec3(0,0,0), glm::vec3 scal = glm::vec3(1,1,1)) : position(pos), rotation(rot), scale(scal)
     {
-        UpdateVectors();
     }
 
     ~Transform() {}
 
+    // copies the placement in the world, the copy has no parent of its own to follow
     Transform& operator=(const Transform& rhs)
     {
         this->position = rhs.position;
         this->rotation = rhs.rotation;
         this->scale = rhs.scale;
-        this->UpdateVectors();
+        this->parent_matrix = rhs.parent_matrix;
+        this->parent_version = 0;
+        MarkDirty();
         return *this;
     }
 
@@ -28,6 +41,7 @@ public:
         position.r = x;
         position.g = y;
         position.b = z;
+        MarkDirty();
     }
 
     void SetRotation(float Pitch, float Yaw, float Roll)
@@ -35,7 +49,7 @@ public:
         rotation.r = Pitch;
         rotation.g = Yaw;
         rotation.b = Roll;
-        UpdateVectors();
+        MarkDirty();
     }
 
     void SetScale(float x, float y, float z)
@@ -43,8 +57,10 @@ public:
         scale.r = x;
         scale.g = y;
         scale.b = z;
+        MarkDirty();
     }
 
+    // local values, relative to the parent
     const glm::vec3 Position()
     {
         return position;
@@ -60,47 +76,100 @@ public:
         return rotation;
     }
 
+    const glm::vec3 WorldPosition()
+    {
+        return glm::vec3(GetTransformMatrix()[3]);
+    }
+
+    // world space directions
     const glm::vec3 GetFront()
     {
-        UpdateVectors();
+        UpdateWorld();
         return Front;
     }
 
     const glm::vec3 GetRight()
     {
-        UpdateVectors();
+        UpdateWorld();
         return Right;
     }
 
     const glm::vec3 GetUp()
     {
-        UpdateVectors();
+        UpdateWorld();
         return Up;
     }
 
-    void UpdateVectors()
+    const glm::mat4& GetLocalMatrix()
     {
-        // calculate the new Front vector
-        glm::vec4 front(0,0,1,0);
-        glm::vec4 up(0,1,0,0);
-        glm::quat quat(glm::radians(rotation));
-        glm::mat4 rot = glm::mat4_cast(quat);
-        Front = rot * front;
-        Up = rot * up;
-        Right = glm::normalize(glm::cross(Front, Up));
+        if (local_dirty)
+        {
+            glm::mat4 mat = glm::mat4(1.0f);
+            glm::mat4 s = glm::scale(mat, scale);
+            glm::quat quat(glm::radians(rotation));
+            glm::mat4 r = glm::mat4_cast(quat);
+            glm::mat4 t = glm::translate(mat, position);
+            local_matrix = t * r * s;
+            local_dirty = false;
+        }
+        return local_matrix;
+    }
+
+    // local to world
+    const glm::mat4& GetTransformMatrix()
+    {
+        UpdateWorld();
+        return world_matrix;
+    }
+
+    unsigned int Version()
+    {
+        UpdateWorld();
+        return version;
+    }
+
+    // the parent's world matrix and the Version() it was taken at, identity and 0 for none
+    void SetParentMatrix(const glm::mat4& matrix, unsigned int _parent_version)
+    {
+        parent_matrix = matrix;
+        parent_version = _parent_version;
+        world_dirty = true;
     }
 
-    glm::mat4 GetTransformMatrix()
+    unsigned int ParentVersion() const
     {
-        glm::mat4 mat = glm::mat4(1.0f);
-        glm::mat4 s = glm::scale(mat, scale);
-        glm::quat quat(glm::radians(rotation));
-        glm::mat4 r = glm::mat4_cast(quat);
-        glm::mat4 t = glm::translate(mat, position);
-        return t * r * s;
+        return parent_version;
     }
 
 private:
+    void MarkDirty()
+    {
+        local_dirty = true;
+        world_dirty = true;
+    }
+
+    void UpdateWorld()
+    {
+        if (!world_dirty)
+        {
+            return;
+        }
+        world_matrix = parent_matrix * GetLocalMatrix();
+        // the axes of the world matrix, a zero scale falls back to the local rotation alone
+        glm::mat4 rot = glm::mat4_cast(glm::quat(glm::radians(rotation)));
+        Front = Direction(glm::vec3(world_matrix[2]), glm::vec3(rot[2]));
+        Up = Direction(glm::vec3(world_matrix[1]), glm::vec3(rot[1]));
+        Right = glm::normalize(glm::cross(Front, Up));
+        world_dirty = false;
+        version++;
+    }
+
+    static glm::vec3 Direction(const glm::vec3& axis, const glm::vec3& fallback)
+    {
+        float length = glm::length(axis);
+        return length > 1e-6f ? axis / length : fallback;
+    }
+
     glm::vec3 Front;
     glm::vec3 Right;
     glm::vec3 Up;
@@ -110,4 +179,12 @@ private:
     glm::vec3 scale;
     const glm::vec3 WorldUp = glm::vec3(0.0f, 1.0f, 0.0f);
 
-};
\ No newline at end of file
+    glm::mat4 local_matrix = glm::mat4(1.0f);
+    glm::mat4 world_matrix = glm::mat4(1.0f);
+    glm::mat4 parent_matrix = glm::mat4(1.0f);
+    bool local_dirty = true;
+    bool world_dirty = true;
+    unsigned int version = 0;           // of world_matrix, the first one is 1
+    unsigned int parent_version = 0;
+
+};
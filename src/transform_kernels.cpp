@@ -0,0 +1,392 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <glm/gtx/quaternion.hpp>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TRANSFORM_USE_AVX2
+#define TRANSFORM_USE_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSFORM_USE_SSE2
+#endif
+
+// lane i of v in all four lanes
+#define SPLAT(v, i) _mm_shuffle_ps(v, v, _MM_SHUFFLE(i, i, i, i))
+
+#include "transform_kernels.h"
+#include "renderer_console.h"
+
+// the 128-bit loads read a box as six packed floats
+static_assert(sizeof(AABB) == 6 * sizeof(float), "AABB must be two packed glm::vec3");
+
+namespace
+{
+    // what ComposeTRS needs of a register of WIDTH floats
+    struct ScalarLanes
+    {
+        typedef float Type;
+        static const int WIDTH = 1;
+        static Type Load(const float* p)        { return *p; }
+        static void Store(float* p, Type v)     { *p = v; }
+        static Type Set(float v)                { return v; }
+        static Type Add(Type a, Type b)         { return a + b; }
+        static Type Sub(Type a, Type b)         { return a - b; }
+        static Type Mul(Type a, Type b)         { return a * b; }
+    };
+
+#if defined(TRANSFORM_USE_SSE2)
+    struct SseLanes
+    {
+        typedef __m128 Type;
+        static const int WIDTH = 4;
+        static Type Load(const float* p)        { return _mm_loadu_ps(p); }
+        static void Store(float* p, Type v)     { _mm_storeu_ps(p, v); }
+        static Type Set(float v)                { return _mm_set1_ps(v); }
+        static Type Add(Type a, Type b)         { return _mm_add_ps(a, b); }
+        static Type Sub(Type a, Type b)         { return _mm_sub_ps(a, b); }
+        static Type Mul(Type a, Type b)         { return _mm_mul_ps(a, b); }
+    };
+#endif
+
+#if defined(TRANSFORM_USE_AVX2)
+    struct AvxLanes
+    {
+        typedef __m256 Type;
+        static const int WIDTH = 8;
+        static Type Load(const float* p)        { return _mm256_loadu_ps(p); }
+        static void Store(float* p, Type v)     { _mm256_storeu_ps(p, v); }
+        static Type Set(float v)                { return _mm256_set1_ps(v); }
+        static Type Add(Type a, Type b)         { return _mm256_add_ps(a, b); }
+        static Type Sub(Type a, Type b)         { return _mm256_sub_ps(a, b); }
+        static Type Mul(Type a, Type b)         { return _mm256_mul_ps(a, b); }
+    };
+    typedef AvxLanes WideLanes;
+#elif defined(TRANSFORM_USE_SSE2)
+    typedef SseLanes WideLanes;
+#else
+    typedef ScalarLanes WideLanes;
+#endif
+
+    // objects [begin, end) in steps of V::WIDTH, the range must be a multiple of it
+    template <class V>
+    void ComposeRange(const TransformKernels::Streams& s, size_t begin, size_t end, glm::mat4* local)
+    {
+        typedef typename V::Type T;
+        const T one = V::Set(1.0f);
+        const T two = V::Set(2.0f);
+        // the upper 3x3, column by column
+        float entries[9][V::WIDTH];
+        for (size_t i = begin; i < end; i += V::WIDTH)
+        {
+            T x = V::Load(s.rotation[0] + i);
+            T y = V::Load(s.rotation[1] + i);
+            T z = V::Load(s.rotation[2] + i);
+            T w = V::Load(s.rotation[3] + i);
+            T x2 = V::Mul(two, x), y2 = V::Mul(two, y), z2 = V::Mul(two, z);
+            T xx = V::Mul(x, x2), yy = V::Mul(y, y2), zz = V::Mul(z, z2);
+            T xy = V::Mul(x, y2), xz = V::Mul(x, z2), yz = V::Mul(y, z2);
+            T wx = V::Mul(w, x2), wy = V::Mul(w, y2), wz = V::Mul(w, z2);
+            T sx = V::Load(s.scale[0] + i);
+            T sy = V::Load(s.scale[1] + i);
+            T sz = V::Load(s.scale[2] + i);
+
+            // glm::mat4_cast, each column times its scale
+            V::Store(entries[0], V::Mul(V::Sub(one, V::Add(yy, zz)), sx));
+            V::Store(entries[1], V::Mul(V::Add(xy, wz), sx));
+            V::Store(entries[2], V::Mul(V::Sub(xz, wy), sx));
+            V::Store(entries[3], V::Mul(V::Sub(xy, wz), sy));
+            V::Store(entries[4], V::Mul(V::Sub(one, V::Add(xx, zz)), sy));
+            V::Store(entries[5], V::Mul(V::Add(yz, wx), sy));
+            V::Store(entries[6], V::Mul(V::Add(xz, wy), sz));
+            V::Store(entries[7], V::Mul(V::Sub(yz, wx), sz));
+            V::Store(entries[8], V::Mul(V::Sub(one, V::Add(xx, yy)), sz));
+
+            for (int lane = 0; lane < V::WIDTH; lane++)
+            {
+                glm::mat4& m = local[i + lane];
+                m[0] = glm::vec4(entries[0][lane], entries[1][lane], entries[2][lane], 0.0f);
+                m[1] = glm::vec4(entries[3][lane], entries[4][lane], entries[5][lane], 0.0f);
+                m[2] = glm::vec4(entries[6][lane], entries[7][lane], entries[8][lane], 0.0f);
+                m[3] = glm::vec4(s.position[0][i + lane], s.position[1][i + lane], s.position[2][i + lane], 1.0f);
+            }
+        }
+    }
+
+#if defined(TRANSFORM_USE_SSE2)
+    // min.xyz and max.xyz of a box in the first three lanes, without reading past it
+    inline void LoadBox(const AABB& box, __m128& lo, __m128& hi)
+    {
+        lo = _mm_loadu_ps(&box.min.x);
+        hi = _mm_loadu_ps(&box.min.z);
+        hi = _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(0, 3, 2, 1));
+    }
+#endif
+}
+
+#if defined(TRANSFORM_USE_AVX2)
+const int TransformKernels::LANES = 8;
+#elif defined(TRANSFORM_USE_SSE2)
+const int TransformKernels::LANES = 4;
+#else
+const int TransformKernels::LANES = 1;
+#endif
+
+const char* TransformKernels::InstructionSet()
+{
+#if defined(TRANSFORM_USE_AVX2)
+    return "AVX2";
+#elif defined(TRANSFORM_USE_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+void TransformKernels::ComposeTRS(size_t count, const Streams& streams, glm::mat4* local)
+{
+    size_t wide = count / WideLanes::WIDTH * WideLanes::WIDTH;
+    ComposeRange<WideLanes>(streams, 0, wide, local);
+    ComposeRange<ScalarLanes>(streams, wide, count, local);
+}
+
+void TransformKernels::MultiplyMatrices(size_t count, const glm::mat4* parent, const glm::mat4* local, glm::mat4* world)
+{
+#if defined(TRANSFORM_USE_SSE2)
+    for (size_t i = 0; i < count; i++)
+    {
+        __m128 p0 = _mm_loadu_ps(&parent[i][0][0]);
+        __m128 p1 = _mm_loadu_ps(&parent[i][1][0]);
+        __m128 p2 = _mm_loadu_ps(&parent[i][2][0]);
+        __m128 p3 = _mm_loadu_ps(&parent[i][3][0]);
+        __m128 columns[4];
+        for (int j = 0; j < 4; j++)
+        {
+            __m128 l = _mm_loadu_ps(&local[i][j][0]);
+            columns[j] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, SPLAT(l, 0)), _mm_mul_ps(p1, SPLAT(l, 1))),
+                                    _mm_add_ps(_mm_mul_ps(p2, SPLAT(l, 2)), _mm_mul_ps(p3, SPLAT(l, 3))));
+        }
+        for (int j = 0; j < 4; j++)
+        {
+            _mm_storeu_ps(&world[i][j][0], columns[j]);
+        }
+    }
+#else
+    for (size_t i = 0; i < count; i++)
+    {
+        world[i] = parent[i] * local[i];
+    }
+#endif
+}
+
+void TransformKernels::TransformBounds(size_t count, const glm::mat4* matrices, const AABB* local, AABB* world)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        TransformBounds(1, matrices[i], local + i, world + i);
+    }
+}
+
+void TransformKernels::TransformBounds(size_t count, const glm::mat4& matrix, const AABB* local, AABB* world)
+{
+#if defined(TRANSFORM_USE_SSE2)
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 c0 = _mm_loadu_ps(&matrix[0][0]);
+    __m128 c1 = _mm_loadu_ps(&matrix[1][0]);
+    __m128 c2 = _mm_loadu_ps(&matrix[2][0]);
+    __m128 c3 = _mm_loadu_ps(&matrix[3][0]);
+    __m128 a0 = _mm_and_ps(c0, abs_mask);
+    __m128 a1 = _mm_and_ps(c1, abs_mask);
+    __m128 a2 = _mm_and_ps(c2, abs_mask);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!local[i].IsValid())
+        {
+            world[i] = AABB();
+            continue;
+        }
+        __m128 lo, hi;
+        LoadBox(local[i], lo, hi);
+        __m128 center = _mm_mul_ps(_mm_add_ps(lo, hi), half);
+        __m128 extents = _mm_mul_ps(_mm_sub_ps(hi, lo), half);
+        __m128 world_center = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, SPLAT(center, 0)), _mm_mul_ps(c1, SPLAT(center, 1))),
+                                         _mm_add_ps(_mm_mul_ps(c2, SPLAT(center, 2)), c3));
+        __m128 world_extents = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, SPLAT(extents, 0)), _mm_mul_ps(a1, SPLAT(extents, 1))),
+                                          _mm_mul_ps(a2, SPLAT(extents, 2)));
+        float min[4], max[4];
+        _mm_storeu_ps(min, _mm_sub_ps(world_center, world_extents));
+        _mm_storeu_ps(max, _mm_add_ps(world_center, world_extents));
+        world[i] = AABB(glm::vec3(min[0], min[1], min[2]), glm::vec3(max[0], max[1], max[2]));
+    }
+#else
+    for (size_t i = 0; i < count; i++)
+    {
+        world[i] = local[i].Transformed(matrix);
+    }
+#endif
+}
+
+void TransformKernels::ViewDepths(size_t count, const AABB* bounds, const glm::vec3& eye, const glm::vec3& forward, float* depths)
+{
+    size_t i = 0;
+#if defined(TRANSFORM_USE_SSE2)
+    // four centers relative to the eye, transposed to x, y, z rows
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 eye4 = _mm_set_ps(0.0f, eye.z, eye.y, eye.x);
+    const __m128 fx = _mm_set1_ps(forward.x);
+    const __m128 fy = _mm_set1_ps(forward.y);
+    const __m128 fz = _mm_set1_ps(forward.z);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 rows[4];
+        for (int k = 0; k < 4; k++)
+        {
+            __m128 lo, hi;
+            LoadBox(bounds[i + k], lo, hi);
+            rows[k] = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(lo, hi), half), eye4);
+        }
+        _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+        __m128 depth = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rows[0], fx), _mm_mul_ps(rows[1], fy)), _mm_mul_ps(rows[2], fz));
+        _mm_storeu_ps(depths + i, depth);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        depths[i] = glm::dot(bounds[i].Center() - eye, forward);
+    }
+}
+
+/*****************************************************
+* Every kernel against the glm expression it replaces,
+* on the same random transforms: one thread, best of
+* three runs, the largest difference relative to the
+* magnitude of the glm result.
+*****************************************************/
+namespace
+{
+    template <class F>
+    float BestMs(F f)
+    {
+        float best = 1e30f;
+        for (int run = 0; run < 3; run++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            f();
+            best = std::min(best, std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    float RelativeError(const float* values, const float* reference, size_t count)
+    {
+        float error = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            error = std::max(error, std::abs(values[i] - reference[i]) / std::max(1.0f, std::abs(reference[i])));
+        }
+        return error;
+    }
+
+    void LogResult(const char* kernel, size_t count, float ms, float glm_ms, float error)
+    {
+        RendererConsole::GetInstance()->AddNote("  %-17s %8zu: %8.3f ms, %7.1f M/s, %.1fx glm, max error %.1e",
+            kernel, count, ms, count / (ms * 1000.0f), glm_ms / ms, error);
+    }
+}
+
+void TransformKernels::Benchmark()
+{
+    RendererConsole::GetInstance()->AddNote("Transform kernels, %s (%d lanes), one core", InstructionSet(), LANES);
+    const size_t sizes[] = { 10000, 100000, 1000000 };
+    for (size_t count : sizes)
+    {
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::vector<float> components[10];
+        for (auto& component : components)
+        {
+            component.resize(count);
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            glm::quat q = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+            components[0][i] = unit(random) * 100.0f;
+            components[1][i] = unit(random) * 100.0f;
+            components[2][i] = unit(random) * 100.0f;
+            components[3][i] = q.x;
+            components[4][i] = q.y;
+            components[5][i] = q.z;
+            components[6][i] = q.w;
+            components[7][i] = 0.5f + unit(random) * 0.25f;
+            components[8][i] = 0.5f + unit(random) * 0.25f;
+            components[9][i] = 0.5f + unit(random) * 0.25f;
+        }
+        Streams streams = { { components[0].data(), components[1].data(), components[2].data() },
+                            { components[3].data(), components[4].data(), components[5].data(), components[6].data() },
+                            { components[7].data(), components[8].data(), components[9].data() } };
+
+        std::vector<glm::mat4> local(count), world(count), reference(count);
+        float ms = BestMs([&] { ComposeTRS(count, streams, local.data()); });
+        float glm_ms = BestMs([&]
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                glm::quat q(components[6][i], components[3][i], components[4][i], components[5][i]);
+                reference[i] = glm::translate(glm::mat4(1.0f), glm::vec3(components[0][i], components[1][i], components[2][i])) *
+                               glm::mat4_cast(q) *
+                               glm::scale(glm::mat4(1.0f), glm::vec3(components[7][i], components[8][i], components[9][i]));
+            }
+        });
+        LogResult("ComposeTRS", count, ms, glm_ms, RelativeError(&local[0][0][0], &reference[0][0][0], count * 16));
+
+        // every object parented to the one before it
+        ms = BestMs([&] { MultiplyMatrices(count - 1, local.data(), local.data() + 1, world.data()); });
+        glm_ms = BestMs([&]
+        {
+            for (size_t i = 0; i + 1 < count; i++)
+            {
+                reference[i] = local[i] * local[i + 1];
+            }
+        });
+        LogResult("MultiplyMatrices", count, ms, glm_ms, RelativeError(&world[0][0][0], &reference[0][0][0], (count - 1) * 16));
+        world[count - 1] = glm::mat4(1.0f);
+
+        local.clear();
+        local.shrink_to_fit();
+        reference.clear();
+        reference.shrink_to_fit();
+        std::vector<AABB> boxes(count), world_boxes(count), reference_boxes(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            glm::vec3 center(unit(random), unit(random), unit(random));
+            glm::vec3 extents(unit(random), unit(random), unit(random));
+            boxes[i] = AABB(center - glm::abs(extents), center + glm::abs(extents));
+        }
+        ms = BestMs([&] { TransformBounds(count, world.data(), boxes.data(), world_boxes.data()); });
+        glm_ms = BestMs([&]
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                reference_boxes[i] = boxes[i].Transformed(world[i]);
+            }
+        });
+        LogResult("TransformBounds", count, ms, glm_ms, RelativeError(&world_boxes[0].min.x, &reference_boxes[0].min.x, count * 6));
+
+        std::vector<float> depths(count), reference_depths(count);
+        glm::vec3 eye(10.0f, 20.0f, 30.0f);
+        glm::vec3 forward = glm::normalize(glm::vec3(-1.0f, -2.0f, -3.0f));
+        ms = BestMs([&] { ViewDepths(count, world_boxes.data(), eye, forward, depths.data()); });
+        glm_ms = BestMs([&]
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                reference_depths[i] = glm::dot(world_boxes[i].Center() - eye, forward);
+            }
+        });
+        LogResult("ViewDepths", count, ms, glm_ms, RelativeError(depths.data(), reference_depths.data(), count));
+    }
+}
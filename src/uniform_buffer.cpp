@@ -0,0 +1,38 @@
+#include <glad/glad.h>
+
+#include "uniform_buffer.h"
+
+UniformBuffer::UniformBuffer(unsigned int _binding, unsigned int _size) : binding(_binding), size(_size)
+{
+    glGenBuffers(1, &id);
+    glBindBuffer(GL_UNIFORM_BUFFER, id);
+    glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, id);
+}
+
+UniformBuffer::~UniformBuffer()
+{
+    glDeleteBuffers(1, &id);
+}
+
+void UniformBuffer::Upload(const void* data)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, id);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::BindBlocks(unsigned int program)
+{
+    unsigned int pass_index = glGetUniformBlockIndex(program, "PassData");
+    if (pass_index != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(program, pass_index, PASS_DATA_BINDING);
+    }
+    unsigned int light_index = glGetUniformBlockIndex(program, "LightData");
+    if (light_index != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(program, light_index, LIGHT_DATA_BINDING);
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#define MAX_SHADOW_CASCADES 4
+
+// Fixed binding points, shaders declare the matching blocks by name
+enum EUniformBlockBinding
+{
+    PASS_DATA_BINDING   = 0,
+    LIGHT_DATA_BINDING  = 1
+};
+
+/*****************************************************
+* CPU mirrors of the std140 blocks in the shaders.
+* vec3 takes 16 bytes in std140, so the following
+* scalar is packed into its last 4 bytes.
+*****************************************************/
+struct PassData
+{
+    glm::mat4   view;
+    glm::mat4   projection;
+    glm::vec3   view_pos;
+    float       _pad0;
+};
+
+struct LightData
+{
+    glm::vec3   light_pos;
+    float       light_intensity;
+    glm::vec3   light_dir;
+    int         point_light;        // bool in glsl
+    glm::vec3   light_color;
+    int         skybox_enabled;     // bool in glsl
+    glm::mat4   cascade_matrices[MAX_SHADOW_CASCADES];  // world to shadow clip space
+    glm::vec4   cascade_splits;     // view depth where each cascade ends
+    int         cascade_count;
+    int         _pad0[3];
+};
+
+static_assert(sizeof(PassData) == 144, "PassData must match std140 layout");
+static_assert(sizeof(LightData) == 336, "LightData must match std140 layout");
+
+class UniformBuffer
+{
+public:
+    unsigned int id;
+    unsigned int binding;
+    unsigned int size;
+
+    UniformBuffer(unsigned int _binding, unsigned int _size);
+    ~UniformBuffer();
+    void Upload(const void* data);
+
+    // hook the shared blocks of a freshly linked program to their binding points
+    static void BindBlocks(unsigned int program);
+};
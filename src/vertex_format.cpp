@@ -0,0 +1,226 @@
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cstring>
+
+#include "vertex_format.h"
+#include "mesh.h"
+
+namespace
+{
+    unsigned short Unorm16(float v)
+    {
+        return (unsigned short)(glm::clamp(v, 0.0f, 1.0f) * 65535.0f + 0.5f);
+    }
+
+    unsigned int Unorm10(float v)
+    {
+        return (unsigned int)(glm::clamp(v, 0.0f, 1.0f) * 1023.0f + 0.5f);
+    }
+
+    // orthonormal tangent and the sign of the bitangent against cross(normal, tangent)
+    glm::vec4 TangentFrame(const glm::vec3& normal, const Vertex& v)
+    {
+        glm::vec3 t = v.Tangent - normal * glm::dot(normal, v.Tangent);
+        float length = glm::length(t);
+        if (length < 1e-6f)
+        {
+            // no texture coordinates, any tangent will do
+            t = glm::abs(normal.x) < 0.9f ? glm::cross(normal, glm::vec3(1, 0, 0)) : glm::cross(normal, glm::vec3(0, 1, 0));
+            length = glm::length(t);
+        }
+        t /= length;
+        float handedness = glm::dot(glm::cross(normal, t), v.Bitangent) < 0.0f ? -1.0f : 1.0f;
+        return glm::vec4(t, handedness);
+    }
+
+    template <typename T>
+    void Write(unsigned char*& out, const T& value)
+    {
+        memcpy(out, &value, sizeof(T));
+        out += sizeof(T);
+    }
+}
+
+glm::vec2 VertexFormat::EncodeOctahedral(const glm::vec3& n)
+{
+    glm::vec3 p = n / (glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z));
+    glm::vec2 e(p.x, p.y);
+    if (p.z < 0.0f)
+    {
+        e.x = (1.0f - glm::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f);
+        e.y = (1.0f - glm::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return e;
+}
+
+// the same as DecodeOctahedral in the mesh vertex shaders
+glm::vec3 VertexFormat::DecodeOctahedral(const glm::vec2& e)
+{
+    glm::vec3 n(e.x, e.y, 1.0f - glm::abs(e.x) - glm::abs(e.y));
+    if (n.z < 0.0f)
+    {
+        float x = n.x;
+        n.x = (1.0f - glm::abs(n.y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        n.y = (1.0f - glm::abs(x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return glm::normalize(n);
+}
+
+PackedVertices VertexFormat::Pack(const std::vector<Vertex>& vertices, bool quantize_positions, glm::mat4& dequantize)
+{
+    PackedVertices packed;
+    packed.count = vertices.size();
+    dequantize = glm::mat4(1.0f);
+    if (vertices.empty())
+    {
+        return packed;
+    }
+
+    glm::vec3 min_position = vertices[0].Position;
+    glm::vec3 max_position = vertices[0].Position;
+    bool uv_unit = true;
+    bool skinned = false;
+    for (const Vertex& v : vertices)
+    {
+        min_position = glm::min(min_position, v.Position);
+        max_position = glm::max(max_position, v.Position);
+        uv_unit = uv_unit && v.TexCoords.x >= 0.0f && v.TexCoords.x <= 1.0f && v.TexCoords.y >= 0.0f && v.TexCoords.y <= 1.0f;
+        for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+        {
+            skinned = skinned || v.m_Weights[i] > 0.0f;
+        }
+    }
+    VertexLayout& layout = packed.layout;
+    layout.position16 = quantize_positions;
+    layout.uv16 = uv_unit;
+    layout.skinned = skinned;
+
+    glm::vec3 extent = max_position - min_position;
+    float scale = std::max(std::max(extent.x, extent.y), extent.z);
+    if (scale <= 0.0f)
+    {
+        scale = 1.0f;
+    }
+    if (layout.position16)
+    {
+        dequantize = glm::scale(glm::translate(glm::mat4(1.0f), min_position), glm::vec3(scale));
+    }
+
+    packed.positions.resize((size_t)packed.count * layout.PositionStride());
+    packed.data.resize((size_t)packed.count * layout.Stride());
+    packed.skin.resize((size_t)packed.count * layout.SkinStride());
+    unsigned char* position_out = packed.positions.data();
+    unsigned char* out = packed.data.data();
+    unsigned char* skin_out = packed.skin.data();
+    for (const Vertex& v : vertices)
+    {
+        if (layout.position16)
+        {
+            glm::vec3 q = (v.Position - min_position) / scale;
+            unsigned short position[4] = { Unorm16(q.x), Unorm16(q.y), Unorm16(q.z), 0 };
+            Write(position_out, position);
+        }
+        else
+        {
+            Write(position_out, v.Position);
+        }
+
+        float length = glm::length(v.Normal);
+        glm::vec3 normal = length > 0.0f ? v.Normal / length : glm::vec3(0, 0, 1);
+        glm::vec2 octahedral = EncodeOctahedral(normal) * 0.5f + 0.5f;
+        unsigned short encoded_normal[2] = { Unorm16(octahedral.x), Unorm16(octahedral.y) };
+        Write(out, encoded_normal);
+
+        if (layout.uv16)
+        {
+            unsigned short uv[2] = { Unorm16(v.TexCoords.x), Unorm16(v.TexCoords.y) };
+            Write(out, uv);
+        }
+        else
+        {
+            Write(out, v.TexCoords);
+        }
+
+        glm::vec4 tangent = TangentFrame(normal, v);
+        glm::vec3 t = glm::vec3(tangent) * 0.5f + 0.5f;
+        unsigned int encoded_tangent = Unorm10(t.x) | (Unorm10(t.y) << 10) | (Unorm10(t.z) << 20) | ((tangent.w > 0.0f ? 3u : 0u) << 30);
+        Write(out, encoded_tangent);
+
+        if (layout.skinned)
+        {
+            unsigned short ids[MAX_BONE_INFLUENCE];
+            unsigned char weights[MAX_BONE_INFLUENCE];
+            int total = 0, heaviest = 0;
+            for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+            {
+                ids[i] = (unsigned short)std::max(v.m_BoneIDs[i], 0);
+                weights[i] = (unsigned char)(glm::clamp(v.m_Weights[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+                total += weights[i];
+                heaviest = weights[i] > weights[heaviest] ? i : heaviest;
+            }
+            // rounding must not lose weight, the rest goes to the strongest bone
+            if (total > 0)
+            {
+                weights[heaviest] = (unsigned char)glm::clamp(weights[heaviest] + 255 - total, 0, 255);
+            }
+            Write(skin_out, ids);
+            Write(skin_out, weights);
+        }
+    }
+    return packed;
+}
+
+void VertexFormat::SetupPositionArray(const VertexLayout& layout, unsigned int position_vbo)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, position_vbo);
+    glEnableVertexAttribArray(0);
+    if (layout.position16)
+    {
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, layout.PositionStride(), (void*)0);
+    }
+    else
+    {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, layout.PositionStride(), (void*)0);
+    }
+}
+
+void VertexFormat::SetupVertexArray(const VertexLayout& layout, unsigned int position_vbo, unsigned int vbo, unsigned int skin_vbo)
+{
+    // vertex positions
+    SetupPositionArray(layout, position_vbo);
+
+    unsigned int stride = layout.Stride();
+    size_t offset = 0;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    // octahedral normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offset);
+    offset += 2 * sizeof(unsigned short);
+    // texture coords
+    glEnableVertexAttribArray(2);
+    if (layout.uv16)
+    {
+        glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offset);
+        offset += 2 * sizeof(unsigned short);
+    }
+    else
+    {
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+        offset += 2 * sizeof(float);
+    }
+    // tangent and bitangent sign
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offset);
+
+    if (layout.skinned)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, skin_vbo);
+        // ids
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_UNSIGNED_SHORT, layout.SkinStride(), (void*)0);
+        // weights
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, layout.SkinStride(), (void*)(4 * sizeof(unsigned short)));
+    }
+}
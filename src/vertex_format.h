@@ -0,0 +1,82 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+struct Vertex;
+
+// per-mesh choices of the packed vertex layout, pages of the MeshArena hold one layout each
+struct VertexLayout
+{
+    bool    position16 = false;     // unorm16 positions, dequantized through Mesh::vertex_transform
+    bool    uv16 = false;           // unorm16 texture coordinates, when they all lie in [0, 1]
+    bool    skinned = false;        // separate stream of bone ids and weights
+
+    unsigned int PositionStride() const { return position16 ? 8 : 12; }
+    unsigned int Stride() const { return 4 + (uv16 ? 4 : 8) + 4; }
+    unsigned int SkinStride() const { return skinned ? 12 : 0; }
+    bool operator==(const VertexLayout& other) const
+    {
+        return position16 == other.position16 && uv16 == other.uv16 && skinned == other.skinned;
+    }
+};
+
+// packed streams wherever they live, in PackedVertices or a mapped MeshCache file
+struct PackedVertexView
+{
+    VertexLayout    layout;
+    unsigned int    count = 0;
+    const void*     positions = nullptr;
+    const void*     data = nullptr;
+    const void*     skin = nullptr;
+};
+
+// a mesh's vertices encoded for the GPU
+struct PackedVertices
+{
+    VertexLayout                layout;
+    unsigned int                count = 0;
+    std::vector<unsigned char>  positions;  // layout.PositionStride() bytes per vertex
+    std::vector<unsigned char>  data;       // layout.Stride() bytes per vertex
+    std::vector<unsigned char>  skin;       // layout.SkinStride() bytes per vertex
+
+    PackedVertexView View() const { return { layout, count, positions.data(), data.data(), skin.data() }; }
+};
+
+/*****************************************************
+* Packs the 88 byte import Vertex into what the vertex
+* shaders read. Positions are a stream of their own,
+*
+*   location 0  position, float3 or unorm16x3 (+pad)
+*
+* so depth-only passes fetch 8 or 12 bytes a vertex
+* through a VAO with nothing else bound. The attribute
+* stream, only read by the color passes, interleaves
+*
+*   location 1  octahedral normal, unorm16x2
+*   location 2  texture coordinates, float2 or unorm16x2
+*   location 3  tangent, unorm 10:10:10:2, w holds the
+*               bitangent sign
+*
+* for 20 to 28 bytes a vertex in all. The bitangent is
+* rebuilt in the shader from cross(N, T) and the sign.
+* Skinned meshes add a third stream with the bone ids
+* (location 5, uint16x4) and weights (location 6,
+* unorm8x4), static meshes don't carry it at all.
+*
+* Quantized positions use one scale for all three axes,
+* so the dequantization folded into the instance model
+* matrix keeps normals in their direction.
+*****************************************************/
+class VertexFormat
+{
+public:
+    // pick the layout and encode, dequantize receives the transform back to object space
+    static PackedVertices Pack(const std::vector<Vertex>& vertices, bool quantize_positions, glm::mat4& dequantize);
+    // attribute pointers of the layout on the bound VAO
+    static void SetupVertexArray(const VertexLayout& layout, unsigned int position_vbo, unsigned int vbo, unsigned int skin_vbo);
+    // only the position of the layout, for depth-only passes
+    static void SetupPositionArray(const VertexLayout& layout, unsigned int position_vbo);
+
+    static glm::vec2 EncodeOctahedral(const glm::vec3& n);
+    static glm::vec3 DecodeOctahedral(const glm::vec2& e);
+};